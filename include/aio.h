@@ -0,0 +1,87 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include "scheduler.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Asynchronous file and pipe I/O. Operations are handed to one reactor
+// thread that drives an io_uring ring, or, where the kernel refuses to set
+// one up, to a few threads that make the blocking calls instead. Starting
+// an operation returns at once, so the caller keeps evaluating while the
+// I/O runs; waiting for it parks a task, or blocks a thread outside the
+// scheduler's pool.
+namespace aio {
+    class Operation {
+    public:
+        enum class Kind { Read, Write };
+
+        Operation(Kind kind, std::string path, int fd, std::string data)
+            : kind(kind), path(std::move(path)), fd(fd), data(std::move(data)) {}
+        Operation(const Operation&) = delete;
+        Operation& operator=(const Operation&) = delete;
+
+        // returns once the operation has finished, at once if it has
+        void wait();
+        bool done();
+
+        Kind GetKind() const { return kind; }
+        // the rest are only read once the operation is done
+        // what a read got, shared with the Strings made from it
+        std::shared_ptr<const std::string> Data() const { return result; }
+        // bytes read or written
+        std::int64_t Bytes() const { return bytes; }
+        // empty on success
+        const std::string& Failure() const { return failure; }
+
+    private:
+        friend class Reactor;
+        friend class Threads;
+        friend std::shared_ptr<Operation> ReadFile(const std::string& path);
+        friend std::shared_ptr<Operation> WriteFile(const std::string& path, std::string data);
+        friend std::shared_ptr<Operation> Write(int fd, std::string data);
+
+        const Kind kind;
+        // opened by the operation when set, otherwise fd is used as it is
+        const std::string path;
+        int fd;
+        // a write's text, or the buffer a read fills
+        std::string data;
+
+        std::shared_ptr<const std::string> result;
+        std::int64_t bytes = 0;
+        std::string failure;
+
+        std::mutex lock;
+        bool finished = false;
+        std::vector<scheduler::Waiter*> waiters;
+        // keeps the operation alive while the kernel or a thread holds it
+        std::shared_ptr<Operation> self;
+
+        // opening the file, then reading or writing it
+        enum class Stage { Open, Transfer };
+        Stage stage = Stage::Open;
+
+        // hands op to whichever backend runs operations
+        static std::shared_ptr<Operation> start(std::shared_ptr<Operation> op);
+        // error is an errno value
+        void fail(int error);
+        void finish();
+    };
+
+    // reads the file at path in full
+    std::shared_ptr<Operation> ReadFile(const std::string& path);
+    // replaces the contents of the file at path with data, creating it if needed
+    std::shared_ptr<Operation> WriteFile(const std::string& path, std::string data);
+    // writes data to an open descriptor, such as 1 for stdout or a pipe
+    std::shared_ptr<Operation> Write(int fd, std::string data);
+
+    // "io_uring" or "threads", whichever runs the operations
+    const char* Backend();
+}
+
+#endif // AIO_H
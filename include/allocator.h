@@ -0,0 +1,155 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace allocator {
+    // what an accounted block holds, used to break allocation counts down by type
+    enum class Kind : std::uint8_t {
+        Other,
+        Integer,
+        String,
+        Boolean,
+        Null,
+        ReturnValue,
+        Error,
+        Array,
+        ArrayNode,
+        Hash,
+        HashNode,
+        Function,
+        Builtin,
+        Environment,
+        Sequence,
+        Channel,
+        Promise,
+        Count
+    };
+
+    const std::size_t KIND_COUNT    = static_cast<std::size_t>(Kind::Count);
+    // bucket i counts collections that paused for less than 2^i microseconds,
+    // the last bucket counts everything longer
+    const std::size_t PAUSE_BUCKETS = 16;
+
+    const char* KindName(Kind kind);
+
+    struct Stats {
+        std::size_t allocations[KIND_COUNT] = {};
+        std::size_t frees[KIND_COUNT]       = {};
+        std::size_t bytesAllocated          = 0;
+        std::size_t bytesFreed              = 0;
+        std::size_t collections             = 0;
+        std::size_t pauses[PAUSE_BUCKETS]   = {};
+        std::uint64_t totalPauseNanos       = 0;
+        std::uint64_t maxPauseNanos         = 0;
+
+        void recordCollection(std::uint64_t nanos);
+    };
+
+    // Limits on each evaluation in a session, 0 leaves one unlimited. Steps
+    // are the nodes evaluated, depth the function calls nested, bytes what
+    // the evaluation allocates whether or not it frees it again.
+    struct Limits {
+        std::size_t steps = 0;
+        std::size_t depth = 0;
+        std::size_t bytes = 0;
+        std::chrono::milliseconds time{0};
+    };
+
+    // steps the evaluator takes between looks at the limits other than depth
+    const std::size_t LIMIT_CHECK_STEPS = 1024;
+
+    // Budget for one interpreter session: the bytes it holds, and the Limits
+    // on each of its evaluations. The root Environment owns an Account and
+    // every enclosed Environment shares it; all Object and Environment
+    // allocations made while it is active are charged to it.
+    struct Account {
+        std::size_t liveBytes       = 0;
+        std::size_t peakBytes       = 0;
+        std::size_t liveAllocations = 0;
+        std::size_t limit           = 0; // 0 means unlimited
+        bool        overBudget      = false;
+        unsigned int owners         = 0;
+        Stats stats;
+
+        Limits limits;
+        // where the evaluation under way stands: the evaluator counts
+        // stepsToCheck down every node and adds the steps up when it hits 0
+        std::size_t stepsToCheck    = LIMIT_CHECK_STEPS;
+        std::size_t stepsCounted    = LIMIT_CHECK_STEPS;
+        std::size_t steps           = 0;
+        std::size_t depth           = 0;
+        std::size_t bytesAtStart    = 0;
+        std::chrono::steady_clock::time_point started;
+
+        void charge(std::size_t bytes, Kind kind) {
+            liveBytes += bytes;
+            liveAllocations++;
+            stats.bytesAllocated += bytes;
+            stats.allocations[static_cast<std::size_t>(kind)]++;
+            if (liveBytes > peakBytes) peakBytes = liveBytes;
+            overBudget = limit != 0 && liveBytes > limit;
+        }
+        void credit(std::size_t bytes, Kind kind) {
+            liveBytes -= bytes;
+            liveAllocations--;
+            stats.bytesFreed += bytes;
+            stats.frees[static_cast<std::size_t>(kind)]++;
+            overBudget = limit != 0 && liveBytes > limit;
+        }
+
+        // an Account stays alive until no Environment owns it and the last
+        // allocation charged to it has been freed
+        void retain() { owners++; }
+        void release();
+    };
+
+    // account charged by allocations on the calling thread, may be nullptr
+    Account* active();
+    // makes account active on the calling thread; prefer a Scope, this is
+    // for code that moves a session between threads
+    void setActive(Account* account);
+
+    // makes an Account active on the calling thread for the lifetime of the scope
+    struct Scope {
+        Account* previous;
+
+        Scope(Account* account);
+        ~Scope();
+    };
+
+    void* allocate(std::size_t size, Kind kind = Kind::Other);
+    void  deallocate(void* ptr);
+
+    // human readable dump of an Account's statistics
+    void PrintStats(std::ostream& out, const Account& account);
+
+    // base for heap types that should be charged to the active Account,
+    // derived types redeclare operator new to report their own Kind, and
+    // operator delete beside it so the pair still matches
+    struct Accounted {
+        static void* operator new(std::size_t size) { return allocate(size); }
+        static void  operator delete(void* ptr)     { deallocate(ptr); }
+    };
+
+    // lets a standard container charge its storage to the active Account
+    template <typename T, Kind K = Kind::Other>
+    struct StlAllocator {
+        using value_type = T;
+        template <typename U> struct rebind { using other = StlAllocator<U, K>; };
+
+        StlAllocator() = default;
+        template <typename U> StlAllocator(const StlAllocator<U, K>&) {}
+
+        T* allocate(std::size_t n) { return static_cast<T*>(allocator::allocate(n * sizeof(T), K)); }
+        void deallocate(T* ptr, std::size_t) { allocator::deallocate(ptr); }
+
+        bool operator==(const StlAllocator&) const { return true; }
+        bool operator!=(const StlAllocator&) const { return false; }
+    };
+}
+
+#endif // ALLOCATOR_H
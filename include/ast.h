@@ -2,8 +2,13 @@
 #define AST_H
 
 #include "token.h"
+#include "symbol.h"
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <set>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -25,6 +30,7 @@ namespace ast {
         CallExpression,
         ArrayLiteral,
         IndexExpression,
+        SliceExpression,
         HashLiteral,
         LetStatement,
         ReturnStatement,
@@ -84,10 +90,13 @@ namespace ast {
 
     struct Identifier : public Expression {
         token::Token Token;
-        std::string Value;
+        symbol::Id Symbol;
+        // the interned name, shared by every identifier spelled the same
+        const std::string& Value;
 
-        Identifier(token::Token token) : Token(token), Value(token.Literal) {}
-        Identifier(const Identifier* other) : Token(other->Token), Value(other->Token.Literal) {}
+        Identifier(token::Token token)
+            : Token(token), Symbol(symbol::Intern(token.Literal)), Value(symbol::Name(Symbol)) {}
+        Identifier(const Identifier* other) : Token(other->Token), Symbol(other->Symbol), Value(other->Value) {}
 
         void expressionNode() override {}
         std::string TokenLiteral() const override { return Token.Literal; }
@@ -113,9 +122,13 @@ namespace ast {
     struct StringLiteral : public Expression {
         token::Token Token;
         std::string Value;
+        // NONE for literals too long to be worth interning
+        symbol::Id Symbol;
 
-        StringLiteral(token::Token token) : Token(token), Value(token.Literal) {}
-        StringLiteral(const StringLiteral& other) : Token(other.Token), Value(other.Value) {}
+        StringLiteral(token::Token token)
+            : Token(token), Value(token.Literal),
+              Symbol(Value.size() <= symbol::LITERAL_MAX ? symbol::Intern(Value) : symbol::NONE) {}
+        StringLiteral(const StringLiteral& other) : Token(other.Token), Value(other.Value), Symbol(other.Symbol) {}
 
         void expressionNode() override {}
         std::string TokenLiteral() const override { return Token.Literal; }
@@ -238,7 +251,7 @@ namespace ast {
             : Token(other.Token), 
               Condition(other.Condition->clone()),
               Consequence(other.Consequence->clone()), 
-              Alternative(other.Alternative->clone()) {}
+              Alternative(other.Alternative ? other.Alternative->clone() : nullptr) {}
 
         ~IfExpression() {
             delete Consequence;
@@ -408,6 +421,9 @@ namespace ast {
         token::Token Token;
         Expression* Left;
         Expression* Index;
+        // left to the evaluator, which caches (shape id << 32 | slot) here
+        // when Index is a string literal; 0 while nothing is cached
+        std::atomic<uint64_t> InlineCache{0};
 
         IndexExpression(token::Token token, Expression* left) : Token(token), Left(left) {}
         IndexExpression(const IndexExpression& other) 
@@ -430,16 +446,49 @@ namespace ast {
         IndexExpression* clone() const override { return new IndexExpression(*this); }
     };
 
+    // left[Start:End], either bound may be left out and is nullptr then
+    struct SliceExpression : public Expression {
+        token::Token Token;
+        Expression* Left;
+        Expression* Start = nullptr;
+        Expression* End   = nullptr;
+
+        SliceExpression(token::Token token, Expression* left) : Token(token), Left(left) {}
+        SliceExpression(const SliceExpression& other)
+            : Token(other.Token), Left(other.Left->clone()),
+              Start(other.Start ? other.Start->clone() : nullptr),
+              End(other.End ? other.End->clone() : nullptr) {}
+        ~SliceExpression() {
+            delete Left;
+            delete Start;
+            delete End;
+        }
+
+        std::string String() const override {
+            std::stringstream out;
+            out << "(" << Left->String() << "[" << (Start ? Start->String() : "")
+                << ":" << (End ? End->String() : "") << "])";
+
+            return out.str();
+        }
+
+        void expressionNode() override {}
+        std::string TokenLiteral() const override { return Token.Literal; }
+        NodeType GetType() const override { return NodeType::SliceExpression; }
+        SliceExpression* clone() const override { return new SliceExpression(*this); }
+    };
+
     struct HashLiteral : public Expression {
         token::Token Token;
-        std::map<Expression*, Expression*> Pairs;
+        // in source order, which is the order the keys are inserted in
+        std::vector<std::pair<Expression*, Expression*>> Pairs;
 
         HashLiteral(token::Token token) : Token(token) {}
         HashLiteral(const HashLiteral& other)
             : Token(other.Token) 
         {
             for (const auto& pair : other.Pairs) {
-                Pairs[pair.first->clone()] = pair.second->clone();
+                Pairs.push_back({pair.first->clone(), pair.second->clone()});
             }
         }
         ~HashLiteral() {
@@ -547,6 +596,97 @@ namespace ast {
         NodeType GetType() const override { return NodeType::ExpressionStatement; }
         ExpressionStatement* clone() const override { return new ExpressionStatement(*this); }
     };
+    // calls visit on node and then on every node below it; children that are
+    // absent, such as a missing else or slice bound, are skipped
+    inline void Walk(Node* node, const std::function<void(Node*)>& visit) {
+        if (node == nullptr) {
+            return;
+        }
+        visit(node);
+
+        switch (node->GetType()) {
+            case NodeType::Program :
+                for (Statement* stmt : static_cast<Program*>(node)->Statements) Walk(stmt, visit);
+                break;
+            case NodeType::BlockStatement :
+                for (Statement* stmt : static_cast<BlockStatement*>(node)->Statements) Walk(stmt, visit);
+                break;
+            case NodeType::PrefixExpression :
+                Walk(static_cast<PrefixExpression*>(node)->Right, visit);
+                break;
+            case NodeType::InfixExpression :
+                Walk(static_cast<InfixExpression*>(node)->Left, visit);
+                Walk(static_cast<InfixExpression*>(node)->Right, visit);
+                break;
+            case NodeType::IfExpression :
+                Walk(static_cast<IfExpression*>(node)->Condition, visit);
+                Walk(static_cast<IfExpression*>(node)->Consequence, visit);
+                Walk(static_cast<IfExpression*>(node)->Alternative, visit);
+                break;
+            case NodeType::FunctionLiteral :
+                for (Identifier* param : static_cast<FunctionLiteral*>(node)->Parameters) Walk(param, visit);
+                Walk(static_cast<FunctionLiteral*>(node)->Body, visit);
+                break;
+            case NodeType::AssignExpression :
+                Walk(static_cast<AssignExpression*>(node)->Left, visit);
+                Walk(static_cast<AssignExpression*>(node)->Right, visit);
+                break;
+            case NodeType::CallExpression :
+                Walk(static_cast<CallExpression*>(node)->Function, visit);
+                for (Expression* arg : static_cast<CallExpression*>(node)->Arguments) Walk(arg, visit);
+                break;
+            case NodeType::ArrayLiteral :
+                for (Expression* el : static_cast<ArrayLiteral*>(node)->Elements) Walk(el, visit);
+                break;
+            case NodeType::IndexExpression :
+                Walk(static_cast<IndexExpression*>(node)->Left, visit);
+                Walk(static_cast<IndexExpression*>(node)->Index, visit);
+                break;
+            case NodeType::SliceExpression :
+                Walk(static_cast<SliceExpression*>(node)->Left, visit);
+                Walk(static_cast<SliceExpression*>(node)->Start, visit);
+                Walk(static_cast<SliceExpression*>(node)->End, visit);
+                break;
+            case NodeType::HashLiteral :
+                for (auto& pair : static_cast<HashLiteral*>(node)->Pairs) {
+                    Walk(pair.first, visit);
+                    Walk(pair.second, visit);
+                }
+                break;
+            case NodeType::LetStatement :
+                Walk(static_cast<LetStatement*>(node)->Name, visit);
+                Walk(static_cast<LetStatement*>(node)->Value, visit);
+                break;
+            case NodeType::ReturnStatement :
+                Walk(static_cast<ReturnStatement*>(node)->ReturnValue, visit);
+                break;
+            case NodeType::ExpressionStatement :
+                Walk(static_cast<ExpressionStatement*>(node)->expression, visit);
+                break;
+            default :
+                break;
+        }
+    }
+
+    // the names a function binds for itself, which shadow any outside it:
+    // its parameters, and the lets and parameters of the function literals
+    // in its body
+    inline std::set<symbol::Id> BoundNames(const std::vector<Identifier*>& params, BlockStatement* body) {
+        std::set<symbol::Id> names;
+        for (Identifier* param : params) {
+            names.insert(param->Symbol);
+        }
+        Walk(body, [&names](Node* node) {
+            if (node->GetType() == NodeType::LetStatement) {
+                names.insert(static_cast<LetStatement*>(node)->Name->Symbol);
+            } else if (node->GetType() == NodeType::FunctionLiteral) {
+                for (Identifier* param : static_cast<FunctionLiteral*>(node)->Parameters) {
+                    names.insert(param->Symbol);
+                }
+            }
+        });
+        return names;
+    }
 }
 
 #endif // AST_H
@@ -0,0 +1,90 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "allocator.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A file's contents, mapped read only where it is a regular file and read
+// into memory otherwise, as for a pipe.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return mapping != nullptr ? mapping : contents.data(); }
+    std::size_t size() const { return mapping != nullptr ? length : contents.size(); }
+    // why the file could not be read, empty when it was
+    const std::string& Failure() const { return failure; }
+
+private:
+    char* mapping = nullptr;
+    std::size_t length = 0;
+    std::string contents;
+    std::string failure;
+};
+
+// Splits what is read from a descriptor into lines, reading a large block
+// at a time. Lines are views into the block they were read into, which
+// stays as it is for as long as anything else shares it.
+class LineReader {
+public:
+    explicit LineReader(int fd, std::size_t blockSize = DEFAULT_BLOCK);
+
+    // the next line, without its newline; false at the end of the input or
+    // once reading fails
+    bool next(std::string_view& line);
+    // the block the last line is in
+    const std::shared_ptr<std::string>& Block() const { return block; }
+    const std::string& Failure() const { return failure; }
+
+    static const std::size_t DEFAULT_BLOCK = 1 << 20;
+
+private:
+    int fd;
+    std::shared_ptr<std::string> block;
+    // unsplit bytes of the block are [start, end)
+    std::size_t start = 0;
+    std::size_t end = 0;
+    bool eof = false;
+    std::string failure;
+
+    // reads more after the unsplit bytes, moving them to the front of the
+    // block or of a new one first; false when nothing more was read
+    bool fill();
+};
+
+// Runs the script at path, parsed as one program, in a new isolate held to
+// limits. Output goes to stdout, errors to stderr, and printStats dumps the
+// session's allocator statistics there at the end. Returns the exit status:
+// 0, or 1 when the script could not be read or parsed or ends in an Error.
+int RunFile(const std::string& path, const allocator::Limits& limits = allocator::Limits(),
+        bool printStats = false);
+
+// Calls the function that source evaluates to for each line read from in,
+// the way awk runs its program. What a call returns is written to out, a
+// String as it is, null not at all, anything else inspected. The function is
+// parsed and evaluated once, and every call, held to limits, shares one
+// frame. Returns the exit status: 0, or 1 when source is not a function or a
+// call ends in an Error, which stops the run.
+int RunEach(const std::string& source, int in, std::FILE* out,
+        const allocator::Limits& limits = allocator::Limits());
+
+// Runs the script at path once for each of inputs, with the file's contents
+// bound to `input`. The script is parsed once; each worker of the scheduler
+// runs it in an isolate of its own, which is reset rather than made anew
+// for the next file. What the runs print with puts is written to out in the
+// order of inputs, whichever finishes first. Returns the exit status: 0, or
+// 1 when the script could not be read or parsed, or a file could not be read
+// or its run ended in an Error, which goes to stderr.
+int RunMap(const std::string& path, const std::vector<std::string>& inputs, std::FILE* out,
+        const allocator::Limits& limits = allocator::Limits());
+
+#endif // BATCH_H
@@ -6,6 +6,7 @@
 
 object::Object*      Eval(ast::Node* node, object::Environment* env);
 object::Object*      evalProgram(std::vector<ast::Statement*> &stmts, object::Environment* env);
+object::Object*      trackTemporary(object::Object* obj, object::Environment* env);
 object::Object*      evalPrefixExpression(std::string oper, object::Object* right);
 object::Object*      nativeBoolToBooleanObject(bool input);
 object::Object*      evalBangOperatorExpression(object::Object* right);
@@ -16,15 +17,52 @@ object::Object*      evalStringInfixExpression(std::string oper, object::Object*
 object::Object*      evalIfExpression(ast::IfExpression* ifexpr, object::Environment* env);
 object::Object*      evalBlockStatements(ast::BlockStatement* blckStmt, object::Environment* env);
 object::Object*      evalIdentifier(ast::Identifier* ident, object::Environment* env); 
-object::Object*      evalIndexExpression(object::Object* left, object::Object* index); 
+object::Object*      evalIndexExpression(object::Object* left, object::Object* index, object::Environment* env); 
+object::Object*      evalSliceExpression(ast::SliceExpression* slicexpr, object::Environment* env);
 object::Object*      evalHashLiteral(ast::HashLiteral* hashlit, object::Environment* env); 
-object::Object*      evalArrayIndexExpression(object::Object* array, object::Object* index); 
+object::Object*      evalArrayIndexExpression(object::Object* array, object::Object* index, object::Environment* env); 
 object::Object*      evalHashIndexExpression(object::Object* hash, object::Object* index);
+object::Object*      evalHashFieldExpression(ast::IndexExpression* indexpr, object::Hash* hash);
 object::Environment* extendFunctionEnv(object::Function* fn, std::vector<object::Object*> &args);
 object::Object*      applyFunction(object::Object* fn, std::vector<object::Object*> &args);
 object::Object*      unwrapReturnValue(object::Object* obj);
+object::Object*      newMemoryBudgetError(allocator::Account* account);
+void                 countStepsToCheck(allocator::Account* account);
+// resets the Limits for a new evaluation in account's session
+void                 startEvaluation(allocator::Account* account);
+// adds up the steps counted down since the last check, the Error to return
+// when the evaluation is over one of its Limits
+object::Object*      checkLimits(allocator::Account* account);
+// counts a call entered, the Error to return instead when it goes deeper
+// than the Limits allow; the caller takes depth down again once it returns
+object::Object*      enterCall(allocator::Account* account);
 bool                 isTruthy(object::Object* obj);
 bool                 isError(object::Object* obj);
 std::vector<object::Object*> evalExpressions(std::vector<ast::Expression*> exprs, object::Environment* env);
 
+// Calls fn over and over, as the collection builtins do. A Function gets
+// one frame for all of its calls, its parameters rebound before each one,
+// where applyFunction would make a new Environment per call. Temporaries
+// left in the frame are collected as it fills up, whatever is left when the
+// FrameCall goes away moves to the session's heap.
+class FrameCall {
+public:
+    FrameCall(object::Object* fn);
+    FrameCall(const FrameCall&) = delete;
+    FrameCall& operator=(const FrameCall&) = delete;
+    ~FrameCall();
+
+    object::Object* operator()(std::vector<object::Object*>& args);
+    // hands obj, which nothing references yet, to the frame's collection
+    void track(object::Object* obj);
+
+private:
+    static constexpr std::size_t COLLECT_MIN = 64;
+
+    object::Object*      callee;
+    object::Function*    function;
+    object::Environment* frame = nullptr;
+    std::size_t          collectAt = COLLECT_MIN;
+};
+
 #endif // EVAL_H
@@ -0,0 +1,46 @@
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include "object.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace object {
+    // A graph of Arrays, Hashes, Strings and scalars that nothing writes to
+    // again. Its objects are charged to no session and pinned like the
+    // builtins, so reading them takes no reference count writes and any
+    // number of isolates on any threads can share them as they are. Each
+    // session holding values from a FrozenHeap keeps it alive through a
+    // shared_ptr, the objects go with the last of them.
+    class FrozenHeap {
+    public:
+        FrozenHeap(const FrozenHeap&) = delete;
+        FrozenHeap& operator=(const FrozenHeap&) = delete;
+        ~FrozenHeap();
+
+        // Freezes a copy of value, nullptr once frozen holds it, otherwise
+        // the Error to return. Frozen and immortal values are their own
+        // frozen copy, heap is then left empty.
+        static Error* Freeze(Object* value, Object*& frozen, std::shared_ptr<FrozenHeap>& heap);
+        // the heap holding obj, which must be frozen
+        static std::shared_ptr<FrozenHeap> Of(const Object* obj);
+
+        std::uint32_t Id() const { return id; }
+        std::size_t size() const { return objects.size(); }
+
+    private:
+        FrozenHeap();
+
+        std::uint32_t id;
+        std::vector<Object*> objects;
+        // other heaps this one's objects point into
+        std::vector<std::shared_ptr<FrozenHeap>> held;
+
+        friend class Freezer;
+    };
+}
+
+#endif // FROZEN_H
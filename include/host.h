@@ -0,0 +1,52 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include "isolate.h"
+#include "scheduler.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Serves many sessions from the scheduler's workers, a few OS threads
+// however many sessions there are. Each session is an Isolate. What is
+// submitted to it is evaluated in order, as a task that exists only while
+// the session has work. A session that keeps evaluating is preempted once
+// per slice of steps, and waits behind the other sessions ready to run, so
+// a busy script cannot starve the rest.
+class Host {
+public:
+    class Session;
+
+    // slice is in steps, blocks entered by the evaluator, see scheduler::Tick;
+    // it applies to every task while the Host is around
+    explicit Host(std::size_t slice = scheduler::DEFAULT_SLICE);
+    Host(const Host&) = delete;
+    Host& operator=(const Host&) = delete;
+    // waits for every evaluation submitted, then ends the sessions
+    ~Host();
+
+    // a new session, which lives as long as the Host; each evaluation in
+    // it is held to limits
+    Session* Open(const allocator::Limits& limits = allocator::Limits());
+    // Evaluates source in session once what was submitted to it before is
+    // done. The future gets what the REPL would print: the result's
+    // Inspect, an empty string when there is no result.
+    std::future<std::string> Submit(Session* session, std::string source);
+
+private:
+    std::mutex lock;
+    std::condition_variable idle;
+    std::vector<std::unique_ptr<Session>> sessions;
+    // sessions with a task evaluating for them
+    std::size_t busy = 0;
+
+    // the body of a session's task, which runs until it has nothing left
+    void drain(Session* session);
+};
+
+#endif // HOST_H
@@ -0,0 +1,38 @@
+#ifndef ISOLATE_H
+#define ISOLATE_H
+
+#include "object.h"
+#include "ast.h"
+
+#include <string>
+
+// An interpreter instance. It owns its root Environment, and with it the
+// heap, bindings and allocator Account every evaluation in it uses. What
+// isolates share (builtins, keywords, precedences, the symbol table and the
+// true/false/null singletons) is immutable or synchronised, so each isolate
+// can run on a thread of its own. One isolate is used by one thread at a time.
+class Isolate {
+public:
+    Isolate();
+    Isolate(const Isolate&) = delete;
+    Isolate& operator=(const Isolate&) = delete;
+    ~Isolate();
+
+    // evaluates program in the root environment; the result stays valid
+    // until the next Collect
+    object::Object* Eval(ast::Program& program);
+    // parses and evaluates source, parse errors come back as an Error
+    object::Object* Run(const std::string& source);
+    // frees the values earlier evaluations left unbound
+    void Collect();
+    // Drops every binding and frees what the isolate holds, leaving it as
+    // it was new but for its Environment and Account, which are reused
+    void Reset();
+
+    object::Environment* Env() const { return env; }
+
+private:
+    object::Environment* env;
+};
+
+#endif // ISOLATE_H
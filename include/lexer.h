@@ -3,16 +3,29 @@
 
 #include "token.h"
 
+#include <string_view>
+
 struct Lexer {
-    std::string input;
+    // the source, held by owned or, for a Lexer made from a view, by the caller
+    std::string owned;
+    std::string_view input;
     unsigned int position;
     unsigned int readPosition;
     unsigned char ch;
 
     Lexer(std::string inp)
-        : input(inp), position(0), readPosition(0), ch('\0') {
+        : owned(std::move(inp)), input(owned), position(0), readPosition(0), ch('\0') {
+            readChar();
+        }
+    // lexes length bytes at source in place, such as a mapped file, without
+    // copying them; they must stay valid as long as the Lexer
+    Lexer(const char* source, std::size_t length)
+        : input(source, length), position(0), readPosition(0), ch('\0') {
             readChar();
         }
+    // a copy would view the original's source
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
 
     void readChar();
     unsigned char peekChar();
@@ -2,14 +2,22 @@
 #define OBJECT_H
 
 #include "ast.h"
+#include "allocator.h"
+#include "persistent_vector.h"
+#include "symbol.h"
+#include "scheduler.h"
+#include "aio.h"
 
+#include <atomic>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <vector>
 #include <map>
 #include <algorithm>
 #include <functional>
+#include <chrono>
 
 namespace object {
     typedef std::string ObjectType;
@@ -24,18 +32,38 @@ namespace object {
     const ObjectType ARRAY_OBJ        = "ARRAY";
     const ObjectType BUILTIN_OBJ      = "BUILTIN";
     const ObjectType ERROR_OBJ        = "ERROR";
+    const ObjectType SEQUENCE_OBJ     = "SEQUENCE";
+    const ObjectType CHANNEL_OBJ      = "CHANNEL";
+    const ObjectType PROMISE_OBJ      = "PROMISE";
 
-    class Object {
+    class Object : public allocator::Accounted {
         public:
             std::int16_t refCount = 0;
             bool isAnon = true;
+            // set on objects every isolate shares, see makeImmortal
+            bool immortal = false;
+            // id of the FrozenHeap holding the object, 0 if it is not frozen
+            std::uint32_t region = 0;
             virtual ~Object() = default;
             virtual ObjectType Type() const = 0;
             virtual std::string Inspect() const = 0;
             virtual Object* clone() const = 0;
-
-            void incrRefCount() { refCount++; }
-            void decRefCount()  { refCount--; }
+            // bytes held by this object, including payload it owns outright
+            virtual std::size_t Footprint() const = 0;
+            // calls visit for every Object this one holds a reference to
+            virtual void forEachReference(const std::function<void(Object*)>& /*visit*/) const {}
+
+            bool frozen() const { return region != 0; }
+            void incrRefCount() { if (!immortal) refCount++; }
+            void decRefCount()  { if (!immortal) refCount--; }
+            // pins the reference count and flags so nothing writes to the
+            // object again and no collection frees it, which lets threads
+            // share it without synchronising
+            void makeImmortal() {
+                immortal = true;
+                refCount = 1;
+                isAnon = false;
+            }
     };
 
     struct HashKey {
@@ -49,6 +77,9 @@ namespace object {
             if (Type > other.Type) return false;
             return Value < other.Value;
         }
+        bool operator==(const HashKey& other) const {
+            return Value == other.Value && Type == other.Type;
+        }
     };
 
     class Hashable {
@@ -60,6 +91,9 @@ namespace object {
     struct Integer : public Object, public Hashable {
         int64_t Value; 
 
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Integer); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         Integer(int64_t value, bool incrRef=false) : Value(value) { 
             if (incrRef && refCount == 0) incrRefCount(); 
         }
@@ -73,25 +107,75 @@ namespace object {
         ObjectType Type() const override { return INTEGER_OBJ; }
         std::string Inspect() const override { return std::to_string(Value); }
         Integer* clone() const override { return new Integer(*this); }
+        std::size_t Footprint() const override { return sizeof(Integer); }
     };
 
+    // A String shows a window of an immutable buffer, which slices cut from
+    // it share instead of copying their text. A small slice keeps the whole
+    // buffer alive, compact() gives it a buffer of its own.
     struct String : public Object, public Hashable {
-        std::string Value;
+        std::shared_ptr<const std::string> Buffer;
+        std::string_view Value;
+        // set once the text is interned, two interned Strings are equal
+        // exactly when their symbols are
+        symbol::Id Symbol = symbol::NONE;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::String); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
 
-        String(std::string value, bool incrRef=false) : Value(value) {
+        String(std::string value, bool incrRef=false)
+            : Buffer(std::make_shared<const std::string>(std::move(value))), Value(*Buffer)
+        {
             if (incrRef) incrRefCount();
         }
-        String(const String& other) : Value(other.Value) {}
+        // the whole of buffer, without copying it
+        String(std::shared_ptr<const std::string> buffer) : Buffer(std::move(buffer)), Value(*Buffer) {}
+        // value, which lies in buffer, without copying it
+        String(std::shared_ptr<const std::string> buffer, std::string_view value)
+            : Buffer(std::move(buffer)), Value(value) {}
+        String(const String& other) : Buffer(other.Buffer), Value(other.Value), Symbol(other.Symbol) {}
+        // bytes [from, to) of parent, sharing its buffer
+        String(const String& parent, std::size_t from, std::size_t to)
+            : Buffer(parent.Buffer), Value(parent.Value.substr(from, to - from)) {}
         ~String() {}
 
-        HashKey getHashKey() const override {
-            uint64_t hash = fnv1a64(Value);
-            return {Type(), hash};
+        String* intern() {
+            if (Symbol == symbol::NONE) Symbol = symbol::Intern(Value);
+            return this;
+        }
+        bool equals(const String& other) const {
+            if (Symbol != symbol::NONE && other.Symbol != symbol::NONE) {
+                return Symbol == other.Symbol;
+            }
+            return Value == other.Value;
+        }
+
+        // true while this String shows less than 1/PIN_RATIO of its buffer
+        bool pinsBuffer() const { return Value.size() * PIN_RATIO < Buffer->size(); }
+        // copies the text into a buffer of its own if it pins a larger one
+        bool compact() {
+            if (!pinsBuffer()) return false;
+            Buffer = std::make_shared<const std::string>(Value);
+            Value = *Buffer;
+            return true;
+        }
+
+        HashKey getHashKey() const override { return hashKeyOf(Value); }
+
+        // the key a String holding text hashes to, without making one
+        static HashKey hashKeyOf(std::string_view text) {
+            return {STRING_OBJ, fnv1a64(text)};
         }
 
         ObjectType Type() const override { return STRING_OBJ; }
-        std::string Inspect() const override { return Value; }
+        std::string Inspect() const override { return std::string(Value); }
         String* clone() const override { return new String(*this); }
+        // a shared buffer is split evenly between the Strings showing it
+        std::size_t Footprint() const override {
+            return sizeof(String) + Buffer->capacity() / std::max<long>(Buffer.use_count(), 1);
+        }
+
+        static const std::size_t PIN_RATIO = 4;
 
     private:
         static constexpr uint64_t FNV_offset_basis = 0xCBF29CE484222325;
@@ -99,7 +183,7 @@ namespace object {
         
         // TODO: consider an implementation of seperate chaining / open addressing
         //       to avoid hash collision
-        static uint64_t fnv1a64(const std::string& text) {
+        static uint64_t fnv1a64(std::string_view text) {
             uint64_t hash = FNV_offset_basis;
             for (const char c : text) {
                 hash ^= static_cast<uint8_t>(c);
@@ -112,6 +196,9 @@ namespace object {
     struct Boolean : public Object, public Hashable {
         bool Value;
 
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Boolean); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         Boolean(bool value, bool incrRef=false) : Value(value) {
             if (incrRef) incrRefCount();
         }
@@ -126,17 +213,25 @@ namespace object {
         ObjectType Type() const override { return BOOLEAN; }
         std::string Inspect() const override { return Value ? "true" : "false"; }
         Boolean* clone() const override { return new Boolean(*this); }
+        std::size_t Footprint() const override { return sizeof(Boolean); }
     };
 
     struct Null : public Object {
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Null); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         ObjectType Type() const override { return NULL_OBJ; }
         std::string Inspect() const override { return "null"; }
         Null* clone() const override { return new Null(); }
+        std::size_t Footprint() const override { return sizeof(Null); }
     };
 
     struct ReturnValue : public Object {
         Object* Value;
 
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::ReturnValue); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         ReturnValue(Object* val, bool incrRef=false) : Value(val) {
             if (incrRef) incrRefCount();
         }
@@ -145,62 +240,151 @@ namespace object {
         ObjectType Type() const override { return RETURN_VALUE_OBJ; }
         std::string Inspect() const override { return Value->Inspect(); }
         ReturnValue* clone() const override { return new ReturnValue(*this); }
+        std::size_t Footprint() const override { return sizeof(ReturnValue); }
+        void forEachReference(const std::function<void(Object*)>& visit) const override { visit(Value); }
     };
 
     struct Error : public Object {
         std::string Message;
 
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Error); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         Error(std::string msg, bool incrRef=false) : Message(msg) {}
         Error(const Error& other) : Message(other.Message) {}
 
         ObjectType Type() const override { return ERROR_OBJ; }
         std::string Inspect() const override { return "ERROR: " + Message; }
         Error* clone() const override { return new Error(*this); }
+        std::size_t Footprint() const override { return sizeof(Error) + Message.capacity(); }
     };
 
+    typedef std::vector<int64_t, allocator::StlAllocator<int64_t, allocator::Kind::ArrayNode>> IntVector;
+
+    // Storage of a packed Array. Each Array sharing it views a range of the
+    // values, so a slice shares its source's storage the way a
+    // PersistentVector slice shares nodes. Appending to a shared one copies
+    // it only when the appended slot is already another view's.
+    struct PackedInts : public allocator::Accounted {
+        unsigned int owners = 1;
+        IntVector values;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::ArrayNode); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        PackedInts() {}
+        PackedInts(IntVector values) : values(std::move(values)) {}
+    };
+
+    // An Array whose elements are all integers keeps them packed as plain
+    // int64_t, boxing one into an Integer only when it is read. The first
+    // element of another type unpacks the array into boxed Elements.
     struct Array : public Object {
-        std::vector<Object*> Elements;
+        // boxed elements, empty while the array is packed
+        PersistentVector Elements;
+        PackedInts* Packed = nullptr;
+        // the range of Packed->values this array holds
+        std::size_t PackedOffset = 0;
+        std::size_t PackedLength = 0;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Array); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Array(const std::vector<Object*>& elements) : Elements(elements) {}
+        Array(const PersistentVector& elements) : Elements(elements) {}
+        // takes over packed's owner reference
+        Array(PackedInts* packed) : Packed(packed), PackedLength(packed->values.size()) {}
+        // shares other's storage, unless other is frozen: sharing counts
+        // owners on the storage, and nothing may write to a frozen array's
+        Array(const Array& other);
+        ~Array() { release(Packed); }
+
+        // packed when every element is an Integer, boxed otherwise
+        static Array* fromElements(const std::vector<Object*>& elements);
+
+        bool packed() const       { return Packed != nullptr; }
+        std::size_t size() const  { return Packed != nullptr ? PackedLength : Elements.size(); }
+        bool empty() const        { return size() == 0; }
+        // element i; from a packed array this is a new Integer the caller owns
+        Object* at(std::size_t i) const;
+        // the packed elements, size() of them; only for packed arrays
+        const int64_t* ints() const { return Packed->values.data() + PackedOffset; }
+        // elements [from, to) sharing this array's storage where it can
+        Array* slice(std::size_t from, std::size_t to) const;
+        // moves the elements into Elements, boxing each of them
+        void unpack();
 
-        Array(std::vector<Object*> elements) : Elements(elements) {
-            for (Object* el : Elements) {
-                el->incrRefCount();
-            }
+        ObjectType Type() const override { return ARRAY_OBJ; }
+        std::string Inspect() const override;
+        Array* clone() const override { return new Array(*this); }
+        std::size_t Footprint() const override {
+            std::size_t packed = Packed != nullptr ? Packed->values.capacity() * sizeof(int64_t) / Packed->owners : 0;
+            return sizeof(Array) + Elements.bytes() + packed;
         }
-        Array(const Array& other) {
-            for (unsigned int i = 0; i < other.Elements.size(); ++i) {
-                Elements.push_back(other.Elements[i]->clone());
-                Elements[i]->incrRefCount();
+        void forEachReference(const std::function<void(Object*)>& visit) const override {
+            for (Object* el : Elements) {
+                visit(el);
             }
         }
-        ~Array() {}
+        void push(object::Object* obj);
+        void pop();
 
-        ObjectType Type() const override { return ARRAY_OBJ; }
-        std::string Inspect() const override { 
-            std::stringstream out;
-            out << "[";
+    private:
+        void pushInt(int64_t value);
+        static void release(PackedInts* packed) {
+            if (packed != nullptr && --packed->owners == 0) delete packed;
+        }
+    };
 
-            for (unsigned int i = 0; i < Elements.size(); ++i) {
-                out << Elements[i]->Inspect();
-                if (i < Elements.size() - 1) {
-                    out << ", ";
-                }
-            }
-            out << "]";
+    // A lazy run of elements: a source, an integer range or an Array, and the
+    // lmap, lfilter and take stages chained onto it. Nothing runs until the
+    // sequence is consumed, then each element goes through every stage before
+    // the next one is read, so a pipeline never builds an intermediate array.
+    struct Sequence : public Object {
+        enum class StageKind { Map, Filter, Take };
+        struct Stage {
+            StageKind Kind;
+            // the callback of a Map or Filter, nullptr for a Take
+            Object*   Fn    = nullptr;
+            // how many elements a Take lets through
+            int64_t   Count = 0;
+        };
 
-            return out.str();
-        }
-        Array* clone() const override { return new Array(*this); }
-        void push(object::Object* obj) {
-            obj->incrRefCount();
-            Elements.push_back(obj);
+        // nullptr when the source is the range [Start, Stop) by Step
+        Array*  Source = nullptr;
+        int64_t Start  = 0;
+        int64_t Stop   = 0;
+        int64_t Step   = 1;
+        std::vector<Stage> Stages;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Sequence); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Sequence(int64_t start, int64_t stop, int64_t step) : Start(start), Stop(stop), Step(step) {}
+        Sequence(Array* source) : Source(source) { Source->incrRefCount(); }
+        Sequence(const Sequence& other);
+        ~Sequence();
+
+        std::size_t sourceSize() const;
+        // source element i; a new Integer the caller owns when boxesSource()
+        Object* sourceAt(std::size_t i) const;
+        bool boxesSource() const { return Source == nullptr || Source->packed(); }
+        int64_t rangeAt(std::size_t i) const { return int64_t(uint64_t(Start) + uint64_t(i) * uint64_t(Step)); }
+        // a range with only takes after it, whose elements need no boxing
+        bool plainRange() const;
+        // how many elements a plain range yields
+        std::size_t plainSize() const;
+
+        ObjectType Type() const override { return SEQUENCE_OBJ; }
+        std::string Inspect() const override;
+        Sequence* clone() const override { return new Sequence(*this); }
+        std::size_t Footprint() const override {
+            return sizeof(Sequence) + Stages.capacity() * sizeof(Stage);
         }
-        void pop() {
-            Elements.back()->decRefCount();
-            Elements.pop_back();
-        }
-        void decrAll() {
-            for(Object* el : Elements) {
-                this->pop();
+        void forEachReference(const std::function<void(Object*)>& visit) const override {
+            if (Source != nullptr) visit(Source);
+            for (const Stage& stage : Stages) {
+                if (stage.Fn != nullptr) visit(stage.Fn);
             }
         }
     };
@@ -210,139 +394,441 @@ namespace object {
         Object* Value;
     };
 
-    struct Hash : public Object {
-        std::map<HashKey, HashPair> Pairs;
+    // A key and its pair, named like the std::map entries it stands in for.
+    // order is the key's position in a HashTrie's log of entries.
+    struct HashEntry {
+        HashKey first;
+        HashPair second;
+        uint64_t order = 0;
+    };
+
+    // Node of either tree of a HashTrie.
+    //
+    // In the index, an entry whose hash fragment at this level is unique
+    // lives in the node itself, fragments shared by several keys get a child
+    // node; dataMap and nodeMap say which fragments are taken by which, and a
+    // popcount over them gives the slot. Past the last level, keys whose
+    // hashes collide completely are kept unordered in entries. Index entries
+    // carry a key and its order, with no pair.
+    //
+    // In the log, leaves hold up to 8 entries and branches up to 8 children,
+    // in order, as PersistentVector's nodes do. They are narrower than the
+    // index's so that a write to a shared hash copies less of the log.
+    //
+    // A node holds a reference on the key and value of every entry that has
+    // a pair.
+    struct HashNode : public allocator::Accounted {
+        static const unsigned int BITS     = 5;
+        static const unsigned int MASK     = (1 << BITS) - 1;
+        static const unsigned int LOG_BITS = 3;
+        static const unsigned int LOG_MASK = (1 << LOG_BITS) - 1;
+
+        unsigned int owners = 1;
+        uint32_t dataMap    = 0;
+        uint32_t nodeMap    = 0;
+        std::vector<HashEntry> entries;
+        std::vector<HashNode*> children;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::HashNode); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+    };
 
-        Hash(std::map<HashKey, HashPair> pairs) : Pairs(pairs) {
-            for (const auto& pair : Pairs) {
-                pair.second.Key->incrRefCount(); 
-                pair.second.Value->incrRefCount(); 
+    // Hash array mapped trie keyed by the hash a HashKey already carries,
+    // over a log that keeps the entries in insertion order. The trie is the
+    // index: it maps each key to its position in the log, which holds the
+    // pairs. Iterating walks the log's leaves front to back. Erasing a key
+    // leaves a hole in the log, which is compacted once holes make up half of
+    // it. Like PersistentVector, copies share every node and a write copies
+    // only the nodes on its paths that are still shared, so adding a key to a
+    // copy of a hash costs a handful of small nodes instead of the whole map.
+    class HashTrie {
+    public:
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = HashEntry;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const HashEntry*;
+            using reference         = const HashEntry&;
+
+            const_iterator() {}
+            const_iterator(const HashNode* root) {
+                if (root != nullptr) {
+                    stack.push_back({root, 0});
+                    settle();
+                }
             }
-        };
-        Hash(const Hash& other) {
-            for (const auto& pair : other.Pairs) {
-                Pairs[pair.first] = {pair.second.Key->clone(), pair.second.Value->clone()};
-                Pairs[pair.first].Key->incrRefCount();
-                Pairs[pair.first].Value->incrRefCount();
+
+            const HashEntry& operator*() const  { return stack.back().node->entries[stack.back().pos]; }
+            const HashEntry* operator->() const { return &**this; }
+            const_iterator& operator++() {
+                stack.back().pos++;
+                settle();
+                return *this;
+            }
+            const_iterator operator++(int) {
+                const_iterator prev = *this;
+                ++*this;
+                return prev;
+            }
+            bool operator==(const const_iterator& other) const {
+                if (stack.empty() || other.stack.empty()) return stack.empty() == other.stack.empty();
+                return stack.back().node == other.stack.back().node && stack.back().pos == other.stack.back().pos;
             }
+            bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+        private:
+            friend class HashTrie;
+
+            // pos counts a node's entries first and its children after them
+            struct Frame {
+                const HashNode* node;
+                std::size_t pos;
+            };
+            std::vector<Frame> stack;
+
+            // moves down to the entry at or after the current position
+            void settle();
+        };
+
+        HashTrie() {}
+        HashTrie(const std::map<HashKey, HashPair>& pairs);
+        HashTrie(const HashTrie& other)
+            : root(other.root), log(other.log), logShift(other.logShift), logSize(other.logSize), count(other.count) {
+            retain(root);
+            retain(log);
+        }
+        HashTrie& operator=(const HashTrie& other) = delete;
+        ~HashTrie() {
+            release(root);
+            release(log);
         }
-        ~Hash() {}
 
-        void push(HashKey hashKey, HashPair hashPair) {
-            hashPair.Key->incrRefCount();
-            hashPair.Value->incrRefCount();
-            Pairs[hashKey] = hashPair;
+        std::size_t size() const     { return count; }
+        bool empty() const           { return count == 0; }
+        const_iterator find(const HashKey& key) const;
+        // in insertion order
+        const_iterator begin() const { return const_iterator(log); }
+        const_iterator end() const   { return const_iterator(); }
+        // true while the index or the log is also reachable from another copy
+        bool shared() const {
+            return (root != nullptr && root->owners > 1) || (log != nullptr && log->owners > 1);
+        }
+        // rough bytes of trie and log storage behind the entries
+        std::size_t bytes() const {
+            return count * (sizeof(HashEntry) + sizeof(HashNode*)) + (count / 8 + 1) * sizeof(HashNode) +
+                logSize * sizeof(HashEntry) + (logSize / (HashNode::LOG_MASK + 1) + 1) * sizeof(HashNode);
         }
-        void pop(HashKey key) {
-            auto it = Pairs.find(key);
-            if (it != Pairs.end()) {
-                it->second.Key->decRefCount();
-                it->second.Value->decRefCount();
 
-                Pairs.erase(it);
-            }
+        // takes a reference on the pair's key and value, replacing and
+        // releasing the previous pair stored under key
+        void set(const HashKey& key, const HashPair& pair);
+        void erase(const HashKey& key);
+        void clear() {
+            release(root);
+            release(log);
+            root = nullptr;
+            log = nullptr;
+            logShift = 0;
+            logSize = 0;
+            count = 0;
         }
-        void decrAll() {
-            while (!Pairs.empty()) {
-                auto it = Pairs.begin();
-                this->pop(it->first);
+        void swap(HashTrie& other) {
+            std::swap(root, other.root);
+            std::swap(log, other.log);
+            std::swap(logShift, other.logShift);
+            std::swap(logSize, other.logSize);
+            std::swap(count, other.count);
+        }
+
+    private:
+        HashNode* root = nullptr;
+        HashNode* log = nullptr;
+        unsigned int logShift = 0;  // of the log's top level, 0 while it is one leaf
+        std::size_t logSize = 0;    // positions taken in the log, holes included
+        std::size_t count = 0;
+
+        static uint64_t hashOf(const HashKey& key);
+        static unsigned int slot(uint32_t map, uint32_t bit) { return __builtin_popcount(map & (bit - 1)); }
+
+        // the index entry for key, nullptr if there is none
+        const HashEntry* lookup(const HashKey& key) const;
+        HashNode* assoc(HashNode* node, unsigned int shift, uint64_t hash, const HashEntry& entry);
+        HashNode* dissoc(HashNode* node, unsigned int shift, uint64_t hash, const HashKey& key);
+        static HashNode* merge(unsigned int shift, const HashEntry& a, uint64_t hashA, const HashEntry& b, uint64_t hashB);
+
+        // entry added at the end of the log below node
+        static HashNode* append(HashNode* node, unsigned int shift, std::size_t position, const HashEntry& entry);
+        // the pair at position replaced by pair, which carries its references
+        static HashNode* replace(HashNode* node, unsigned int shift, std::size_t position, const HashPair& pair);
+        // rebuilds both trees from the live entries
+        void compact();
+
+        static HashNode* unique(HashNode* node);
+        static void retain(HashNode* node) { if (node != nullptr) node->owners++; }
+        static void release(HashNode* node);
+    };
+
+    // Key layout shared by every hash that had the same string keys inserted
+    // in the same order, as all hashes from one literal do. Slot i of such a
+    // hash holds the pair for keys[i]. Shapes are interned process-wide and
+    // never change or go away once made, so an id seen once can be cached
+    // and compared against later. Only keys written out in the program make
+    // shapes, which keeps their number bounded by the program's text.
+    struct Shape {
+        static const unsigned int MAX_KEYS = 16;
+
+        uint32_t id;
+        std::vector<HashKey> keys;
+
+        // slot holding key, -1 if the shape has no such key
+        int slotOf(const HashKey& key) const;
+        // the shape with key added, nullptr once that would pass MAX_KEYS;
+        // a transition made before is found without taking a lock
+        const Shape* with(const HashKey& key) const;
+
+        static const Shape* empty();
+
+    private:
+        // transitions are only ever prepended, and never change once published
+        struct Transition {
+            HashKey key;
+            const Shape* to;
+            const Transition* next;
+        };
+
+        Shape(uint32_t id, std::vector<HashKey> keys) : id(id), keys(std::move(keys)) {}
+
+        mutable std::atomic<const Transition*> transitions{nullptr};
+
+        const Shape* cached(const HashKey& key) const;
+        static const Shape* intern(std::vector<HashKey> keys);
+    };
+
+    // A hash picks its layout from the keys it holds and moves to another as
+    // they change, without callers noticing:
+    //
+    //   Shaped  only string keys written out in the program, as in a hash
+    //           literal, up to Shape::MAX_KEYS: a dense slot array laid out by
+    //           a Shape shared with other hashes built the same way
+    //   Dense   integer keys inserted in ascending order from 0 up, slot i
+    //           holds key i; holes have a null Key and the keys must fill at
+    //           least half of the slots
+    //   Table   anything else: pairs in insertion order, erased ones left as
+    //           holes, plus an open addressing index of positions once there
+    //           are more than SMALL_MAX of them
+    //   Trie    a HashTrie, which a hash of SHARE_MIN or more pairs moves
+    //           to the first time it is copied, so that it and every copy
+    //           share structure from then on
+    //
+    // Every layout iterates in insertion order. An empty hash starts out
+    // Shaped; a key computed at run time, or removing one, moves it to
+    // another layout. Once a hash reaches the Trie it stays there.
+    struct Hash : public Object {
+        enum class Layout : uint8_t { Shaped, Dense, Table, Trie };
+
+        static const unsigned int SMALL_MAX = 8;
+        static const unsigned int SHARE_MIN = 32;
+
+        Layout layout;
+        const Shape* shape;             // Shaped only
+        std::vector<HashPair> slots;    // Shaped and Dense
+        std::vector<HashEntry> entries; // Table
+        std::vector<int32_t> index;     // Table, empty up to SMALL_MAX entries
+        std::size_t count = 0;          // keys held by a Dense hash or a Table
+        HashTrie Pairs;                 // Trie
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Hash); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Hash(const std::map<HashKey, HashPair>& pairs) : layout(Layout::Shaped), shape(Shape::empty()) {
+            for (const auto& pair : pairs) {
+                push(pair.first, pair.second);
             }
         }
+        // Shares other's Trie, moving other to it first when it is big
+        // enough. Smaller hashes are copied, at most a few dozen slots. A
+        // frozen hash is never written to, so only the copy moves.
+        Hash(const Hash& other);
+        ~Hash() { reset(); }
+
+        std::size_t size() const;
+        bool empty() const       { return size() == 0; }
+        // the pair stored under key, nullptr if there is none
+        const HashPair* find(const HashKey& key) const;
+        void forEach(const std::function<void(const HashKey&, const HashPair&)>& visit) const;
+
+        void push(HashKey hashKey, HashPair hashPair);
+        // push for a key written out in the program, such as a string key of
+        // a hash literal; only these extend a Shaped hash's shape
+        void pushLiteral(HashKey hashKey, HashPair hashPair);
+        void pop(HashKey key);
 
         ObjectType Type() const override { return HASH_OBJ; }
         std::string Inspect() const override {
             std::stringstream out;
 
             out << "{";
-            for (const auto& pair : Pairs) {
-                out << pair.second.Key->Inspect() << ": " <<
-                       pair.second.Value->Inspect() << ", ";
-            }
-            if (!Pairs.empty()) {
-                out.seekp(-2, std::ios_base::end);
-            }
+            bool first = true;
+            forEach([&out, &first](const HashKey&, const HashPair& pair) {
+                if (!first) {
+                    out << ", ";
+                }
+                out << pair.Key->Inspect() << ": " << pair.Value->Inspect();
+                first = false;
+            });
             out << "}";
 
             return out.str();
         }
         Hash* clone() const override { return new Hash(*this); }
+        std::size_t Footprint() const override {
+            return sizeof(Hash) + slots.capacity() * sizeof(HashPair) +
+                entries.capacity() * sizeof(HashEntry) + index.capacity() * sizeof(int32_t) +
+                Pairs.bytes();
+        }
+        void forEachReference(const std::function<void(Object*)>& visit) const override {
+            forEach([&visit](const HashKey&, const HashPair& pair) {
+                visit(pair.Key);
+                visit(pair.Value);
+            });
+        }
+
+    private:
+        bool store(const HashKey& key, const HashPair& pair, bool literal);
+        void relayout(const HashKey& key);
+        // moves every pair into Pairs
+        void toTrie();
+        // position of key in entries, -1 if it is not there
+        int locate(const HashKey& key) const;
+        // drops the holes from entries and rebuilds index to fit them
+        void reindex();
+        // takes or drops the references held by slots and entries
+        void retainLocal();
+        void reset();
     };
+    class FrozenHeap;
 
-    struct Environment {
-        std::map<std::string, Object*> store;
+    struct Environment : public allocator::Accounted {
+        std::map<symbol::Id, Object*> store;
         std::vector<Object*> heap;
         Environment* outer = nullptr;
+        allocator::Account* account;
+        // the frozen heaps this session's values point into, kept until the
+        // session ends; only the root's is used
+        std::vector<std::shared_ptr<FrozenHeap>> frozen;
+        // where puts writes for this session, std::cout when nullptr; only
+        // the root's is used
+        std::ostream* out = nullptr;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Environment); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
             
-        Environment() {}
-        Environment(const Environment& other) : outer(other.outer) {
+        Environment() : account(new allocator::Account()) {
+            account->retain();
+        }
+        Environment(Environment* outer) : outer(outer), account(outer->account) {
+            account->retain();
+        }
+        // bindings are cloned, which is O(1) for arrays and hashes, the heap
+        // only holds the original's temporaries and is not copied
+        Environment(const Environment& other) : outer(other.outer), account(other.account) {
+            account->retain();
             for (const auto& pair : other.store) {
                 store[pair.first] = pair.second->clone();
             }
-            for (const auto& obj : other.heap) {
-                heap.push_back(obj->clone());
-            }
         }
         ~Environment() {
             for (auto& item : store) {
                 store[item.first]->decRefCount();
             }
+            account->release();
         }
 
         Environment* clone() { return new Environment(*this); }
 
-        std::pair<Object*, bool> Get(std::string name) {
-            std::pair<Object*, bool> objOk = {nullptr, false};
-            auto it = store.find(name);
-            if (it != store.end()) {
-                objOk = {store[name], true};
-            } else if (outer != nullptr) {
-                objOk = outer->Get(name);     
+        std::pair<Object*, bool> Get(symbol::Id name) {
+            for (Environment* env = this; env != nullptr; env = env->outer) {
+                auto it = env->store.find(name);
+                if (it != env->store.end()) {
+                    return {it->second, true};
+                }
             }
-            return objOk;
+            return {nullptr, false};
         }
-        
-        Object* Set(std::string name, Object* val) {
+        std::pair<Object*, bool> Get(const std::string& name) {
+            symbol::Id id = symbol::Find(name);
+            return id != symbol::NONE ? Get(id) : std::pair<Object*, bool>{nullptr, false};
+        }
+
+        Object* Set(symbol::Id name, Object* val) {
             val->incrRefCount();
             if (val->isAnon)
                 val->isAnon = false;
             store[name] = val;
             return val;
         }
+        Object* Set(const std::string& name, Object* val) { return Set(symbol::Intern(name), val); }
 
-        Environment* NewEnclosedEnvironment() {
-            Environment* env = new Environment();
-            env->outer = this;
+        Environment* root() {
+            Environment* env = this;
+            while (env->outer != nullptr) {
+                env = env->outer;
+            }
             return env;
         }
 
+        // keeps heap alive for as long as this environment's session
+        void HoldFrozen(const std::shared_ptr<FrozenHeap>& heap) {
+            Environment* session = root();
+            if (std::find(session->frozen.begin(), session->frozen.end(), heap) == session->frozen.end()) {
+                session->frozen.push_back(heap);
+            }
+        }
+
+        Environment* NewEnclosedEnvironment() {
+            return new Environment(this);
+        }
+
+        // bytes currently allocated by this session
+        std::size_t MemoryUsage() const { return account->liveBytes; }
+        // caps the session's live bytes, 0 removes the limit
+        void SetMemoryLimit(std::size_t bytes) {
+            account->limit = bytes;
+            account->overBudget = bytes != 0 && account->liveBytes > bytes;
+        }
+        // limits every evaluation in the session from the next one on
+        void SetLimits(const allocator::Limits& limits) { account->limits = limits; }
+
         void clearHeap() {
-            heap.erase(std::remove_if(heap.begin(), heap.end(),
-                [this](Object* obj) {
-                    if (obj->isAnon && obj->refCount <= 0) {
-                        if (obj->Type() == ARRAY_OBJ) {
-                            Array* objArr = dynamic_cast<Array*>(obj);
-                            if (objArr->Elements.size() > 0) {
-                                objArr->decrAll();
-                                delete obj;
-                                clearHeap();
-                            }
-                        } else if (obj->Type() == HASH_OBJ) {
-                            Hash* objHash = dynamic_cast<Hash*>(obj);
-                            if (!objHash->Pairs.empty()) {
-                                objHash->decrAll();
-                                delete obj;
-                                clearHeap();
+            bool freedContainer = true;
+            while (freedContainer) {
+                freedContainer = false;
+                heap.erase(std::remove_if(heap.begin(), heap.end(),
+                    [&freedContainer](Object* obj) {
+                        if (obj->isAnon && obj->refCount <= 0) {
+                            // a container drops its references when it is deleted,
+                            // which may leave earlier entries unreferenced
+                            if (obj->Type() == ARRAY_OBJ || obj->Type() == HASH_OBJ || obj->Type() == SEQUENCE_OBJ) {
+                                freedContainer = true;
                             }
-                        } else {
                             delete obj;
+                            return true;
                         }
-                        return true;
-                    }
-                    return !obj->isAnon;
-                }), heap.end());
+                        return !obj->isAnon;
+                    }), heap.end());
+            }
         }
 
         void deleteAnonymousValues() {
+            auto start = std::chrono::steady_clock::now();
+            collect();
+            auto pause = std::chrono::steady_clock::now() - start;
+            account->stats.recordCollection(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(pause).count());
+        }
+
+        void collect() {
             clearHeap();
             for(auto it = store.begin(); it != store.end();) {
                 if (it->second->refCount <= 0) {
@@ -365,6 +851,9 @@ namespace object {
         ast::BlockStatement* Body;
         Environment* Env;
 
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Function); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
         Function(std::vector<ast::Identifier*> &params, 
                  ast::BlockStatement* body, 
                  object::Environment* env,
@@ -401,25 +890,116 @@ namespace object {
             return out.str();
         }
         Function* clone() const override { return new Function(*this); }
+        std::size_t Footprint() const override {
+            return sizeof(Function) + Parameters.capacity() * sizeof(ast::Identifier*);
+        }
     };
 
     struct Builtin : public Object {
         std::function<Object*(std::vector<Object*> &args)> BuiltinFunction;
 
-        Builtin(std::function<Object*(std::vector<Object*> &args)> fn) : BuiltinFunction(fn) {}
-        Builtin(const Builtin& other) : BuiltinFunction(other.BuiltinFunction) {}
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Builtin); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Builtin(std::function<Object*(std::vector<Object*> &args)> fn) : BuiltinFunction(fn) { makeImmortal(); }
+        Builtin(const Builtin& other) : BuiltinFunction(other.BuiltinFunction) { makeImmortal(); }
 
         ObjectType Type() const override { return BUILTIN_OBJ; }
         std::string Inspect() const override { return "builtin function"; }
         Builtin* clone() const override { return new Builtin(*this); }
+        std::size_t Footprint() const override { return sizeof(Builtin); }
     };
 
-    extern std::map<std::string, object::Builtin*> builtins;
+    // A value on its way from one isolate to another: a copy of it that no
+    // session owns yet, and every object in that copy, each listed after
+    // the ones it holds. One that is never received is freed with it.
+    struct Message {
+        Object* Value = nullptr;
+        std::vector<Object*> Objects;
+        // frozen heaps Value points into, held until a session adopts it
+        std::vector<std::shared_ptr<FrozenHeap>> Frozen;
+
+        Message() {}
+        Message(Object* value, std::vector<Object*> objects, std::vector<std::shared_ptr<FrozenHeap>> frozen = {})
+            : Value(value), Objects(std::move(objects)), Frozen(std::move(frozen)) {}
+        Message(Message&& other) noexcept { *this = std::move(other); }
+        Message& operator=(Message&& other) noexcept;
+        ~Message() { release(); }
+
+        // moves the objects onto env's heap, has its session hold the
+        // frozen heaps and returns the value
+        Object* adopt(Environment* env);
+
+    private:
+        void release();
+    };
 
-    // these serve as predefined singleton instances
-    extern std::shared_ptr<Boolean> TRUE;
-    extern std::shared_ptr<Boolean> FALSE;
-    extern std::shared_ptr<Null>    NULL_T;
+    // A handle on a channel between tasks. Copies of it, in this isolate or
+    // another, share the channel, which goes away with the last of them.
+    struct Channel : public Object {
+        std::shared_ptr<scheduler::Channel<Message>> Core;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Channel); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Channel(std::size_t capacity) : Core(std::make_shared<scheduler::Channel<Message>>(capacity)) {}
+        Channel(const Channel& other) : Core(other.Core) {}
+
+        ObjectType Type() const override { return CHANNEL_OBJ; }
+        std::string Inspect() const override { return "channel(" + std::to_string(Core->Capacity()) + ")"; }
+        Channel* clone() const override { return new Channel(*this); }
+        std::size_t Footprint() const override { return sizeof(Channel); }
+    };
+
+    // An asynchronous read or write in flight, or its outcome; `await`
+    // turns it into the value. Copies share the operation.
+    struct Promise : public Object {
+        std::shared_ptr<aio::Operation> Op;
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::Promise); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        Promise(std::shared_ptr<aio::Operation> op) : Op(std::move(op)) {}
+        Promise(const Promise& other) : Op(other.Op) {}
+
+        ObjectType Type() const override { return PROMISE_OBJ; }
+        std::string Inspect() const override { return Op->done() ? "promise(done)" : "promise(pending)"; }
+        Promise* clone() const override { return new Promise(*this); }
+        std::size_t Footprint() const override { return sizeof(Promise); }
+    };
+
+    // shared by every isolate, so the table and the Builtins are never written
+    extern const std::map<std::string, object::Builtin*> builtins;
+    // the builtin named by name, nullptr if there is none
+    Builtin* lookupBuiltin(symbol::Id name);
+
+    // root Environment of the session evaluating on the calling thread, may be nullptr
+    Environment* activeSession();
+
+    // makes env's session active on the calling thread, including its Account,
+    // for the lifetime of the scope
+    struct SessionScope {
+        Environment* previous;
+        allocator::Scope accounting;
+
+        SessionScope(Environment* env);
+        ~SessionScope();
+    };
+
+    // what a SessionScope has made active on a thread, which a task takes
+    // along when it moves to another one
+    struct SessionState {
+        Environment*        root    = nullptr;
+        allocator::Account* account = nullptr;
+    };
+    SessionState saveSession();
+    void restoreSession(const SessionState& state);
+
+    // these serve as predefined singleton instances, immortal since every
+    // isolate shares them
+    extern const std::shared_ptr<Boolean> TRUE;
+    extern const std::shared_ptr<Boolean> FALSE;
+    extern const std::shared_ptr<Null>    NULL_T;
 }
 
 #endif // OBJECT_H
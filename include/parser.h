@@ -20,7 +20,7 @@ struct Parser {
     std::map<token::TokenType, infixParseFn>  infixParseFns;
 
     enum class Order;
-    static std::map<token::TokenType, Order> precedences;
+    static const std::map<token::TokenType, Order> precedences;
 
     Parser(Lexer &l) 
         : l(l), curToken(l.NextToken()), peekToken(l.NextToken()) {
@@ -75,6 +75,7 @@ private:
     ast::Expression*               parseAssignExpression(ast::Expression*);
     ast::Expression*               parseCallExpression(ast::Expression*);
     ast::Expression*               parseIndexExpression(ast::Expression*);
+    ast::Expression*               parseSliceExpression(token::Token, ast::Expression*, ast::Expression*);
     ast::Expression*               parseHashLiteral();
     std::vector<ast::Identifier*>  parseFunctionParameters();
     std::vector<ast::Expression*>  parseCallArguments();
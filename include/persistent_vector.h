@@ -0,0 +1,133 @@
+#ifndef PERSISTENT_VECTOR_H
+#define PERSISTENT_VECTOR_H
+
+#include "allocator.h"
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+namespace object {
+    class Object;
+
+    // Node of a PersistentVector trie. Branches point at up to WIDTH children,
+    // leaves hold up to WIDTH elements and a reference on each of them.
+    struct VectorNode : public allocator::Accounted {
+        static const unsigned int BITS  = 5;
+        static const unsigned int WIDTH = 1 << BITS;
+        static const unsigned int MASK  = WIDTH - 1;
+
+        unsigned int owners = 1;
+        unsigned int count  = 0;
+        bool leaf;
+        union {
+            Object*     items[WIDTH];
+            VectorNode* children[WIDTH];
+        };
+
+        static void* operator new(std::size_t size) { return allocator::allocate(size, allocator::Kind::ArrayNode); }
+        static void  operator delete(void* ptr)     { allocator::deallocate(ptr); }
+
+        VectorNode(bool leaf) : leaf(leaf) {}
+    };
+
+    // Bit-partitioned vector trie with a detached tail leaf, as used for
+    // Clojure's vectors. Copies share every node; a write first copies the
+    // nodes on its path that are still shared, so a vector whose nodes are all
+    // uniquely owned is updated in place, which is what makes building one
+    // element at a time cheap.
+    //
+    // A vector can also be a view over [start, start + length) of the
+    // elements its nodes hold, which lets slices share structure with the
+    // vector they were cut from.
+    class PersistentVector {
+    public:
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = Object*;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = Object* const*;
+            using reference         = Object*;
+
+            const_iterator(const PersistentVector* vec, std::size_t index)
+                : vec(vec), index(index), leaf(nullptr) {}
+
+            Object* operator*() const {
+                std::size_t physical = vec->start + index;
+                if (leaf == nullptr || (physical & VectorNode::MASK) == 0) {
+                    leaf = vec->leafFor(physical);
+                }
+                return leaf[physical & VectorNode::MASK];
+            }
+            const_iterator& operator++() {
+                index++;
+                if (((vec->start + index) & VectorNode::MASK) == 0) leaf = nullptr;
+                return *this;
+            }
+            const_iterator operator++(int) {
+                const_iterator prev = *this;
+                ++*this;
+                return prev;
+            }
+            bool operator==(const const_iterator& other) const { return index == other.index; }
+            bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+        private:
+            const PersistentVector* vec;
+            std::size_t index;
+            mutable Object* const* leaf;
+        };
+
+        PersistentVector() {}
+        PersistentVector(const std::vector<Object*>& elements);
+        PersistentVector(const PersistentVector& other);
+        PersistentVector& operator=(const PersistentVector& other) = delete;
+        ~PersistentVector();
+
+        std::size_t size() const  { return length; }
+        bool empty() const        { return length == 0; }
+        Object* operator[](std::size_t i) const {
+            std::size_t physical = start + i;
+            return leafFor(physical)[physical & VectorNode::MASK];
+        }
+        Object* back() const      { return (*this)[length - 1]; }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const   { return const_iterator(this, length); }
+
+        // true while some node of this vector is also reachable from another
+        bool shared() const;
+        // rough bytes of trie storage behind the visible elements
+        std::size_t bytes() const;
+
+        // takes a reference on obj
+        void push_back(Object* obj);
+        void pop_back();
+        // elements [from, to) sharing this vector's nodes
+        PersistentVector slice(std::size_t from, std::size_t to) const;
+
+    private:
+        VectorNode* root = nullptr;   // nullptr until the tail first overflows
+        VectorNode* tail = nullptr;
+        unsigned int shift = VectorNode::BITS;
+        std::size_t physical = 0;     // elements held by root and tail
+        std::size_t start    = 0;
+        std::size_t length   = 0;
+
+        std::size_t tailOffset() const {
+            return physical < VectorNode::WIDTH ? 0 : ((physical - 1) >> VectorNode::BITS) << VectorNode::BITS;
+        }
+        Object* const* leafFor(std::size_t physical) const;
+        void clear();
+        void materialize();
+        VectorNode* pushTail(unsigned int level, VectorNode* parent, VectorNode* leaf);
+        VectorNode* popTail(unsigned int level, VectorNode* node, VectorNode*& leaf);
+
+        static VectorNode* unique(VectorNode* node);
+        static VectorNode* newPath(unsigned int level, VectorNode* leaf);
+        static void retain(VectorNode* node) { if (node != nullptr) node->owners++; }
+        static void release(VectorNode* node);
+    };
+}
+
+#endif // PERSISTENT_VECTOR_H
@@ -1,9 +1,14 @@
 #ifndef REPL_H
 #define REPL_H
 
+#include "allocator.h"
+
 #include <iostream>
 
 const std::string PROMPT = ">> ";
-void Start(std::istream &in, std::ostream &out);
+// printStats dumps the session's allocator statistics to stderr on exit;
+// limits hold every line entered
+void Start(std::istream &in, std::ostream &out, bool printStats = false,
+        const allocator::Limits& limits = allocator::Limits());
 
 #endif // REPL_H
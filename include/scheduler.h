@@ -0,0 +1,261 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Green threads. A task runs on a stack of its own and is multiplexed with
+// the others over one worker thread per core; each worker keeps a deque of
+// tasks ready to run, takes the newest from its own and steals the oldest
+// from the others once it runs dry. A task gives up its worker when it
+// blocks, or when Tick finds it has run for its slice while others wait.
+// The pool starts with the first task and lives until the process exits.
+namespace scheduler {
+    class Task;
+
+    // steps a task takes between chances for others to run
+    const std::size_t DEFAULT_SLICE = 10000;
+
+    // starts body as a task
+    void Spawn(std::function<void()> body);
+    // the task running on the calling thread, nullptr outside of one
+    Task* Current();
+    // Unlocks lock, which the calling task holds, and suspends the task
+    // until Ready is called for it; lock is held again when Park returns.
+    // Ready may come as soon as the lock is free, before the task is off
+    // its worker.
+    void Park(std::unique_lock<std::mutex>& lock);
+    // queues a parked task to run again
+    void Ready(Task* task);
+    // Counts a step of the running task, called at every block the
+    // evaluator enters. Once the task has taken its slice of steps and
+    // other tasks are ready, it goes behind them before carrying on.
+    // Outside of a task it does nothing.
+    void Tick();
+    // steps per slice for every task, 0 to never preempt
+    void SetSlice(std::size_t steps);
+    // true while no task can make progress: every task that exists is
+    // parked, or there are none, and no wakeup is held
+    bool Stalled();
+    // Holds off Stalled until the matching Release, for something outside
+    // the pool that will wake a task or thread, such as I/O in flight.
+    void Hold();
+    void Release();
+    std::size_t Workers();
+
+    // Something blocked on a Channel: a parked task, or a thread outside
+    // the pool waiting on a condition variable. Both wait and wake are
+    // called with the channel's lock held.
+    class Waiter {
+    public:
+        Waiter() : task(Current()) {}
+        Waiter(const Waiter&) = delete;
+        Waiter& operator=(const Waiter&) = delete;
+
+        // false when a thread gives up because Stalled says no task is
+        // left to wake it
+        bool wait(std::unique_lock<std::mutex>& lock);
+        void wake();
+
+    private:
+        Task* task;
+        std::condition_variable signal;
+        bool woken = false;
+    };
+
+    // A bounded queue between tasks. Values go through a ring of cells
+    // that each carry a sequence number (Vyukov's bounded MPMC queue), so a
+    // send or recv that finds room or a value never takes a lock; with one
+    // producer and one consumer every CAS on it succeeds first time. Only a
+    // side that has to wait locks the channel and parks, and the other side
+    // looks for waiters through a counter before it locks anything.
+    //
+    // A channel of capacity 0 is unbuffered: send holds one value in a
+    // single cell and returns once a receiver has taken it.
+    template <typename T>
+    class Channel {
+    public:
+        enum class Status { Ok, Closed, Stalled };
+
+        explicit Channel(std::size_t capacity)
+            : capacity(capacity), slots(std::max<std::size_t>(capacity, 1)), cells(new Cell[slots])
+        {
+            for (std::size_t i = 0; i < slots; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+        Channel(const Channel&) = delete;
+        Channel& operator=(const Channel&) = delete;
+
+        // Closed once the channel is closed; Stalled when a thread would
+        // wait forever, an unbuffered value then stays in the channel
+        Status send(T value) {
+            if (closed.load()) {
+                return Status::Closed;
+            }
+
+            std::size_t ticket = 0;
+            if (!tryPush(value, ticket)) {
+                Status status = await(sendersWaiting, senders, [&]() { return tryPush(value, ticket); });
+                if (status != Status::Ok) {
+                    return status;
+                }
+            }
+            wakeAll(receiversWaiting, receivers);
+
+            // the value is handed over once the receive position passes it
+            if (capacity == 0 && dequeuePos.load() < ticket) {
+                Status status = await(sendersWaiting, senders, [&]() { return dequeuePos.load() >= ticket; });
+                if (status == Status::Stalled) {
+                    return status;
+                }
+            }
+            return Status::Ok;
+        }
+
+        // values sent before the channel closed are still received, Closed
+        // comes once there are none left
+        Status recv(T& out) {
+            if (!tryPop(out)) {
+                Status status = await(receiversWaiting, receivers, [&]() { return tryPop(out); });
+                if (status != Status::Ok) {
+                    return status;
+                }
+            }
+            wakeAll(sendersWaiting, senders);
+            return Status::Ok;
+        }
+
+        // false if the channel was already closed
+        bool close() {
+            std::lock_guard<std::mutex> guard(lock);
+            if (closed.exchange(true)) {
+                return false;
+            }
+            wakeLocked(senders);
+            wakeLocked(receivers);
+            return true;
+        }
+
+        std::size_t Capacity() const { return capacity; }
+
+    private:
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        const std::size_t capacity;
+        const std::size_t slots;
+        std::unique_ptr<Cell[]> cells;
+
+        alignas(64) std::atomic<std::size_t> enqueuePos{0};
+        alignas(64) std::atomic<std::size_t> dequeuePos{0};
+        alignas(64) std::atomic<std::size_t> sendersWaiting{0};
+        std::atomic<std::size_t> receiversWaiting{0};
+        std::atomic<bool> closed{false};
+
+        std::mutex lock;
+        std::vector<Waiter*> senders;
+        std::vector<Waiter*> receivers;
+
+        // a cell is free for position pos when its sequence is pos, and
+        // holds the value sent at pos when its sequence is pos + 1
+        bool tryPush(T& value, std::size_t& ticket) {
+            std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;) {
+                cell = &cells[pos % slots];
+                std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            ticket = pos + 1;
+            return true;
+        }
+
+        bool tryPop(T& out) {
+            std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;) {
+                cell = &cells[pos % slots];
+                std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            out = std::move(cell->value);
+            cell->value = T();
+            cell->sequence.store(pos + slots, std::memory_order_release);
+            return true;
+        }
+
+        // Waits until ready() holds. The fences pair with the one in wakeAll:
+        // either the waiter's ready() sees the other side's push or pop, or
+        // the other side sees the waiter counted and locks to wake it.
+        template <typename Ready>
+        Status await(std::atomic<std::size_t>& waiting, std::vector<Waiter*>& waiters, Ready ready) {
+            std::unique_lock<std::mutex> guard(lock);
+            waiting.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            Status status = Status::Ok;
+            while (!ready()) {
+                if (closed.load()) {
+                    status = Status::Closed;
+                    break;
+                }
+                Waiter waiter;
+                waiters.push_back(&waiter);
+                if (!waiter.wait(guard)) {
+                    waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+                    status = Status::Stalled;
+                    break;
+                }
+            }
+
+            waiting.fetch_sub(1);
+            return status;
+        }
+
+        void wakeAll(std::atomic<std::size_t>& waiting, std::vector<Waiter*>& waiters) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            wakeLocked(waiters);
+        }
+
+        // every waiter checks again for itself, so all of them are woken
+        static void wakeLocked(std::vector<Waiter*>& waiters) {
+            for (Waiter* waiter : waiters) {
+                waiter->wake();
+            }
+            waiters.clear();
+        }
+    };
+}
+
+#endif // SCHEDULER_H
@@ -0,0 +1,40 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels over contiguous int64_t arrays. Each picks the widest instruction
+// set the CPU supports the first time it runs, AVX2 then SSE4.2 on x86-64,
+// and falls back to plain loops elsewhere. Arithmetic wraps on overflow.
+namespace simd {
+    enum class Level { Scalar, SSE42, AVX2 };
+
+    // the instruction set the kernels run with on this CPU
+    Level Detected();
+    const char* LevelName(Level level);
+
+    int64_t Sum(const int64_t* a, std::size_t n);
+    // n must be at least 1
+    int64_t Min(const int64_t* a, std::size_t n);
+    int64_t Max(const int64_t* a, std::size_t n);
+    int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n);
+
+    // out[i] = a[i] op b[i]; out may alias a or b
+    void Add(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+    void Sub(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+    void Mul(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+
+    // the plain loops, for checking the vector kernels against
+    namespace scalar {
+        int64_t Sum(const int64_t* a, std::size_t n);
+        int64_t Min(const int64_t* a, std::size_t n);
+        int64_t Max(const int64_t* a, std::size_t n);
+        int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n);
+        void Add(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+        void Sub(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+        void Mul(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n);
+    }
+}
+
+#endif // SIMD_H
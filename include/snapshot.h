@@ -0,0 +1,49 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "object.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// Heap snapshot file layout, every integer is an unsigned LEB128 varint:
+//
+//   "MKHEAP" version
+//   rootCount { nameLength name nodeId }
+//   nodeCount { kind size refCount edgeCount { nodeId } reachCount { rootIndex } }
+//
+// Node ids index the node table, kind is an allocator::Kind and the reach
+// list holds the indices of every root the node is reachable from.
+namespace snapshot {
+    const char         MAGIC[]  = "MKHEAP";
+    const std::size_t  MAGIC_LENGTH = 6;
+    const std::uint8_t VERSION  = 1;
+
+    // Streams every object reachable from the session rooted at root to out.
+    // The walk only allocates bookkeeping, never Monkey objects, so taking a
+    // snapshot does not disturb the heap it describes. Returns the node count.
+    std::size_t Write(object::Environment* root, std::ostream& out);
+
+    inline void writeVarint(std::ostream& out, std::uint64_t value) {
+        do {
+            std::uint8_t byte = value & 0x7F;
+            value >>= 7;
+            if (value != 0) byte |= 0x80;
+            out.put(static_cast<char>(byte));
+        } while (value != 0);
+    }
+
+    inline bool readVarint(std::istream& in, std::uint64_t& value) {
+        value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == EOF) return false;
+            value |= std::uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+}
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,494 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Sorting for the sort builtins. pdqsort (pattern-defeating quicksort) is an
+// introsort that finishes sorted and reversed runs in linear time and cannot
+// go quadratic; large arrays are split across threads and merged back.
+// Both need a comparator that is a strict weak order, stableSort is the one
+// for comparators written in Monkey.
+namespace sort {
+    namespace detail {
+        const std::ptrdiff_t INSERTION_SORT_THRESHOLD     = 24;
+        const std::ptrdiff_t NINTHER_THRESHOLD            = 128;
+        const std::ptrdiff_t PARTIAL_INSERTION_SORT_LIMIT = 8;
+        // elements classified per round of the branchless partition, at most
+        // 256 so an offset fits a byte
+        const std::size_t    BLOCK_SIZE                   = 64;
+
+        inline int log2(std::size_t n) {
+            int log = 0;
+            while (n >>= 1) ++log;
+            return log;
+        }
+
+        template<class Iter, class Compare>
+        void insertionSort(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return;
+
+            for (Iter cur = begin + 1; cur != end; ++cur) {
+                Iter sift = cur;
+                Iter sift_1 = cur - 1;
+                if (comp(*sift, *sift_1)) {
+                    T tmp = std::move(*sift);
+                    do {
+                        *sift-- = std::move(*sift_1);
+                    } while (sift != begin && comp(tmp, *--sift_1));
+                    *sift = std::move(tmp);
+                }
+            }
+        }
+
+        // the element before begin must not be greater than any in [begin, end)
+        template<class Iter, class Compare>
+        void unguardedInsertionSort(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return;
+
+            for (Iter cur = begin + 1; cur != end; ++cur) {
+                Iter sift = cur;
+                Iter sift_1 = cur - 1;
+                if (comp(*sift, *sift_1)) {
+                    T tmp = std::move(*sift);
+                    do {
+                        *sift-- = std::move(*sift_1);
+                    } while (comp(tmp, *--sift_1));
+                    *sift = std::move(tmp);
+                }
+            }
+        }
+
+        // insertion sort that gives up once it has moved too many elements;
+        // true if [begin, end) ended up sorted
+        template<class Iter, class Compare>
+        bool partialInsertionSort(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (begin == end) return true;
+
+            std::ptrdiff_t moved = 0;
+            for (Iter cur = begin + 1; cur != end; ++cur) {
+                Iter sift = cur;
+                Iter sift_1 = cur - 1;
+                if (comp(*sift, *sift_1)) {
+                    T tmp = std::move(*sift);
+                    do {
+                        *sift-- = std::move(*sift_1);
+                    } while (sift != begin && comp(tmp, *--sift_1));
+                    *sift = std::move(tmp);
+                    moved += cur - sift;
+                }
+                if (moved > PARTIAL_INSERTION_SORT_LIMIT) return false;
+            }
+            return true;
+        }
+
+        template<class Iter, class Compare>
+        void sort2(Iter a, Iter b, Compare comp) {
+            if (comp(*b, *a)) std::iter_swap(a, b);
+        }
+
+        template<class Iter, class Compare>
+        void sort3(Iter a, Iter b, Iter c, Compare comp) {
+            sort2(a, b, comp);
+            sort2(b, c, comp);
+            sort2(a, b, comp);
+        }
+
+        // Partitions around the pivot at begin, elements equal to it going
+        // right. Returns where the pivot ended up and whether the range was
+        // already partitioned, that is no element had to move.
+        template<class Iter, class Compare>
+        std::pair<Iter, bool> partitionRight(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            // the median of three put an element >= pivot at the end, so the
+            // first scan needs no bound; the second one does when nothing was
+            // smaller than the pivot
+            while (comp(*++first, pivot));
+            if (first - 1 == begin) {
+                while (first < last && !comp(*--last, pivot));
+            } else {
+                while (!comp(*--last, pivot));
+            }
+
+            bool alreadyPartitioned = first >= last;
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (comp(*++first, pivot));
+                while (!comp(*--last, pivot));
+            }
+
+            Iter pivotPos = first - 1;
+            *begin = std::move(*pivotPos);
+            *pivotPos = std::move(pivot);
+            return {pivotPos, alreadyPartitioned};
+        }
+
+        // swaps num pairs of misplaced elements found by the block partition;
+        // with differing counts a cyclic permutation moves each element once
+        template<class Iter>
+        void swapOffsets(Iter first, Iter last, const unsigned char* offsetsL, const unsigned char* offsetsR,
+                std::size_t num, bool useSwaps) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            if (useSwaps) {
+                for (std::size_t i = 0; i < num; ++i) {
+                    std::iter_swap(first + offsetsL[i], last - offsetsR[i]);
+                }
+            } else if (num > 0) {
+                Iter l = first + offsetsL[0];
+                Iter r = last - offsetsR[0];
+                T tmp(std::move(*l));
+                *l = std::move(*r);
+                for (std::size_t i = 1; i < num; ++i) {
+                    l = first + offsetsL[i];
+                    *r = std::move(*l);
+                    r = last - offsetsR[i];
+                    *l = std::move(*r);
+                }
+                *r = std::move(tmp);
+            }
+        }
+
+        // partitionRight for cheap comparators. It classifies a block of
+        // elements at a time into offset buffers without branching on the
+        // comparison, so a mispredicted branch is not paid per element.
+        template<class Iter, class Compare>
+        std::pair<Iter, bool> partitionRightBranchless(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            while (comp(*++first, pivot));
+            if (first - 1 == begin) {
+                while (first < last && !comp(*--last, pivot));
+            } else {
+                while (!comp(*--last, pivot));
+            }
+
+            bool alreadyPartitioned = first >= last;
+            if (!alreadyPartitioned) {
+                std::iter_swap(first, last);
+                ++first;
+
+                alignas(64) unsigned char offsetsL[BLOCK_SIZE];
+                alignas(64) unsigned char offsetsR[BLOCK_SIZE];
+                Iter offsetsLBase = first;
+                Iter offsetsRBase = last;
+                std::size_t numL = 0, numR = 0, startL = 0, startR = 0;
+
+                while (first < last) {
+                    // fill whichever buffers are empty, splitting the rest
+                    // between them once the unknown elements run short
+                    std::size_t numUnknown = last - first;
+                    std::size_t leftSplit  = numL == 0 ? (numR == 0 ? numUnknown / 2 : numUnknown) : 0;
+                    std::size_t rightSplit = numR == 0 ? (numUnknown - leftSplit) : 0;
+
+                    for (std::size_t i = 0, n = std::min(leftSplit, BLOCK_SIZE); i < n; ++i) {
+                        offsetsL[numL] = static_cast<unsigned char>(i);
+                        numL += !comp(*first, pivot);
+                        ++first;
+                    }
+                    for (std::size_t i = 0, n = std::min(rightSplit, BLOCK_SIZE); i < n;) {
+                        offsetsR[numR] = static_cast<unsigned char>(++i);
+                        numR += comp(*--last, pivot);
+                    }
+
+                    std::size_t num = std::min(numL, numR);
+                    swapOffsets(offsetsLBase, offsetsRBase, offsetsL + startL, offsetsR + startR, num, numL == numR);
+                    numL -= num;
+                    numR -= num;
+                    startL += num;
+                    startR += num;
+                    if (numL == 0) {
+                        startL = 0;
+                        offsetsLBase = first;
+                    }
+                    if (numR == 0) {
+                        startR = 0;
+                        offsetsRBase = last;
+                    }
+                }
+
+                // one buffer may still hold misplaced elements, which go to
+                // the far end of the part that is left
+                if (numL) {
+                    while (numL--) {
+                        std::iter_swap(offsetsLBase + offsetsL[startL + numL], --last);
+                    }
+                    first = last;
+                }
+                if (numR) {
+                    while (numR--) {
+                        std::iter_swap(offsetsRBase - offsetsR[startR + numR], first);
+                        ++first;
+                    }
+                    last = first;
+                }
+            }
+
+            Iter pivotPos = first - 1;
+            *begin = std::move(*pivotPos);
+            *pivotPos = std::move(pivot);
+            return {pivotPos, alreadyPartitioned};
+        }
+
+        // Partitions around the pivot at begin with elements equal to it going
+        // left, which are then done. Used when the pivot equals the element
+        // before the range, so runs of equal keys take linear time.
+        template<class Iter, class Compare>
+        Iter partitionLeft(Iter begin, Iter end, Compare comp) {
+            typedef typename std::iterator_traits<Iter>::value_type T;
+            T pivot(std::move(*begin));
+            Iter first = begin;
+            Iter last = end;
+
+            while (comp(pivot, *--last));
+            if (last + 1 == end) {
+                while (first < last && !comp(pivot, *++first));
+            } else {
+                while (!comp(pivot, *++first));
+            }
+
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (comp(pivot, *--last));
+                while (!comp(pivot, *++first));
+            }
+
+            Iter pivotPos = last;
+            *begin = std::move(*pivotPos);
+            *pivotPos = std::move(pivot);
+            return pivotPos;
+        }
+
+        template<bool Branchless, class Iter, class Compare>
+        void pdqsortLoop(Iter begin, Iter end, Compare comp, int badAllowed, bool leftmost = true) {
+            while (true) {
+                std::ptrdiff_t size = end - begin;
+                if (size < INSERTION_SORT_THRESHOLD) {
+                    if (leftmost) {
+                        insertionSort(begin, end, comp);
+                    } else {
+                        unguardedInsertionSort(begin, end, comp);
+                    }
+                    return;
+                }
+
+                // median of three, or the pseudomedian of nine for large ranges,
+                // ends up at begin
+                std::ptrdiff_t s2 = size / 2;
+                if (size > NINTHER_THRESHOLD) {
+                    sort3(begin, begin + s2, end - 1, comp);
+                    sort3(begin + 1, begin + (s2 - 1), end - 2, comp);
+                    sort3(begin + 2, begin + (s2 + 1), end - 3, comp);
+                    sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), comp);
+                    std::iter_swap(begin, begin + s2);
+                } else {
+                    sort3(begin + s2, begin, end - 1, comp);
+                }
+
+                if (!leftmost && !comp(*(begin - 1), *begin)) {
+                    begin = partitionLeft(begin, end, comp) + 1;
+                    continue;
+                }
+
+                std::pair<Iter, bool> part = Branchless ? partitionRightBranchless(begin, end, comp)
+                                                        : partitionRight(begin, end, comp);
+                Iter pivotPos = part.first;
+                bool alreadyPartitioned = part.second;
+
+                std::ptrdiff_t sizeL = pivotPos - begin;
+                std::ptrdiff_t sizeR = end - (pivotPos + 1);
+                if (sizeL < size / 8 || sizeR < size / 8) {
+                    // too many bad pivots means an adversarial input, which
+                    // heapsort finishes in n log n
+                    if (--badAllowed == 0) {
+                        std::make_heap(begin, end, comp);
+                        std::sort_heap(begin, end, comp);
+                        return;
+                    }
+
+                    // otherwise shuffle a few elements to break up the pattern
+                    if (sizeL >= INSERTION_SORT_THRESHOLD) {
+                        std::iter_swap(begin, begin + sizeL / 4);
+                        std::iter_swap(pivotPos - 1, pivotPos - sizeL / 4);
+                        if (sizeL > NINTHER_THRESHOLD) {
+                            std::iter_swap(begin + 1, begin + (sizeL / 4 + 1));
+                            std::iter_swap(begin + 2, begin + (sizeL / 4 + 2));
+                            std::iter_swap(pivotPos - 2, pivotPos - (sizeL / 4 + 1));
+                            std::iter_swap(pivotPos - 3, pivotPos - (sizeL / 4 + 2));
+                        }
+                    }
+                    if (sizeR >= INSERTION_SORT_THRESHOLD) {
+                        std::iter_swap(pivotPos + 1, pivotPos + (1 + sizeR / 4));
+                        std::iter_swap(end - 1, end - sizeR / 4);
+                        if (sizeR > NINTHER_THRESHOLD) {
+                            std::iter_swap(pivotPos + 2, pivotPos + (2 + sizeR / 4));
+                            std::iter_swap(pivotPos + 3, pivotPos + (3 + sizeR / 4));
+                            std::iter_swap(end - 2, end - (1 + sizeR / 4));
+                            std::iter_swap(end - 3, end - (2 + sizeR / 4));
+                        }
+                    }
+                } else if (alreadyPartitioned &&
+                           partialInsertionSort(begin, pivotPos, comp) &&
+                           partialInsertionSort(pivotPos + 1, end, comp)) {
+                    // a range that needed no swaps is likely sorted already
+                    return;
+                }
+
+                pdqsortLoop<Branchless>(begin, pivotPos, comp, badAllowed, leftmost);
+                begin = pivotPos + 1;
+                leftmost = false;
+            }
+        }
+
+        // merges the sorted runs [a, a + na) and [b, b + nb) into out, taking
+        // from a on ties
+        template<class T, class Compare>
+        void merge(const T* a, std::size_t na, const T* b, std::size_t nb, T* out, Compare comp) {
+            std::merge(a, a + na, b, b + nb, out, [&](const T& x, const T& y) { return comp(x, y); });
+        }
+    }
+
+    // Sorts [begin, end). Branchless partitioning pays off for comparators that
+    // are a single instruction, such as std::less on integers.
+    template<bool Branchless = false, class Iter, class Compare>
+    void pdqsort(Iter begin, Iter end, Compare comp) {
+        if (end - begin < 2) return;
+        detail::pdqsortLoop<Branchless>(begin, end, comp, detail::log2(end - begin));
+    }
+
+    // below this many elements a sort stays on the calling thread
+    const std::size_t PARALLEL_THRESHOLD = std::size_t(1) << 17;
+
+    // Sorts data[0, n) on up to workers threads: each pdqsorts a run of its
+    // own, then the runs are merged pairwise until one is left. A merge of two
+    // runs is itself split between the threads, cutting both runs where the
+    // output splits evenly, so the last merge is not left to a single thread.
+    template<bool Branchless = false, class T, class Compare>
+    void parallelSort(T* data, std::size_t n, Compare comp, unsigned int workers) {
+        if (workers < 2 || n < 2 * workers) {
+            pdqsort<Branchless>(data, data + n, comp);
+            return;
+        }
+
+        std::vector<std::size_t> bounds(workers + 1);
+        for (unsigned int i = 0; i <= workers; ++i) {
+            bounds[i] = n * i / workers;
+        }
+
+        std::vector<std::thread> threads;
+        for (unsigned int i = 0; i < workers; ++i) {
+            threads.emplace_back([=]() { pdqsort<Branchless>(data + bounds[i], data + bounds[i + 1], comp); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        std::vector<T> buffer(n);
+        T* from = data;
+        T* to = buffer.data();
+        while (bounds.size() > 2) {
+            std::vector<std::size_t> merged;
+            threads.clear();
+            std::size_t pairs = (bounds.size() - 1) / 2;
+            unsigned int perMerge = std::max(1u, workers / unsigned(pairs));
+
+            for (std::size_t run = 0; run + 1 < bounds.size(); run += 2) {
+                merged.push_back(bounds[run]);
+                if (run + 2 >= bounds.size()) {
+                    // an odd run out is copied over as it is
+                    std::move(from + bounds[run], from + bounds[run + 1], to + bounds[run]);
+                    continue;
+                }
+
+                const T* a = from + bounds[run];
+                const T* b = from + bounds[run + 1];
+                std::size_t na = bounds[run + 1] - bounds[run];
+                std::size_t nb = bounds[run + 2] - bounds[run + 1];
+                T* out = to + bounds[run];
+
+                // piece p of the merge covers the output from a[i] on, where i
+                // steps through a and b is cut at the first element not below a[i]
+                std::size_t prevA = 0, prevB = 0;
+                for (unsigned int p = 1; p <= perMerge; ++p) {
+                    std::size_t cutA = p == perMerge ? na : na * p / perMerge;
+                    std::size_t cutB = p == perMerge ? nb :
+                        std::lower_bound(b, b + nb, a[cutA], [&](const T& x, const T& y) { return comp(x, y); }) - b;
+                    cutB = std::max(cutB, prevB);
+                    threads.emplace_back([=]() {
+                        detail::merge(a + prevA, cutA - prevA, b + prevB, cutB - prevB, out + prevA + prevB, comp);
+                    });
+                    prevA = cutA;
+                    prevB = cutB;
+                }
+            }
+            merged.push_back(n);
+
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            bounds = std::move(merged);
+            std::swap(from, to);
+        }
+
+        if (from != data) {
+            std::move(from, from + n, data);
+        }
+    }
+
+    // Stable merge sort for comparators that may not be a strict weak order,
+    // such as a Monkey function: whatever comp answers, every access stays in
+    // bounds. Already ordered neighbouring runs are not merged, so sorted
+    // input takes n - 1 comparisons.
+    template<class T, class Compare>
+    void stableSort(std::vector<T>& items, Compare comp) {
+        const std::size_t RUN = 16;
+        std::size_t n = items.size();
+
+        for (std::size_t begin = 0; begin < n; begin += RUN) {
+            std::size_t end = std::min(n, begin + RUN);
+            for (std::size_t i = begin + 1; i < end; ++i) {
+                T tmp = std::move(items[i]);
+                std::size_t j = i;
+                for (; j > begin && comp(tmp, items[j - 1]); --j) {
+                    items[j] = std::move(items[j - 1]);
+                }
+                items[j] = std::move(tmp);
+            }
+        }
+
+        std::vector<T> buffer(n);
+        for (std::size_t width = RUN; width < n; width *= 2) {
+            for (std::size_t begin = 0; begin + width < n; begin += 2 * width) {
+                std::size_t mid = begin + width;
+                std::size_t end = std::min(n, begin + 2 * width);
+                if (!comp(items[mid], items[mid - 1])) {
+                    continue;
+                }
+
+                std::size_t i = begin, j = mid, k = begin;
+                while (i < mid && j < end) {
+                    buffer[k++] = comp(items[j], items[i]) ? std::move(items[j++]) : std::move(items[i++]);
+                }
+                while (i < mid) buffer[k++] = std::move(items[i++]);
+                while (j < end) buffer[k++] = std::move(items[j++]);
+                std::move(buffer.begin() + begin, buffer.begin() + end, items.begin() + begin);
+            }
+        }
+    }
+}
+
+#endif // SORT_H
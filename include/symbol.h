@@ -0,0 +1,30 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Process-wide table of interned names. Every distinct name gets a small
+// id once and keeps it for the life of the process, so names can be
+// compared and used as keys without touching their characters.
+namespace symbol {
+    typedef uint32_t Id;
+
+    // never handed out, marks a name that was not interned
+    const Id NONE = 0;
+    // string literals longer than this are not interned by the parser
+    const std::size_t LITERAL_MAX = 64;
+
+    // the id of name, interning it on first use; safe to call from any thread
+    Id Intern(std::string_view name);
+    // the id of name if it was interned before, NONE otherwise
+    Id Find(std::string_view name);
+    // the text behind id, valid for the life of the process
+    const std::string& Name(Id id);
+    // names interned so far
+    std::size_t Count();
+}
+
+#endif // SYMBOL_H
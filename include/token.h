@@ -49,7 +49,7 @@ namespace token {
     const TokenType RETURN    = "RETURN";
 }
 
-token::TokenType LookupIdent(std::string ident);
+token::TokenType LookupIdent(const std::string& ident);
 token::Token newToken(token::TokenType tokenType, unsigned char ch);
 token::Token newToken(token::TokenType tokenType, std::string literal);
 
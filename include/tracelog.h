@@ -7,7 +7,8 @@
 
 class Tracelog {
 public:
-    static int nestingLevel;
+    // per thread, so parsers on different threads indent independently
+    static thread_local int nestingLevel;
 
 #ifdef ENABLE_TRACING
     Tracelog(const std::string& functionName, token::Token curToken) 
@@ -0,0 +1,63 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include "object.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace object {
+    // Deep copies values out of one isolate for another, since isolates may
+    // only share objects nothing writes to. Copies take the text buffers of
+    // Strings along instead of copying them, builtins, frozen values and
+    // the true, false and null singletons are not copied at all, and the
+    // copy of a Channel or Promise is another handle on the same channel or
+    // operation. Values that hold themselves cannot be copied, nor can
+    // sequences.
+    //
+    // A Function is only copied for a target session: its copy gets a scope
+    // of its own under target, holding copies of the values the body names
+    // from outside of it.
+    class Transfer {
+    public:
+        explicit Transfer(Environment* target = nullptr) : target(target) {}
+        Transfer(const Transfer&) = delete;
+        Transfer& operator=(const Transfer&) = delete;
+        // frees every copy the caller has not taken over
+        ~Transfer();
+
+        // nullptr once copy holds the copy of value, otherwise the Error to return
+        Error* Copy(Object* value, Object*& copy);
+
+        // every object copied so far, each after the ones it holds; the
+        // caller takes them over
+        std::vector<Object*> release();
+        // the frozen heaps the copies point into, which the caller holds
+        // until a session does; with a target, that session holds them
+        std::vector<std::shared_ptr<FrozenHeap>> releaseFrozen();
+        // the scopes made for copied functions, which the caller deletes
+        // once the functions are gone
+        std::vector<Environment*> releaseScopes();
+
+    private:
+        Environment* target;
+        // nullptr while the copy of a container is still being made
+        std::map<Object*, Object*> copies;
+        std::vector<Object*> made;
+        std::vector<Environment*> scopes;
+        std::vector<std::shared_ptr<FrozenHeap>> frozen;
+        std::set<std::uint32_t> frozenIds;
+        std::string failure;
+
+        Object* copyValue(Object* value);
+        Object* copyFunction(Function* fn);
+        // records copy as the copy of value once it is complete
+        Object* finish(Object* value, Object* copy);
+    };
+}
+
+#endif // TRANSFER_H
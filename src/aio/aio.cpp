@@ -0,0 +1,383 @@
+#include "../../include/aio.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace aio {
+    // entries in each io_uring queue, completions beyond it are kept by the
+    // kernel until there is room
+    static const unsigned RING_ENTRIES = 256;
+    // threads making blocking calls when there is no io_uring
+    static const std::size_t FALLBACK_THREADS = 4;
+    // the first read into an empty buffer, each later one doubles it
+    static const std::size_t READ_CHUNK = 64 << 10;
+
+    static const int READ_FLAGS  = O_RDONLY | O_CLOEXEC;
+    static const int WRITE_FLAGS = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    static const mode_t WRITE_MODE = 0644;
+
+    void Operation::wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!finished) {
+            scheduler::Waiter waiter;
+            waiters.push_back(&waiter);
+            // the operation holds off a stall, a thread only gives up on a
+            // spurious one and waits again
+            if (!waiter.wait(guard)) {
+                waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+            }
+        }
+    }
+
+    bool Operation::done() {
+        std::lock_guard<std::mutex> guard(lock);
+        return finished;
+    }
+
+    void Operation::fail(int error) {
+        std::string target = path.empty() ? "descriptor " + std::to_string(fd) : path;
+        std::string verb;
+        if (stage == Stage::Open) {
+            verb = "open ";
+        } else {
+            verb = kind == Kind::Read ? "read " : "write to ";
+        }
+        failure = "could not " + verb + target + ": " + std::system_category().message(error);
+        finish();
+    }
+
+    void Operation::finish() {
+        if (!path.empty() && fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        if (kind == Kind::Read && failure.empty()) {
+            data.resize(bytes);
+            result = std::make_shared<const std::string>(std::move(data));
+        }
+        data = std::string();
+
+        // self may be the last reference, it goes once the lock is free
+        std::shared_ptr<Operation> keep = std::move(self);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            finished = true;
+            for (scheduler::Waiter* waiter : waiters) {
+                waiter->wake();
+            }
+            waiters.clear();
+        }
+        scheduler::Release();
+    }
+
+    // room for the next read, growing the buffer once it is full
+    static void growForRead(std::string& data, std::int64_t bytes) {
+        if (std::size_t(bytes) == data.size()) {
+            data.resize(std::max(READ_CHUNK, data.size() * 2));
+        }
+    }
+
+    // An io_uring ring set up through the raw system calls, with one thread
+    // reaping its completions. Any thread submits; each completion moves its
+    // operation on to the next step, which the reactor thread submits.
+    class Reactor {
+    public:
+        // nullptr when the kernel does not give us a ring
+        static Reactor* get() {
+            static Reactor* reactor = start();
+            return reactor;
+        }
+
+        void submit(Operation* op) {
+            std::lock_guard<std::mutex> guard(submitLock);
+
+            unsigned tail = *sqTail;
+            unsigned index = tail & sqMask;
+            io_uring_sqe* sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            prepare(op, sqe);
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            unsubmitted++;
+
+            // every entry is handed to the kernel before the lock is
+            // released, so the queue never fills up
+            while (unsubmitted > 0) {
+                long submitted = syscall(__NR_io_uring_enter, ring, unsubmitted, 0, 0, nullptr, 0);
+                if (submitted < 0) {
+                    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+                    std::this_thread::yield();
+                    continue;
+                }
+                unsubmitted -= submitted;
+            }
+        }
+
+    private:
+        int ring;
+        unsigned* sqTail;
+        unsigned sqMask;
+        unsigned* sqArray;
+        io_uring_sqe* sqes;
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+
+        std::mutex submitLock;
+        unsigned unsubmitted = 0;
+        // reaped by run, only touched by the reactor thread
+        std::vector<std::pair<Operation*, int>> completed;
+
+        static Reactor* start() {
+            if (std::getenv("MONKEY_NO_IO_URING") != nullptr) {
+                return nullptr;
+            }
+
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+            if (fd < 0) {
+                return nullptr;
+            }
+
+            std::size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            std::size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) {
+                sqSize = cqSize = std::max(sqSize, cqSize);
+            }
+
+            void* sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            void* cq = single ? sq :
+                mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            void* entries = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            // reads and writes at the current position need 5.6
+            if (sq == MAP_FAILED || cq == MAP_FAILED || entries == MAP_FAILED ||
+                    (params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+                ::close(fd);
+                return nullptr;
+            }
+
+            char* sqBase = static_cast<char*>(sq);
+            char* cqBase = static_cast<char*>(cq);
+            Reactor* reactor = new Reactor();
+            reactor->ring    = fd;
+            reactor->sqTail  = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+            reactor->sqMask  = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+            reactor->sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+            reactor->sqes    = static_cast<io_uring_sqe*>(entries);
+            reactor->cqHead  = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+            reactor->cqTail  = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+            reactor->cqMask  = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+            reactor->cqes    = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+            std::thread(&Reactor::run, reactor).detach();
+            return reactor;
+        }
+
+        static void prepare(Operation* op, io_uring_sqe* sqe) {
+            sqe->user_data = reinterpret_cast<std::uint64_t>(op);
+            if (op->stage == Operation::Stage::Open) {
+                bool read = op->kind == Operation::Kind::Read;
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<std::uint64_t>(op->path.c_str());
+                sqe->open_flags = read ? READ_FLAGS : WRITE_FLAGS;
+                sqe->len = read ? 0 : WRITE_MODE;
+                return;
+            }
+
+            sqe->opcode = op->kind == Operation::Kind::Read ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->fd = op->fd;
+            sqe->addr = reinterpret_cast<std::uint64_t>(op->data.data() + op->bytes);
+            sqe->len = op->data.size() - op->bytes;
+            // from the current position, which also suits pipes
+            sqe->off = std::uint64_t(-1);
+        }
+
+        void run() {
+            for (;;) {
+                long waited = syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (waited < 0 && errno != EINTR) {
+                    continue;
+                }
+
+                // Taking the lock orders each step after the submit of the
+                // entry that completed, which holds it until the kernel has
+                // the entry, so a step sees the operation as it was left.
+                completed.clear();
+                {
+                    std::lock_guard<std::mutex> guard(submitLock);
+                    unsigned head = *cqHead;
+                    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                    for (; head != tail; ++head) {
+                        io_uring_cqe* cqe = &cqes[head & cqMask];
+                        completed.push_back({reinterpret_cast<Operation*>(cqe->user_data), cqe->res});
+                    }
+                    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                }
+                for (const std::pair<Operation*, int>& completion : completed) {
+                    step(completion.first, completion.second);
+                }
+            }
+        }
+
+        void step(Operation* op, int res) {
+            if (res == -EINTR || res == -EAGAIN) {
+                submit(op);
+                return;
+            }
+            if (res < 0) {
+                op->fail(-res);
+                return;
+            }
+
+            if (op->stage == Operation::Stage::Open) {
+                op->fd = res;
+            } else if (res == 0) {
+                // the end of what there is to read, a write that moves
+                // nothing would never finish
+                if (op->kind == Operation::Kind::Read) {
+                    op->finish();
+                } else {
+                    op->fail(EIO);
+                }
+                return;
+            } else {
+                op->bytes += res;
+            }
+
+            if (op->kind == Operation::Kind::Read) {
+                growForRead(op->data, op->bytes);
+            } else if (std::size_t(op->bytes) == op->data.size()) {
+                op->finish();
+                return;
+            }
+            op->stage = Operation::Stage::Transfer;
+            submit(op);
+        }
+    };
+
+    // Runs each operation start to end with blocking calls, for kernels
+    // without io_uring.
+    class Threads {
+    public:
+        static Threads& get() {
+            static Threads* threads = new Threads();
+            return *threads;
+        }
+
+        void submit(Operation* op) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                queue.push_back(op);
+            }
+            available.notify_one();
+        }
+
+    private:
+        std::mutex lock;
+        std::condition_variable available;
+        std::deque<Operation*> queue;
+
+        Threads() {
+            for (std::size_t i = 0; i < FALLBACK_THREADS; ++i) {
+                std::thread(&Threads::run, this).detach();
+            }
+        }
+
+        void run() {
+            for (;;) {
+                Operation* op;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    available.wait(guard, [this]() { return !queue.empty(); });
+                    op = queue.front();
+                    queue.pop_front();
+                }
+                perform(op);
+            }
+        }
+
+        static void perform(Operation* op) {
+            bool read = op->kind == Operation::Kind::Read;
+            if (op->stage == Operation::Stage::Open) {
+                op->fd = read ? ::open(op->path.c_str(), READ_FLAGS) : ::open(op->path.c_str(), WRITE_FLAGS, WRITE_MODE);
+                if (op->fd < 0) {
+                    op->fail(errno);
+                    return;
+                }
+                op->stage = Operation::Stage::Transfer;
+            }
+
+            for (;;) {
+                if (read) {
+                    growForRead(op->data, op->bytes);
+                } else if (std::size_t(op->bytes) == op->data.size()) {
+                    break;
+                }
+
+                char* at = op->data.data() + op->bytes;
+                std::size_t left = op->data.size() - op->bytes;
+                ssize_t moved = read ? ::read(op->fd, at, left) : ::write(op->fd, at, left);
+                if (moved < 0) {
+                    if (errno == EINTR) continue;
+                    op->fail(errno);
+                    return;
+                }
+                if (moved == 0) {
+                    if (read) break;
+                    op->fail(EIO);
+                    return;
+                }
+                op->bytes += moved;
+            }
+            op->finish();
+        }
+    };
+
+    std::shared_ptr<Operation> Operation::start(std::shared_ptr<Operation> op) {
+        // released once the operation finishes and has woken its waiters
+        scheduler::Hold();
+        op->self = op;
+        op->stage = op->path.empty() ? Operation::Stage::Transfer : Operation::Stage::Open;
+
+        if (op->path.empty() && op->data.empty()) {
+            op->finish();
+        } else if (Reactor* reactor = Reactor::get()) {
+            reactor->submit(op.get());
+        } else {
+            Threads::get().submit(op.get());
+        }
+        return op;
+    }
+
+    std::shared_ptr<Operation> ReadFile(const std::string& path) {
+        return Operation::start(std::make_shared<Operation>(Operation::Kind::Read, path, -1, std::string()));
+    }
+
+    std::shared_ptr<Operation> WriteFile(const std::string& path, std::string data) {
+        return Operation::start(std::make_shared<Operation>(Operation::Kind::Write, path, -1, std::move(data)));
+    }
+
+    std::shared_ptr<Operation> Write(int fd, std::string data) {
+        return Operation::start(std::make_shared<Operation>(Operation::Kind::Write, "", fd, std::move(data)));
+    }
+
+    const char* Backend() {
+        return Reactor::get() != nullptr ? "io_uring" : "threads";
+    }
+}
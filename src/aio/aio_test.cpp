@@ -0,0 +1,121 @@
+#include "../../include/aio.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+void TestWriteThenReadFile();
+void TestWritePipe();
+void TestManyInFlight();
+void TestFailures();
+
+/*
+int main() {
+    TestWriteThenReadFile();
+    TestWritePipe();
+    TestManyInFlight();
+    TestFailures();
+}
+*/
+
+static std::string tempPath(const std::string& name) {
+    return "/tmp/monkey_aio_" + std::to_string(getpid()) + "_" + name;
+}
+
+void TestWriteThenReadFile() {
+    // larger than the first read, so the buffer grows
+    std::string text;
+    for (int i = 0; text.size() < (300 << 10); ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    std::string path = tempPath("roundtrip");
+
+    std::shared_ptr<aio::Operation> write = aio::WriteFile(path, text);
+    write->wait();
+    if (!write->Failure().empty() || write->Bytes() != std::int64_t(text.size())) {
+        std::cerr << "write of " << path << " wrote " << write->Bytes() << ": " << write->Failure() << std::endl;
+    }
+
+    std::shared_ptr<aio::Operation> read = aio::ReadFile(path);
+    read->wait();
+    if (!read->Failure().empty() || read->Data() == nullptr || *read->Data() != text) {
+        std::cerr << "read back " << read->Bytes() << " bytes of " << text.size() << " (" << aio::Backend() << ")" << std::endl;
+    }
+    unlink(path.c_str());
+}
+
+void TestWritePipe() {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::cerr << "could not make a pipe" << std::endl;
+        return;
+    }
+
+    std::shared_ptr<aio::Operation> write = aio::Write(fds[1], "through the pipe");
+    write->wait();
+    char got[32] = {};
+    ssize_t n = read(fds[0], got, sizeof(got) - 1);
+    if (write->Bytes() != 16 || n != 16 || std::string(got) != "through the pipe") {
+        std::cerr << "pipe write gave " << std::string(got) << ", " << write->Failure() << std::endl;
+    }
+
+    // nothing to write finishes at once
+    std::shared_ptr<aio::Operation> empty = aio::Write(fds[1], "");
+    if (!empty->done() || empty->Bytes() != 0) {
+        std::cerr << "empty write did not finish at once" << std::endl;
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void TestManyInFlight() {
+    // more operations than the ring has entries
+    const int count = 600;
+    std::vector<std::string> paths;
+    std::vector<std::shared_ptr<aio::Operation>> ops;
+    for (int i = 0; i < count; ++i) {
+        paths.push_back(tempPath("many" + std::to_string(i)));
+        ops.push_back(aio::WriteFile(paths.back(), std::to_string(i)));
+    }
+    for (std::shared_ptr<aio::Operation>& op : ops) {
+        op->wait();
+    }
+
+    ops.clear();
+    for (const std::string& path : paths) {
+        ops.push_back(aio::ReadFile(path));
+    }
+    for (int i = 0; i < count; ++i) {
+        ops[i]->wait();
+        if (ops[i]->Data() == nullptr || *ops[i]->Data() != std::to_string(i)) {
+            std::cerr << "file " << i << " read back wrong: " << ops[i]->Failure() << std::endl;
+            break;
+        }
+    }
+    for (const std::string& path : paths) {
+        unlink(path.c_str());
+    }
+}
+
+void TestFailures() {
+    std::shared_ptr<aio::Operation> missing = aio::ReadFile("/nonexistent/file");
+    missing->wait();
+    if (missing->Failure() != "could not open /nonexistent/file: No such file or directory") {
+        std::cerr << "missing file failed with: " << missing->Failure() << std::endl;
+    }
+
+    std::shared_ptr<aio::Operation> directory = aio::ReadFile("/tmp");
+    directory->wait();
+    if (directory->Failure() != "could not read /tmp: Is a directory") {
+        std::cerr << "reading a directory failed with: " << directory->Failure() << std::endl;
+    }
+
+    std::shared_ptr<aio::Operation> closed = aio::Write(1 << 20, "x");
+    closed->wait();
+    if (closed->Failure() != "could not write to descriptor 1048576: Bad file descriptor") {
+        std::cerr << "write to a bad descriptor failed with: " << closed->Failure() << std::endl;
+    }
+}
@@ -0,0 +1,146 @@
+#include "../../include/allocator.h"
+
+#include <cstdlib>
+#include <new>
+#include <iomanip>
+
+namespace allocator {
+    // every accounted block is prefixed with the Account it was charged to,
+    // so it can be credited back regardless of which Account is active when
+    // it is freed
+    struct alignas(alignof(std::max_align_t)) Header {
+        Account*      account;
+        std::uint64_t size : 56;
+        std::uint64_t kind : 8;
+    };
+
+    const char* KindName(Kind kind) {
+        switch (kind) {
+            case Kind::Integer     : return "INTEGER";
+            case Kind::String      : return "STRING";
+            case Kind::Boolean     : return "BOOLEAN";
+            case Kind::Null        : return "NULL";
+            case Kind::ReturnValue : return "RETURN_VALUE";
+            case Kind::Error       : return "ERROR";
+            case Kind::Array       : return "ARRAY";
+            case Kind::ArrayNode   : return "ARRAY_NODE";
+            case Kind::Hash        : return "HASH";
+            case Kind::HashNode    : return "HASH_NODE";
+            case Kind::Function    : return "FUNCTION";
+            case Kind::Builtin     : return "BUILTIN";
+            case Kind::Environment : return "ENVIRONMENT";
+            case Kind::Sequence    : return "SEQUENCE";
+            case Kind::Channel     : return "CHANNEL";
+            case Kind::Promise     : return "PROMISE";
+            default                : return "OTHER";
+        }
+    }
+
+    void Stats::recordCollection(std::uint64_t nanos) {
+        collections++;
+        totalPauseNanos += nanos;
+        if (nanos > maxPauseNanos) maxPauseNanos = nanos;
+
+        std::size_t bucket = 0;
+        std::uint64_t micros = nanos / 1000;
+        while (bucket < PAUSE_BUCKETS - 1 && micros >= (std::uint64_t(1) << bucket)) {
+            bucket++;
+        }
+        pauses[bucket]++;
+    }
+
+    thread_local Account* activeAccount = nullptr;
+
+    Account* active() {
+        return activeAccount;
+    }
+
+    void setActive(Account* account) {
+        activeAccount = account;
+    }
+
+    Scope::Scope(Account* account) : previous(activeAccount) {
+        activeAccount = account;
+    }
+
+    Scope::~Scope() {
+        activeAccount = previous;
+    }
+
+    void Account::release() {
+        owners--;
+        if (owners == 0 && liveAllocations == 0) {
+            delete this;
+        }
+    }
+
+    void* allocate(std::size_t size, Kind kind) {
+        Header* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+        if (header == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        header->account = activeAccount;
+        header->size = size;
+        header->kind = static_cast<std::uint64_t>(kind);
+        if (header->account != nullptr) {
+            header->account->charge(size, kind);
+        }
+
+        return header + 1;
+    }
+
+    void deallocate(void* ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        Header* header = static_cast<Header*>(ptr) - 1;
+        Account* account = header->account;
+        if (account != nullptr) {
+            account->credit(header->size, static_cast<Kind>(header->kind));
+            if (account->owners == 0 && account->liveAllocations == 0) {
+                delete account;
+            }
+        }
+
+        std::free(header);
+    }
+}
+
+namespace allocator {
+    void PrintStats(std::ostream& out, const Account& account) {
+        const Stats& stats = account.stats;
+
+        out << "live bytes:       " << account.liveBytes << std::endl;
+        out << "peak bytes:       " << account.peakBytes << std::endl;
+        out << "bytes allocated:  " << stats.bytesAllocated << std::endl;
+        out << "bytes freed:      " << stats.bytesFreed << std::endl;
+        out << "frames created:   " << stats.allocations[static_cast<std::size_t>(Kind::Environment)] << std::endl;
+
+        out << "allocations by type:" << std::endl;
+        for (std::size_t i = 0; i < KIND_COUNT; ++i) {
+            if (stats.allocations[i] == 0) continue;
+            out << "  " << std::left << std::setw(14) << KindName(static_cast<Kind>(i)) <<
+                std::right << std::setw(12) << stats.allocations[i] << " allocated" <<
+                std::setw(12) << stats.frees[i] << " freed" << std::endl;
+        }
+
+        out << "collections:      " << stats.collections << std::endl;
+        if (stats.collections == 0) {
+            return;
+        }
+        out << "total pause:      " << stats.totalPauseNanos / 1000 << "us" << std::endl;
+        out << "max pause:        " << stats.maxPauseNanos / 1000 << "us" << std::endl;
+        out << "pause histogram:" << std::endl;
+        for (std::size_t i = 0; i < PAUSE_BUCKETS; ++i) {
+            if (stats.pauses[i] == 0) continue;
+            if (i == PAUSE_BUCKETS - 1) {
+                out << "  >= " << std::setw(8) << (std::uint64_t(1) << (i - 1)) << "us";
+            } else {
+                out << "   < " << std::setw(8) << (std::uint64_t(1) << i) << "us";
+            }
+            out << std::setw(12) << stats.pauses[i] << std::endl;
+        }
+    }
+}
@@ -0,0 +1,332 @@
+#include "../../include/batch.h"
+#include "../../include/eval.h"
+#include "../../include/isolate.h"
+#include "../../include/parser.h"
+#include "../../include/scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        failure = "could not open " + path + ": " + std::strerror(errno);
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        failure = "could not read " + path + ": " + std::strerror(errno);
+    } else if (S_ISDIR(info.st_mode)) {
+        failure = "could not read " + path + ": " + std::strerror(EISDIR);
+    } else if (S_ISREG(info.st_mode)) {
+        // an empty file has nothing to map
+        if (info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                failure = "could not map " + path + ": " + std::strerror(errno);
+            } else {
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                mapping = static_cast<char*>(mapped);
+                length = info.st_size;
+            }
+        }
+    } else {
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+            if (n < 0 && errno != EINTR) {
+                failure = "could not read " + path + ": " + std::strerror(errno);
+                break;
+            }
+            if (n > 0) {
+                contents.append(buffer, n);
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapping != nullptr) {
+        munmap(mapping, length);
+    }
+}
+
+LineReader::LineReader(int fd, std::size_t blockSize) : fd(fd), block(std::make_shared<std::string>(blockSize, '\0')) {}
+
+bool LineReader::next(std::string_view& line) {
+    for (;;) {
+        const char* data = block->data();
+        const void* newline = std::memchr(data + start, '\n', end - start);
+        if (newline != nullptr) {
+            std::size_t at = static_cast<const char*>(newline) - data;
+            line = std::string_view(data + start, at - start);
+            start = at + 1;
+            return true;
+        }
+
+        if (!fill()) {
+            // the last line need not end in a newline
+            if (!failure.empty() || start == end) {
+                return false;
+            }
+            line = std::string_view(block->data() + start, end - start);
+            start = end;
+            return true;
+        }
+    }
+}
+
+bool LineReader::fill() {
+    if (eof) {
+        return false;
+    }
+
+    const std::size_t pending = end - start;
+    if (block.use_count() > 1 || pending == block->size()) {
+        // lines in this block are still held, or one line fills all of it
+        auto fresh = std::make_shared<std::string>(std::max(block->size(), 2 * pending), '\0');
+        std::memcpy(fresh->data(), block->data() + start, pending);
+        block = std::move(fresh);
+    } else if (start > 0) {
+        std::memmove(block->data(), block->data() + start, pending);
+    }
+    start = 0;
+    end = pending;
+
+    ssize_t n;
+    do {
+        n = read(fd, block->data() + end, block->size() - end);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n < 0) {
+            failure = std::string("could not read input: ") + std::strerror(errno);
+        }
+        eof = true;
+        return false;
+    }
+    end += n;
+    return true;
+}
+
+int RunFile(const std::string& path, const allocator::Limits& limits, bool printStats) {
+    MappedFile file(path);
+    if (!file.Failure().empty()) {
+        std::cerr << file.Failure() << std::endl;
+        return 1;
+    }
+
+    // the tokens copy what they need, the mapping is only read while parsing
+    Lexer l(file.data(), file.size());
+    Parser p(l);
+    ast::Program program = p.ParseProgram();
+    if (!p.Errors().empty()) {
+        p.checkParserErrors();
+        return 1;
+    }
+
+    Isolate isolate;
+    isolate.Env()->SetLimits(limits);
+    object::Object* evaluated = isolate.Eval(program);
+    int status = 0;
+    if (evaluated != nullptr && evaluated->Type() == object::ERROR_OBJ) {
+        std::cout.flush();
+        std::cerr << evaluated->Inspect() << std::endl;
+        status = 1;
+    }
+
+    if (printStats) {
+        allocator::PrintStats(std::cerr, *isolate.Env()->account);
+    }
+    return status;
+}
+
+int RunEach(const std::string& source, int in, std::FILE* out, const allocator::Limits& limits) {
+    Lexer l(source);
+    Parser p(l);
+    ast::Program program = p.ParseProgram();
+    if (!p.Errors().empty()) {
+        p.checkParserErrors();
+        return 1;
+    }
+
+    Isolate isolate;
+    isolate.Env()->SetLimits(limits);
+    object::Object* fn = isolate.Eval(program);
+    if (fn == nullptr || fn->Type() != object::FUNCTION_OBJ) {
+        if (fn != nullptr && fn->Type() == object::ERROR_OBJ) {
+            std::cerr << fn->Inspect() << std::endl;
+        } else {
+            std::cerr << "--each needs a function, got " << (fn != nullptr ? fn->Type() : "nothing") << std::endl;
+        }
+        return 1;
+    }
+
+    object::SessionScope scope(isolate.Env());
+    allocator::Account* account = isolate.Env()->account;
+    FrameCall call(fn);
+    std::vector<object::Object*> args(1);
+    LineReader reader(in);
+    // Each line is shown through the same String for as long as the calls
+    // only bind it to their parameter. One that keeps it gets a String of
+    // its own from then on, and keeps its block from being read over.
+    object::String* line = nullptr;
+    std::string_view text;
+    std::size_t number = 0;
+    int status = 0;
+    while (reader.next(text)) {
+        number++;
+        if (line == nullptr || line->refCount > 1) {
+            line = new object::String(reader.Block(), text);
+            call.track(line);
+        } else {
+            line->Buffer = reader.Block();
+            line->Value = text;
+            line->Symbol = symbol::NONE;
+        }
+
+        startEvaluation(account);
+        args[0] = line;
+        object::Object* result = call(args);
+        // cast rather than compare Type() names, this runs for every line
+        object::String* str = result == line ? line : dynamic_cast<object::String*>(result);
+        if (result == nullptr || result == object::NULL_T.get()) {
+            // an empty body, or an if that did not match
+        } else if (str != nullptr) {
+            std::fwrite(str->Value.data(), 1, str->Value.size(), out);
+            std::fputc('\n', out);
+        } else if (object::Error* err = dynamic_cast<object::Error*>(result)) {
+            std::fflush(out);
+            std::cerr << err->Inspect() << " (line " << number << ")" << std::endl;
+            status = 1;
+            break;
+        } else {
+            std::string inspected = result->Inspect();
+            std::fwrite(inspected.data(), 1, inspected.size(), out);
+            std::fputc('\n', out);
+        }
+
+        // the String lets go of the block, so it can be read over
+        if (line->refCount <= 1) {
+            line->Buffer.reset();
+        }
+    }
+
+    if (status == 0 && !reader.Failure().empty()) {
+        std::cerr << reader.Failure() << std::endl;
+        status = 1;
+    }
+    // nothing is left to inspect the String, which must not go with no block
+    if (line != nullptr && line->Buffer == nullptr) {
+        line->Buffer = reader.Block();
+        line->Value = std::string_view();
+    }
+    return status;
+}
+
+int RunMap(const std::string& path, const std::vector<std::string>& inputs, std::FILE* out,
+        const allocator::Limits& limits) {
+    MappedFile file(path);
+    if (!file.Failure().empty()) {
+        std::cerr << file.Failure() << std::endl;
+        return 1;
+    }
+    Lexer l(file.data(), file.size());
+    Parser p(l);
+    ast::Program program = p.ParseProgram();
+    if (!p.Errors().empty()) {
+        p.checkParserErrors();
+        return 1;
+    }
+
+    // what a run printed, or why it failed, for the writer to take in order
+    struct Run {
+        std::string output;
+        std::string failure;
+        bool finished = false;
+    };
+    std::vector<Run> runs(inputs.size());
+    std::mutex lock;
+    std::condition_variable changed;
+    std::atomic<std::size_t> nextInput{0};
+    std::size_t workers = std::min(scheduler::Workers(), inputs.size());
+    const symbol::Id input = symbol::Intern("input");
+
+    for (std::size_t w = 0, count = workers; w < count; ++w) {
+        // every task is done before this returns, so they may use its locals
+        scheduler::Spawn([&]() {
+            Isolate* isolate = new Isolate();
+            object::Environment* env = isolate->Env();
+            env->SetLimits(limits);
+            std::ostringstream printed;
+            env->out = &printed;
+            // the last file's contents, read over once nothing shows them
+            std::shared_ptr<std::string> contents = std::make_shared<std::string>();
+
+            for (std::size_t i; (i = nextInput.fetch_add(1)) < inputs.size();) {
+                Run run;
+                MappedFile data(inputs[i]);
+                if (!data.Failure().empty()) {
+                    run.failure = data.Failure();
+                } else {
+                    if (contents.use_count() > 1) {
+                        contents = std::make_shared<std::string>();
+                    }
+                    contents->assign(data.data(), data.size());
+
+                    object::SessionScope scope(env);
+                    env->Set(input, new object::String(contents));
+                    object::Object* evaluated = isolate->Eval(program);
+                    if (evaluated != nullptr && evaluated->Type() == object::ERROR_OBJ) {
+                        run.failure = inputs[i] + ": " + evaluated->Inspect();
+                    }
+                    run.output = printed.str();
+                    printed.str("");
+                    isolate->Reset();
+                }
+
+                std::lock_guard<std::mutex> guard(lock);
+                runs[i] = std::move(run);
+                runs[i].finished = true;
+                changed.notify_all();
+            }
+
+            delete isolate;
+            std::lock_guard<std::mutex> guard(lock);
+            workers--;
+            changed.notify_all();
+        });
+    }
+
+    int status = 0;
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+        Run run;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return runs[i].finished; });
+            run = std::move(runs[i]);
+        }
+        std::fwrite(run.output.data(), 1, run.output.size(), out);
+        if (!run.failure.empty()) {
+            std::fflush(out);
+            std::cerr << run.failure << std::endl;
+            status = 1;
+        }
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&]() { return workers == 0; });
+    return status;
+}
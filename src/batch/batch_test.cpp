@@ -0,0 +1,227 @@
+#include "../../include/batch.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+void TestMappedFile();
+void TestRunFile();
+void TestLineReader();
+void TestRunEach();
+void TestRunMap();
+
+/*
+int main() {
+    TestMappedFile();
+    TestRunFile();
+    TestLineReader();
+    TestRunEach();
+    TestRunMap();
+}
+*/
+
+static std::string writeTemp(const std::string& name, const std::string& contents) {
+    std::string path = "/tmp/monkey_batch_" + std::to_string(getpid()) + "_" + name;
+    std::ofstream(path) << contents;
+    return path;
+}
+
+void TestMappedFile() {
+    std::string text = "let a = 1;\nlet b = 2;\n";
+    std::string path = writeTemp("mapped.mk", text);
+    {
+        MappedFile file(path);
+        if (!file.Failure().empty() || std::string(file.data(), file.size()) != text) {
+            std::cerr << "mapped file reads back wrong: " << file.Failure() << std::endl;
+        }
+    }
+    unlink(path.c_str());
+
+    // not a regular file, so read rather than mapped
+    MappedFile device("/dev/null");
+    if (!device.Failure().empty() || device.size() != 0) {
+        std::cerr << "/dev/null read as " << device.size() << " bytes: " << device.Failure() << std::endl;
+    }
+
+    MappedFile missing("/nonexistent/script.mk");
+    if (missing.Failure() != "could not open /nonexistent/script.mk: No such file or directory") {
+        std::cerr << "missing file failed with: " << missing.Failure() << std::endl;
+    }
+    MappedFile directory("/tmp");
+    if (directory.Failure() != "could not read /tmp: Is a directory") {
+        std::cerr << "directory failed with: " << directory.Failure() << std::endl;
+    }
+}
+
+void TestRunFile() {
+    struct Test {
+        std::string script;
+        int expected;
+        std::string message;
+    };
+
+    allocator::Limits limits;
+    limits.depth = 100;
+    Test tests[] {
+        // a function spread over lines, which the REPL cannot take
+        {"let add = fn(a, b) {\n    a + b\n};\nlet r = add(1, 2);\nif (r != 3) { r + true }\n", 0, ""},
+        {"", 0, ""},
+        {"let f = fn(x) {\n    x + true\n};\nf(1)\n", 1, "ERROR: type mismatch: BOOLEAN + INTEGER\n"},
+        {"let x = ;\n", 1, "ERROR::PARSER: Parser has errors: (1)\n"},
+        {"let f = fn() { f() };\nf()\n", 1, "ERROR: call depth exceeded: limit is 100 nested calls\n"},
+    };
+
+    std::stringstream errors;
+    std::streambuf* stderrBuf = std::cerr.rdbuf(errors.rdbuf());
+    for (Test& test : tests) {
+        std::string path = writeTemp("run.mk", test.script);
+        errors.str("");
+        int status = RunFile(path, limits);
+        unlink(path.c_str());
+
+        std::string got = errors.str();
+        if (status != test.expected || got.rfind(test.message, 0) != 0) {
+            std::cerr.rdbuf(stderrBuf);
+            std::cerr << "script exited with " << status << ", want=" << test.expected << ", said " << got << test.script << std::endl;
+            stderrBuf = std::cerr.rdbuf(errors.rdbuf());
+        }
+    }
+
+    errors.str("");
+    int status = RunFile("/nonexistent/script.mk");
+    std::cerr.rdbuf(stderrBuf);
+    if (status != 1 || errors.str() != "could not open /nonexistent/script.mk: No such file or directory\n") {
+        std::cerr << "missing script exited with " << status << ", said " << errors.str() << std::endl;
+    }
+}
+
+void TestLineReader() {
+    // a block of 8 bytes, so lines straddle blocks and some outgrow one
+    std::string text = "one\ntwo\n\nthree and more\nfour\nlast";
+    std::vector<std::string> want = {"one", "two", "", "three and more", "four", "last"};
+    std::string path = writeTemp("lines.txt", text);
+    int fd = open(path.c_str(), O_RDONLY);
+
+    LineReader reader(fd, 8);
+    std::vector<std::string> got;
+    std::string_view line;
+    // holding the first block keeps its lines as they were
+    std::shared_ptr<std::string> held;
+    std::string_view first;
+    while (reader.next(line)) {
+        if (held == nullptr) {
+            held = reader.Block();
+            first = line;
+        }
+        got.push_back(std::string(line));
+    }
+    close(fd);
+    unlink(path.c_str());
+
+    if (got != want || first != "one" || !reader.Failure().empty()) {
+        std::cerr << "lines read back wrong, got " << got.size() << " lines, first=" << first << std::endl;
+    }
+}
+
+void TestRunEach() {
+    struct Test {
+        std::string function;
+        std::string input;
+        int expected;
+        std::string output;
+    };
+
+    Test tests[] {
+        {"fn(line) { line }", "a\nbb\nccc\n", 0, "a\nbb\nccc\n"},
+        {"fn(line) { if (len(line) > 1) { line + \"!\" } }", "a\nbb\n\nccc", 0, "bb!\nccc!\n"},
+        {"let n = 10; fn(line) { len(line) * n }", "a\nbb\n", 0, "10\n20\n"},
+        {"fn(line) { }", "a\n", 0, ""},
+        {"fn(line) { if (line == \"b\") { line + 1 } else { line } }", "a\nb\nc\n", 1, "a\n"},
+        {"5", "a\n", 1, ""},
+    };
+
+    std::stringstream errors;
+    std::streambuf* stderrBuf = std::cerr.rdbuf(errors.rdbuf());
+    for (Test& test : tests) {
+        std::string path = writeTemp("each.txt", test.input);
+        int in = open(path.c_str(), O_RDONLY);
+        std::FILE* out = std::tmpfile();
+
+        int status = RunEach(test.function, in, out);
+        std::fflush(out);
+        std::rewind(out);
+        std::string output;
+        char buffer[256];
+        std::size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), out)) > 0) {
+            output.append(buffer, n);
+        }
+        std::fclose(out);
+        close(in);
+        unlink(path.c_str());
+
+        if (status != test.expected || output != test.output) {
+            std::cerr.rdbuf(stderrBuf);
+            std::cerr << test.function << " exited with " << status << ", wrote " << output << std::endl;
+            stderrBuf = std::cerr.rdbuf(errors.rdbuf());
+        }
+    }
+    std::cerr.rdbuf(stderrBuf);
+
+    if (errors.str() != "ERROR: type mismatch: INTEGER + STRING (line 2)\n--each needs a function, got INTEGER\n") {
+        std::cerr << "--each reported " << errors.str() << std::endl;
+    }
+}
+
+void TestRunMap() {
+    // more files than workers, each printing what it was given
+    std::vector<std::string> inputs;
+    std::string want;
+    for (int i = 0; i < 40; ++i) {
+        std::string text = std::string(i, 'x');
+        inputs.push_back(writeTemp("map" + std::to_string(i) + ".txt", text));
+        want += std::to_string(i) + "\n";
+        if (i % 2 == 0) {
+            want += text + "\n";
+        }
+    }
+    // a binding from the last file must not be seen by the next
+    std::string script = writeTemp("map.mk",
+            "let n = len(input);\nputs(n);\nif (n / 2 * 2 == n) { puts(input) }\nlet seen = n;\n");
+    inputs.push_back("/nonexistent/input.txt");
+
+    std::stringstream errors;
+    std::streambuf* stderrBuf = std::cerr.rdbuf(errors.rdbuf());
+    std::FILE* out = std::tmpfile();
+    int status = RunMap(script, inputs, out);
+    std::cerr.rdbuf(stderrBuf);
+
+    std::fflush(out);
+    std::rewind(out);
+    std::string output;
+    char buffer[256];
+    std::size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), out)) > 0) {
+        output.append(buffer, n);
+    }
+    std::fclose(out);
+
+    if (status != 1 || output != want) {
+        std::cerr << "--map exited with " << status << ", wrote:\n" << output << std::endl;
+    }
+    if (errors.str() != "could not open /nonexistent/input.txt: No such file or directory\n") {
+        std::cerr << "--map reported " << errors.str() << std::endl;
+    }
+
+    inputs.pop_back();
+    for (const std::string& path : inputs) {
+        unlink(path.c_str());
+    }
+    unlink(script.c_str());
+}
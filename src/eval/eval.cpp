@@ -2,9 +2,26 @@
 #include <iostream>
 
 object::Object* Eval(ast::Node* node, object::Environment* env) {
+    allocator::Account* account = env->account;
+    if (account->overBudget) {
+        return newMemoryBudgetError(account);
+    }
+    // the limits besides depth are looked at once every so many steps, a
+    // Program starts the count over
+    if (--account->stepsToCheck == 0) [[unlikely]] {
+        if (node->GetType() != ast::NodeType::Program) {
+            object::Object* exceeded = checkLimits(account);
+            if (exceeded != nullptr) {
+                return exceeded;
+            }
+        }
+    }
+
     switch(node->GetType()) {
         case ast::NodeType::Program :
             {
+                object::SessionScope scope(env);
+                startEvaluation(account);
                 return evalProgram(dynamic_cast<ast::Program*>(node)->Statements, env);
             }
         case ast::NodeType::Identifier :
@@ -23,6 +40,7 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
             {
                 ast::StringLiteral* strlit = dynamic_cast<ast::StringLiteral*>(node);
                 object::String* strlitObj = new object::String(strlit->Value);
+                strlitObj->Symbol = strlit->Symbol;
                 env->heap.push_back(strlitObj);
                 return strlitObj;
             }
@@ -36,7 +54,7 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
                 ast::PrefixExpression* prexpr = dynamic_cast<ast::PrefixExpression*>(node);
                 object::Object* right = Eval(prexpr->Right, env);
                 if (isError(right)) return right;
-                return evalPrefixExpression(prexpr->Operator, right);
+                return trackTemporary(evalPrefixExpression(prexpr->Operator, right), env);
             }
         case ast::NodeType::InfixExpression :
             {
@@ -45,7 +63,7 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
                 if (isError(left)) return left;
                 object::Object* right = Eval(infexpr->Right, env);
                 if (isError(right)) return right;
-                return evalInfixExpression(infexpr->Operator, left, right);
+                return trackTemporary(evalInfixExpression(infexpr->Operator, left, right), env);
             }
         case ast::NodeType::BlockStatement :
             {
@@ -78,13 +96,13 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
             {
                 // TODO: error handle a + b = 20;
                 ast::AssignExpression* asexpr = dynamic_cast<ast::AssignExpression*>(node);
-                std::pair<object::Object*, bool> valOk = env->Get(asexpr->Left->Value);
+                std::pair<object::Object*, bool> valOk = env->Get(asexpr->Left->Symbol);
                 if (!valOk.second) {
                     return new object::Error("identifier not found: " + asexpr->Left->Value);
                 }
 
                 object::Object* right = Eval(asexpr->Right, env);
-                env->Set(asexpr->Left->Value, right);
+                env->Set(asexpr->Left->Symbol, right);
                 return nullptr;
             }
         case ast::NodeType::CallExpression :
@@ -108,7 +126,7 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
                     return elements[0];
                 }
 
-                object::Array* arrlitObj = new object::Array(elements);
+                object::Array* arrlitObj = object::Array::fromElements(elements);
                 env->heap.push_back(arrlitObj);
                 return arrlitObj;
             }
@@ -119,11 +137,20 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
                 if (isError(left)) {
                     return left;
                 }
+                if (indexpr->Index->GetType() == ast::NodeType::StringLiteral &&
+                    left->Type() == object::HASH_OBJ) {
+                    return evalHashFieldExpression(indexpr, dynamic_cast<object::Hash*>(left));
+                }
                 object::Object* index = Eval(indexpr->Index, env);
                 if (isError(index)) {
                     return index;
                 }
-                return evalIndexExpression(left, index);
+                return evalIndexExpression(left, index, env);
+            }
+        case ast::NodeType::SliceExpression :
+            {
+                ast::SliceExpression* slicexpr = dynamic_cast<ast::SliceExpression*>(node);
+                return evalSliceExpression(slicexpr, env);
             }
         case ast::NodeType::HashLiteral : 
             {
@@ -139,7 +166,7 @@ object::Object* Eval(ast::Node* node, object::Environment* env) {
                     return val;
                 }
 
-                env->Set(letStmt->Name->Value, val);
+                env->Set(letStmt->Name->Symbol, val);
                 return nullptr;
             }
         case ast::NodeType::ReturnStatement :
@@ -178,6 +205,15 @@ object::Object* evalProgram(std::vector<ast::Statement*> &stmts, object::Environ
     return result;
 }
 
+// an integer or string computed by an operator goes on env's heap like a
+// literal, so a frame that evaluates one over and over can collect it
+object::Object* trackTemporary(object::Object* obj, object::Environment* env) {
+    if (obj->Type() == object::INTEGER_OBJ || obj->Type() == object::STRING_OBJ) {
+        env->heap.push_back(obj);
+    }
+    return obj;
+}
+
 object::Object* evalPrefixExpression(std::string oper, object::Object* right) {
     if (oper == "!") {
         return evalBangOperatorExpression(right);
@@ -218,6 +254,8 @@ object::Object* evalMinusPrefixOperatorExpression(object::Object* right) {
 object::Object* evalInfixExpression(std::string oper, object::Object* right, object::Object* left) {
     if (left->Type() == object::INTEGER_OBJ && right->Type() == object::INTEGER_OBJ) {
         return evalIntegerInfixExpression(oper, left, right);
+    } else if (left->Type() == object::STRING_OBJ && right->Type() == object::STRING_OBJ) {
+        return evalStringInfixExpression(oper, left, right);
     } else if (oper == "==") {
         return nativeBoolToBooleanObject(left == right);
     } else if (oper == "!=") {
@@ -225,8 +263,6 @@ object::Object* evalInfixExpression(std::string oper, object::Object* right, obj
     } else if (left->Type() != right->Type()) {
         return new object::Error("type mismatch: " + left->Type()
                 + " " + oper + " " + right->Type());
-    } else if (left->Type() == object::STRING_OBJ && right->Type() == object::STRING_OBJ) {
-        return evalStringInfixExpression(oper, left, right);
     }
 
     return new object::Error("unknown operator: " + left->Type()
@@ -262,13 +298,21 @@ object::Object* evalIntegerInfixExpression(std::string oper, object::Object* lef
 }
 
 object::Object* evalStringInfixExpression(std::string oper, object::Object* left, object::Object* right) {
-    if (oper != "+") {
+    object::String* leftVal = dynamic_cast<object::String*>(right);
+    object::String* rightVal = dynamic_cast<object::String*>(left);
+
+    if (oper == "==") {
+        return nativeBoolToBooleanObject(leftVal->equals(*rightVal));
+    } else if (oper == "!=") {
+        return nativeBoolToBooleanObject(!leftVal->equals(*rightVal));
+    } else if (oper != "+") {
         return new object::Error("unknown operator: " + left->Type() + " " + oper + " " + right->Type());
     }
 
-    object::String* leftVal = dynamic_cast<object::String*>(right);
-    object::String* rightVal = dynamic_cast<object::String*>(left);
-    return new object::String(leftVal->Value + rightVal->Value);
+    std::string text;
+    text.reserve(leftVal->Value.size() + rightVal->Value.size());
+    text.append(leftVal->Value).append(rightVal->Value);
+    return new object::String(std::move(text));
 }
 
 object::Object* evalIfExpression(ast::IfExpression* ifexpr, object::Environment* env) {
@@ -291,6 +335,10 @@ object::Object* evalIfExpression(ast::IfExpression* ifexpr, object::Environment*
 }
 
 object::Object* evalBlockStatements(ast::BlockStatement* blckStmt, object::Environment* env) {
+    // every call and branch enters a block, which makes it the place for a
+    // long running task to let others have a turn
+    scheduler::Tick();
+
     object::Object* result = nullptr;
 
     for (ast::Statement* stmt : blckStmt->Statements) {
@@ -308,11 +356,10 @@ object::Object* evalBlockStatements(ast::BlockStatement* blckStmt, object::Envir
 }
 
 object::Object* evalIdentifier(ast::Identifier* ident, object::Environment* env) {
-    std::pair<object::Object*, bool> valOk = env->Get(ident->Value);
+    std::pair<object::Object*, bool> valOk = env->Get(ident->Symbol);
     if (!valOk.second) {
-        auto it = object::builtins.find(ident->Value);
-        if (it != object::builtins.end()) {
-            return it->second;
+        if (object::Builtin* builtin = object::lookupBuiltin(ident->Symbol)) {
+            return builtin;
         }
         return new object::Error("identifier not found: " + ident->Value);
     }
@@ -320,17 +367,61 @@ object::Object* evalIdentifier(ast::Identifier* ident, object::Environment* env)
     return valOk.first;
 }
 
-object::Object* evalIndexExpression(object::Object* left, object::Object* index) {
+object::Object* evalIndexExpression(object::Object* left, object::Object* index, object::Environment* env) {
     if (left->Type() == object::ARRAY_OBJ && index->Type() == object::INTEGER_OBJ) {
-        return evalArrayIndexExpression(left, index);
+        return evalArrayIndexExpression(left, index, env);
     } else if (left->Type() == object::HASH_OBJ) {
         return evalHashIndexExpression(left, index);
     }
     return new object::Error("index operation not supported: " + left->Type());
 } 
 
+// s[a:b] and arr[a:b] share the storage of what they are cut from; bounds
+// are clamped to the value like those of slice()
+object::Object* evalSliceExpression(ast::SliceExpression* slicexpr, object::Environment* env) {
+    object::Object* left = Eval(slicexpr->Left, env);
+    if (isError(left)) {
+        return left;
+    }
+    if (left->Type() != object::STRING_OBJ && left->Type() != object::ARRAY_OBJ) {
+        return new object::Error("slice operation not supported: " + left->Type());
+    }
+
+    int64_t bounds[2] = {0, INT64_MAX};
+    ast::Expression* exprs[2] = {slicexpr->Start, slicexpr->End};
+    for (int i = 0; i < 2; ++i) {
+        if (exprs[i] == nullptr) continue;
+
+        object::Object* bound = Eval(exprs[i], env);
+        if (isError(bound)) {
+            return bound;
+        }
+        if (bound->Type() != object::INTEGER_OBJ) {
+            return new object::Error("slice bound must be INTEGER, got " + bound->Type());
+        }
+        bounds[i] = dynamic_cast<object::Integer*>(bound)->Value;
+    }
+
+    object::Object* result;
+    if (left->Type() == object::STRING_OBJ) {
+        object::String* str = dynamic_cast<object::String*>(left);
+        int64_t size = str->Value.size();
+        int64_t from = std::clamp<int64_t>(bounds[0], 0, size);
+        result = new object::String(*str, from, std::clamp<int64_t>(bounds[1], from, size));
+    } else {
+        object::Array* arr = dynamic_cast<object::Array*>(left);
+        int64_t size = arr->size();
+        int64_t from = std::clamp<int64_t>(bounds[0], 0, size);
+        result = arr->slice(from, std::clamp<int64_t>(bounds[1], from, size));
+    }
+
+    env->heap.push_back(result);
+    return result;
+}
+
 object::Object* evalHashLiteral(ast::HashLiteral* hashlit, object::Environment* env) {
-    std::map<object::HashKey, object::HashPair> pairs;
+    object::Hash* hashlitObj = new object::Hash({});
+    env->heap.push_back(hashlitObj);
 
     for (const auto& pair : hashlit->Pairs) {
         object::Object* key = Eval(pair.first, env);
@@ -348,27 +439,32 @@ object::Object* evalHashLiteral(ast::HashLiteral* hashlit, object::Environment*
             return value;
         }
 
-        object::HashKey hashed = hashable->getHashKey();
-        pairs[hashed] = object::HashPair{key, value};
+        if (dynamic_cast<ast::StringLiteral*>(pair.first) != nullptr) {
+            hashlitObj->pushLiteral(hashable->getHashKey(), object::HashPair{key, value});
+        } else {
+            hashlitObj->push(hashable->getHashKey(), object::HashPair{key, value});
+        }
     }
 
-
-    object::Hash* hashlitObj = new object::Hash(pairs);
-    env->heap.push_back(hashlitObj);
     return hashlitObj;
 }
 
-object::Object* evalArrayIndexExpression(object::Object* array, object::Object* index) {
+object::Object* evalArrayIndexExpression(object::Object* array, object::Object* index, object::Environment* env) {
     object::Array* arrObj = dynamic_cast<object::Array*>(array);
     unsigned int idx  = dynamic_cast<object::Integer*>(index)->Value;
-    unsigned int size = arrObj->Elements.size();
+    unsigned int size = arrObj->size();
     unsigned int max = size > 0 ? size - 1 : 0;
 
-    if (idx < 0 || idx > max) {
+    if (size == 0 || idx < 0 || idx > max) {
         return object::NULL_T.get();
     }
 
-    return arrObj->Elements[idx];
+    object::Object* element = arrObj->at(idx);
+    if (arrObj->packed()) {
+        // boxed just now, nothing else holds it
+        env->heap.push_back(element);
+    }
+    return element;
 }
 
 object::Object* evalHashIndexExpression(object::Object* hash, object::Object* index) {
@@ -379,13 +475,44 @@ object::Object* evalHashIndexExpression(object::Object* hash, object::Object* in
         return new object::Error("unusable as hash key: " + index->Type());
     }
 
-    const auto& pair = hashObj->Pairs[hashable->getHashKey()];
+    const object::HashPair* pair = hashObj->find(hashable->getHashKey());
+    if (pair == nullptr) {
+        return object::NULL_T.get();
+    }
+
+    return pair->Value;
+}
 
-    if (!pair.Value) {
-        return nullptr;
+// h["name"] with a literal key: the key is never materialized as a String, and
+// once it has been found in a shaped hash the slot is remembered at the node,
+// so hashes of the same shape go straight to it
+object::Object* evalHashFieldExpression(ast::IndexExpression* indexpr, object::Hash* hash) {
+    const object::Shape* shape = hash->shape;
+    if (shape != nullptr) {
+        uint64_t cached = indexpr->InlineCache.load(std::memory_order_relaxed);
+        if ((cached >> 32) == shape->id) {
+            return hash->slots[uint32_t(cached)].Value;
+        }
+    }
+
+    ast::StringLiteral* strlit = dynamic_cast<ast::StringLiteral*>(indexpr->Index);
+    object::HashKey key = object::String::hashKeyOf(strlit->Value);
+
+    if (shape != nullptr) {
+        int slot = shape->slotOf(key);
+        if (slot < 0) {
+            return object::NULL_T.get();
+        }
+        indexpr->InlineCache.store(uint64_t(shape->id) << 32 | uint32_t(slot), std::memory_order_relaxed);
+        return hash->slots[slot].Value;
     }
 
-    return pair.Value;
+    const object::HashPair* pair = hash->find(key);
+    if (pair == nullptr) {
+        return object::NULL_T.get();
+    }
+
+    return pair->Value;
 }
 
 std::vector<object::Object*> evalExpressions(
@@ -416,10 +543,15 @@ object::Object* nativeBoolToBooleanObject(bool input) {
 object::Object* applyFunction(object::Object* fn, std::vector<object::Object*> &args) {
     if (fn->Type() == object::FUNCTION_OBJ) {
         object::Function* function = dynamic_cast<object::Function*>(fn);
+        allocator::Account* account = function->Env->account;
+        if (object::Object* tooDeep = enterCall(account)) {
+            return tooDeep;
+        }
         object::Environment* extendedEnv = extendFunctionEnv(function, args);
         object::Object* evaluated = Eval(function->Body, extendedEnv);
         // TODO: Implement proper temporary environment deletion
         delete extendedEnv;
+        account->depth--;
         return unwrapReturnValue(evaluated);
     } else if (fn->Type() == object::BUILTIN_OBJ) {
         object::Builtin* builtin = dynamic_cast<object::Builtin*>(fn);
@@ -432,12 +564,82 @@ object::Environment* extendFunctionEnv(object::Function* fn, std::vector<object:
     object::Environment* env = fn->Env->NewEnclosedEnvironment();
 
     for (unsigned int i = 0; i < fn->Parameters.size(); ++i) {
-        env->Set(fn->Parameters[i]->Value, args[i]);
+        env->Set(fn->Parameters[i]->Symbol, args[i]);
     }
 
     return env;
 }
 
+FrameCall::FrameCall(object::Object* fn) : callee(fn), function(dynamic_cast<object::Function*>(fn)) {
+    if (function != nullptr) {
+        frame = function->Env->NewEnclosedEnvironment();
+    }
+}
+
+FrameCall::~FrameCall() {
+    if (frame == nullptr) {
+        return;
+    }
+
+    object::Environment* session = object::activeSession();
+    if (session != nullptr) {
+        session->heap.insert(session->heap.end(), frame->heap.begin(), frame->heap.end());
+    }
+    delete frame;
+}
+
+void FrameCall::track(object::Object* obj) {
+    object::Environment* env = frame != nullptr ? frame : object::activeSession();
+    if (env != nullptr) {
+        env->heap.push_back(obj);
+    }
+}
+
+object::Object* FrameCall::operator()(std::vector<object::Object*>& args) {
+    if (function == nullptr) {
+        return applyFunction(callee, args);
+    }
+
+    // bound without Set so arguments stay collectible once the call is done
+    const std::vector<ast::Identifier*>& params = function->Parameters;
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        object::Object* arg = i < args.size() ? args[i] : object::NULL_T.get();
+        arg->incrRefCount();
+
+        object::Object*& slot = frame->store[params[i]->Symbol];
+        if (slot != nullptr) {
+            slot->decRefCount();
+        }
+        slot = arg;
+    }
+    // whatever the last call bound with let starts out unbound again
+    if (frame->store.size() > params.size()) {
+        for (auto it = frame->store.begin(); it != frame->store.end();) {
+            bool isParam = std::any_of(params.begin(), params.end(),
+                    [&](ast::Identifier* param) { return param->Symbol == it->first; });
+            if (isParam) {
+                ++it;
+            } else {
+                it->second->decRefCount();
+                it = frame->store.erase(it);
+            }
+        }
+    }
+
+    // the caller has taken a reference on any earlier result it kept
+    if (frame->heap.size() >= collectAt) {
+        frame->clearHeap();
+        collectAt = std::max(COLLECT_MIN, 2 * frame->heap.size());
+    }
+
+    if (object::Object* tooDeep = enterCall(frame->account)) {
+        return tooDeep;
+    }
+    object::Object* evaluated = Eval(function->Body, frame);
+    frame->account->depth--;
+    return unwrapReturnValue(evaluated);
+}
+
 object::Object* unwrapReturnValue(object::Object* obj) {
     object::ReturnValue* rtrnVal = dynamic_cast<object::ReturnValue*>(obj);
     if (rtrnVal) {
@@ -447,6 +649,71 @@ object::Object* unwrapReturnValue(object::Object* obj) {
     return obj;
 }
 
+object::Object* newMemoryBudgetError(allocator::Account* account) {
+    std::stringstream out;
+    out << "memory budget exceeded: using " << account->liveBytes <<
+        " bytes, limit is " << account->limit;
+    return new object::Error(out.str());
+}
+
+// steps until the next look at the limits: as many as are left of the step
+// limit, one at a time once a limit is exceeded so every node fails
+void countStepsToCheck(allocator::Account* account) {
+    std::size_t next = allocator::LIMIT_CHECK_STEPS;
+    const std::size_t limit = account->limits.steps;
+    if (limit != 0) {
+        next = account->steps <= limit ? std::min(next, limit + 1 - account->steps) : 1;
+    }
+    account->stepsToCheck = next;
+    account->stepsCounted = next;
+}
+
+void startEvaluation(allocator::Account* account) {
+    account->steps = 0;
+    account->bytesAtStart = account->stats.bytesAllocated;
+    if (account->limits.time.count() != 0) {
+        account->started = std::chrono::steady_clock::now();
+    }
+    countStepsToCheck(account);
+}
+
+object::Object* checkLimits(allocator::Account* account) {
+    account->steps += account->stepsCounted;
+    const allocator::Limits& limits = account->limits;
+
+    std::stringstream out;
+    const std::size_t allocated = account->stats.bytesAllocated - account->bytesAtStart;
+    if (limits.steps != 0 && account->steps > limits.steps) {
+        out << "step budget exceeded: limit is " << limits.steps << " nodes evaluated";
+    } else if (limits.bytes != 0 && allocated > limits.bytes) {
+        out << "allocation budget exceeded: allocated " << allocated << " bytes, limit is " << limits.bytes;
+    } else if (limits.time.count() != 0) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - account->started);
+        if (elapsed > limits.time) {
+            out << "time budget exceeded: ran for " << elapsed.count() << " ms, limit is " << limits.time.count() << " ms";
+        }
+    }
+
+    if (out.tellp() == 0) {
+        countStepsToCheck(account);
+        return nullptr;
+    }
+    account->stepsToCheck = 1;
+    account->stepsCounted = 1;
+    return new object::Error(out.str());
+}
+
+object::Object* enterCall(allocator::Account* account) {
+    if (account->limits.depth != 0 && account->depth >= account->limits.depth) {
+        std::stringstream out;
+        out << "call depth exceeded: limit is " << account->limits.depth << " nested calls";
+        return new object::Error(out.str());
+    }
+    account->depth++;
+    return nullptr;
+}
+
 bool isTruthy(object::Object* obj) {
     if (obj == object::NULL_T.get()) {
         return false;
@@ -26,6 +26,16 @@ void TestBuiltinFunctions();
 void TestArrayLiterals();
 void TestArrayIndexExpressions();
 void TestHashLiterals();
+void TestMemoryBudget();
+void TestExecutionLimits();
+void TestGcStats();
+void TestHashFieldExpressions();
+void TestStringSlices();
+void TestIntegerArrayBuiltins();
+void TestCollectionBuiltins();
+void TestLazySequences();
+void TestSortBuiltins();
+void TestParallelBuiltins();
 
 object::Object* testEval(std::string input, object::Environment* env);
 bool testIntegerObject(object::Object* obj, int64_t expected);
@@ -49,6 +59,16 @@ int main() {
     TestArrayLiterals();
     TestArrayIndexExpressions();
     TestHashLiterals();
+    TestMemoryBudget();
+    TestExecutionLimits();
+    TestGcStats();
+    TestHashFieldExpressions();
+    TestStringSlices();
+    TestIntegerArrayBuiltins();
+    TestCollectionBuiltins();
+    TestLazySequences();
+    TestSortBuiltins();
+    TestParallelBuiltins();
 
     return 0;
 }
@@ -131,7 +151,12 @@ void TestEvalBooleanExpression() {
         {"(1 < 2) == true", true},
         {"(1 < 2) == false", false},
         {"(1 > 2) == true", false},
-        {"(1 > 2) == false", true}
+        {"(1 > 2) == false", true},
+        {"\"a\" == \"a\"", true},
+        {"\"a\" != \"b\"", true},
+        {"\"ab\" == \"a\" + \"b\"", true},
+        {"intern(\"a\" + \"b\") == \"ab\"", true},
+        {"intern(\"a\") == \"b\"", false}
     };
 
     for (LitTest test : tests) {
@@ -445,14 +470,18 @@ void TestArrayLiterals() {
         return;
     }
 
-    if (arr->Elements.size() != 3) {
-        std::cerr << "arr->Elements size not limt 3, got=" <<
-            arr->Elements.size() << std::endl;
+    if (arr->size() != 3) {
+        std::cerr << "arr size not limt 3, got=" <<
+            arr->size() << std::endl;
     }
 
-    testIntegerObject(arr->Elements[0], 1);
-    testIntegerObject(arr->Elements[1], 4);
-    testIntegerObject(arr->Elements[2], 6);
+    if (!arr->packed()) {
+        std::cerr << "array of integers is not packed" << std::endl;
+    }
+
+    testIntegerObject(arr->at(0), 1);
+    testIntegerObject(arr->at(1), 4);
+    testIntegerObject(arr->at(2), 6);
 }
 
 void TestArrayIndexExpressions() {
@@ -529,19 +558,351 @@ void TestHashLiterals() {
         {object::FALSE->getHashKey(),          6},
     };
 
-    if (hash->Pairs.size() != expected.size()) {
-        std::cerr << "hash->Pairs.size() not expected.size(), got=" <<
-            hash->Pairs.size() << std::endl;
+    if (hash->size() != expected.size()) {
+        std::cerr << "hash->size() not expected.size(), got=" <<
+            hash->size() << std::endl;
         return;
     }
 
     for (auto& test : expected) {
-        const auto& it = hash->Pairs.find(test.first);
-        if (it != hash->Pairs.end()) {
-            std::cerr << "no pair for given key in Pairs" << std::endl;
+        const object::HashPair* pair = hash->find(test.first);
+        if (pair == nullptr) {
+            std::cerr << "no pair for given key in hash" << std::endl;
             return;
         }
-        testIntegerObject(it->second.Value, expected[it->first]);
+        testIntegerObject(pair->Value, test.second);
+    }
+}
+
+void TestMemoryBudget() {
+    object::Environment* env = new object::Environment();
+    object::Object* evaluated = testEval("let a = [1, 2, 3]; mem_usage()", env);
+    object::Integer* usage = dynamic_cast<object::Integer*>(evaluated);
+    if (!usage || usage->Value <= 0) {
+        std::cerr << "mem_usage() did not report live bytes, got=" <<
+            (evaluated ? evaluated->Inspect() : "nullptr") << std::endl;
+        return;
+    }
+    if (env->MemoryUsage() == 0) {
+        std::cerr << "env->MemoryUsage() is 0 after evaluation" << std::endl;
+    }
+
+    env->SetMemoryLimit(env->MemoryUsage() + 256);
+    evaluated = testEval("let b = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16]; b", env);
+    object::Error* errObj = dynamic_cast<object::Error*>(evaluated);
+    if (!errObj) {
+        std::cerr << "evaluated over budget is not object::Error, got=" <<
+            (evaluated ? evaluated->Inspect() : "nullptr") << std::endl;
+        return;
+    }
+    if (errObj->Message.rfind("memory budget exceeded", 0) != 0) {
+        std::cerr << "errObj->Message not memory budget error, got=" <<
+            errObj->Message << std::endl;
+    }
+
+    env->SetMemoryLimit(0);
+    testIntegerObject(testEval("1 + 1", env), 2);
+    delete env;
+}
+
+void TestExecutionLimits() {
+    object::Environment* env = new object::Environment();
+    testEval("let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };", env);
+
+    struct Test {
+        allocator::Limits limits;
+        std::string input;
+        std::string expected;
+    };
+    allocator::Limits steps;
+    steps.steps = 5000;
+    allocator::Limits depth;
+    depth.depth = 100;
+    allocator::Limits bytes;
+    bytes.bytes = 64 << 10;
+    allocator::Limits time;
+    time.time = std::chrono::milliseconds(5);
+
+    Test tests[] {
+        {steps, "fib(20)", "step budget exceeded: limit is 5000 nodes evaluated"},
+        {depth, "let f = fn() { f() }; f()", "call depth exceeded: limit is 100 nested calls"},
+        {depth, "map([1, 2], fn(x) { let g = fn() { g() }; g() })", "call depth exceeded: limit is 100 nested calls"},
+        {bytes, "let build = fn(n, acc) { if (n == 0) { acc } else { build(n - 1, push(acc, n)) } }; len(build(3000, []))", "allocation budget exceeded"},
+        {time, "fib(30)", "time budget exceeded"},
+    };
+
+    for (Test& test : tests) {
+        env->SetLimits(test.limits);
+        object::Object* evaluated = testEval(test.input, env);
+        object::Error* errObj = dynamic_cast<object::Error*>(evaluated);
+        if (!errObj || errObj->Message.rfind(test.expected, 0) != 0) {
+            std::cerr << test.input << " not stopped with " << test.expected << ", got=" <<
+                (evaluated ? evaluated->Inspect() : "nullptr") << std::endl;
+        }
+
+        // the limits are per evaluation, the next one starts afresh
+        testIntegerObject(testEval("fib(10)", env), 55);
+        if (env->account->depth != 0) {
+            std::cerr << "call depth left at " << env->account->depth << std::endl;
+        }
+    }
+
+    env->SetLimits(allocator::Limits());
+    testIntegerObject(testEval("fib(20)", env), 6765);
+    delete env;
+}
+
+void TestGcStats() {
+    std::string input = "let f = fn(x) { x }; f(1); f(2); gc_stats()";
+
+    object::Environment* env = new object::Environment();
+    object::Object* evaluated = testEval(input, env);
+    object::Hash* hash = dynamic_cast<object::Hash*>(evaluated);
+    if (!hash) {
+        std::cerr << "gc_stats() did not return object::Hash, got=" <<
+            (evaluated ? evaluated->Inspect() : "nullptr") << std::endl;
+        return;
+    }
+
+    std::string keys[] {"live_bytes", "bytes_allocated", "bytes_freed", "frames_created", "collections"};
+    for (std::string key : keys) {
+        if (hash->find(object::String{key}.getHashKey()) == nullptr) {
+            std::cerr << "gc_stats() missing key " << key << std::endl;
+            return;
+        }
+    }
+
+    const object::HashPair* frames = hash->find(object::String{"frames_created"}.getHashKey());
+    testIntegerObject(frames->Value, 2);
+    delete env;
+}
+
+void TestHashFieldExpressions() {
+    LitTest tests[] {
+        {"{\"a\": 1, \"b\": 2}[\"b\"]", 2},
+        {"let h = {\"a\": 1}; h[\"a\"]", 1},
+        {
+            "let get = fn(h) { h[\"id\"] };             "
+            "let a = {\"name\": 0, \"id\": 1};          "
+            "let b = {\"id\": 20, \"name\": 0};         "
+            "let c = {\"id\": 300};                     "
+            "let d = {\"id\": 4000, 1: 0};              "
+            "get(a) + get(b) + get(c) + get(d) + get(a) ",
+            4321 + 1
+        },
+        {"let h = set({\"a\": 1}, \"b\", 5); h[\"b\"]", 5},
+        {"let h = delete({\"a\": 1, \"b\": 2}, \"a\"); h[\"b\"]", 2},
+    };
+
+    for (LitTest test : tests) {
+        object::Environment* env = new object::Environment();
+        testIntegerObject(testEval(test.input, env), test.expected);
+        delete env;
+    }
+
+    object::Environment* env = new object::Environment();
+    object::Object* evaluated = testEval("let get = fn(h) { h[\"x\"] }; get({\"x\": 1}); get({\"y\": 1})", env);
+    if (evaluated != object::NULL_T.get()) {
+        std::cerr << "missing field did not evaluate to null, got=" <<
+            (evaluated ? evaluated->Inspect() : "nullptr") << std::endl;
+    }
+    delete env;
+}
+
+void TestStringSlices() {
+    struct Test {
+        std::string input;
+        std::string expected;
+    };
+
+    Test tests[] {
+        {"\"hello world\"[6:11]", "world"},
+        {"\"hello world\"[:5]", "hello"},
+        {"\"hello\"[3:]", "lo"},
+        {"\"hello\"[-2:100]", "hello"},
+        {"\"hello\"[4:2]", ""},
+        {"let s = \"a,b\"; s[2:] + s[:1]", "ba"},
+        {"split(\"GET /index.html 200\", \" \")[1]", "/index.html"},
+        {"split(\"a,,b\", \",\")[1]", ""},
+        {"compact(\"hello world\"[0:1])", "h"},
+    };
+
+    for (Test test : tests) {
+        object::Environment* env = new object::Environment();
+        object::String* strObj = dynamic_cast<object::String*>(testEval(test.input, env));
+        if (!strObj) {
+            std::cerr << test.input << " did not evaluate to object::String" << std::endl;
+        } else if (strObj->Value != test.expected) {
+            std::cerr << test.input << " expected=" << test.expected << ", got=" << strObj->Value << std::endl;
+        }
+        delete env;
+    }
+
+    object::Environment* env = new object::Environment();
+    testIntegerObject(testEval("len(split(\"a b c\", \" \")) + len([1, 2, 3][1:])", env), 5);
+    delete env;
+}
+
+void TestIntegerArrayBuiltins() {
+    LitTest tests[] {
+        {"sum([1, 2, 3, 4, 5, 6, 7, 8, 9])", 45},
+        {"sum([])", 0},
+        {"min([5, -3, 8, 2, 9])", -3},
+        {"max([5, -3, 8, 2, 9])", 9},
+        {"dot([1, 2, 3], [4, 5, 6])", 32},
+        {"sum(vadd([1, 2, 3], [10, 20, 30]))", 66},
+        {"sum(vsub([1, 2, 3], 1))", 3},
+        {"vmul([1, 2, 3], [4, 5, 6])[2]", 18},
+        {"let a = []; push(a, 4); push(a, 6); sum(a)", 10},
+        {"let a = [1, 2]; push(a, \"x\"); len(a)", 3},
+        {"sum([1, 2, 3, 4][1:3])", 5},
+    };
+
+    for (LitTest test : tests) {
+        object::Environment* env = new object::Environment();
+        testIntegerObject(testEval(test.input, env), test.expected);
+        delete env;
+    }
+
+    struct ErrTest {
+        std::string input;
+        std::string expectedMsg;
+    };
+
+    ErrTest errTests[] {
+        {"sum(1)", "argument to `sum` must be ARRAY, got INTEGER"},
+        {"sum([1, \"a\"])", "elements of `sum` argument must be INTEGER, got STRING"},
+        {"dot([1, 2], [1])", "arguments to `dot` differ in length: 2 and 1"},
+    };
+
+    for (ErrTest test : errTests) {
+        object::Environment* env = new object::Environment();
+        object::Error* evalErr = dynamic_cast<object::Error*>(testEval(test.input, env));
+        if (!evalErr || evalErr->Message != test.expectedMsg) {
+            std::cerr << test.input << " did not fail with " << test.expectedMsg << std::endl;
+        }
+        delete env;
+    }
+
+    object::Environment* env = new object::Environment();
+    testNullObject(testEval("min([])", env));
+    delete env;
+}
+
+void TestCollectionBuiltins() {
+    LitTest tests[] {
+        {"sum(map([1, 2, 3], fn(x) { x * 10 }))", 60},
+        {"len(map([\"a\", \"bc\"], len))", 2},
+        {"map([\"a\", \"bc\"], len)[1]", 2},
+        {"len(filter([1, 5, 2, 8], fn(x) { x > 3 }))", 2},
+        {"filter([\"a\", \"b\", 3], fn(x) { x == 3 })[0]", 3},
+        {"reduce([1, 2, 3, 4], 10, fn(acc, x) { acc + x })", 20},
+        {"reduce([], 7, fn(acc, x) { acc + x })", 7},
+        {"find([1, 5, 2, 8], fn(x) { x > 3 })", 5},
+        {"len(map(map([1, 2], fn(x) { [x, x] }), fn(p) { p[0] + p[1] }))", 2},
+        {"reduce([1, 2, 3], 0, fn(acc, x) { let y = x * x; acc + y })", 14},
+    };
+
+    for (LitTest test : tests) {
+        object::Environment* env = new object::Environment();
+        testIntegerObject(testEval(test.input, env), test.expected);
+        delete env;
+    }
+
+    object::Environment* env = new object::Environment();
+    testNullObject(testEval("find([1, 2], fn(x) { x > 5 })", env));
+    testNullObject(testEval("each([1, 2], fn(x) { x })", env));
+    object::Error* evalErr = dynamic_cast<object::Error*>(testEval("map([1, 2], fn(x) { y })", env));
+    if (!evalErr || evalErr->Message != "identifier not found: y") {
+        std::cerr << "error in a map callback was not returned" << std::endl;
+    }
+    delete env;
+}
+
+void TestLazySequences() {
+    LitTest tests[] {
+        {"sum(range(101))", 5050},
+        {"len(collect(range(10, 0, -3)))", 4},
+        {"collect(range(10, 0, -3))[3]", 1},
+        {"sum(lmap(range(1, 4), fn(x) { x * x }))", 14},
+        {"sum(take(lfilter(range(1000000000000), fn(x) { x / 7 * 7 == x }), 3))", 21},
+        {"len(collect(take(range(5), 0)))", 0},
+        {"reduce(take(range(1, 100), 5), 1, fn(acc, x) { acc * x })", 120},
+        {"find(lmap(range(100), fn(x) { x * 3 }), fn(x) { x > 50 })", 51},
+        {"max(lmap([\"a\", \"bcd\"], len))", 3},
+        {"collect(lmap(take(range(4), 2), fn(x) { [x] }))[1][0]", 1},
+        {"len(filter(lmap(range(6), fn(x) { x * 2 }), fn(x) { x > 4 }))", 3},
+        {"let calls = [0]; let r = take(lmap(range(10), fn(x) { push(calls, x) }), 2); len(calls)", 1},
+    };
+
+    for (LitTest test : tests) {
+        object::Environment* env = new object::Environment();
+        testIntegerObject(testEval(test.input, env), test.expected);
+        delete env;
+    }
+
+    object::Environment* env = new object::Environment();
+    object::Object* evaluated = testEval("take(lmap(range(5), fn(x) { x }), 2)", env);
+    if (evaluated->Type() != object::SEQUENCE_OBJ || evaluated->Inspect() != "range(0, 5, 1) | lmap | take(2)") {
+        std::cerr << "take did not return a lazy sequence, got=" << evaluated->Inspect() << std::endl;
+    }
+    object::Array* collected = dynamic_cast<object::Array*>(testEval("collect(lmap(range(3), fn(x) { x + 1 }))", env));
+    if (!collected || !collected->packed() || collected->Inspect() != "[1, 2, 3]") {
+        std::cerr << "collect did not build a packed array" << std::endl;
+    }
+    testNullObject(testEval("min(lfilter(range(3), fn(x) { x > 5 }))", env));
+    object::Error* evalErr = dynamic_cast<object::Error*>(testEval("range(0, 1, 0)", env));
+    if (!evalErr || evalErr->Message != "step of `range` must not be 0") {
+        std::cerr << "range with a step of 0 did not fail" << std::endl;
+    }
+    delete env;
+}
+
+void TestSortBuiltins() {
+    struct SortTest {
+        std::string input;
+        std::string expected;
+    };
+
+    SortTest tests[] {
+        {"sort([3, -1, 2, 3, 0])", "[-1, 0, 2, 3, 3]"},
+        {"sort([])", "[]"},
+        {"sort([\"pear\", \"fig\", \"apple\"])", "[apple, fig, pear]"},
+        {"let a = [2, 1]; sort(a); a", "[2, 1]"},
+        {"sort_by([1, 3, 2], fn(a, b) { a > b })", "[3, 2, 1]"},
+        {"sort_by([\"bb\", \"a\", \"cc\", \"d\"], fn(a, b) { len(a) < len(b) })", "[a, d, bb, cc]"},
+        {"sort_by([[2], [1]], fn(a, b) { a[0] < b[0] })", "[[1], [2]]"},
+        {"sort(collect(range(300, 0, -1)))[0:3]", "[1, 2, 3]"},
+    };
+
+    for (SortTest test : tests) {
+        object::Environment* env = new object::Environment();
+        object::Object* evaluated = testEval(test.input, env);
+        if (evaluated->Inspect() != test.expected) {
+            std::cerr << test.input << " gave " << evaluated->Inspect() << ", want=" << test.expected << std::endl;
+        }
+        delete env;
+    }
+
+    struct ErrTest {
+        std::string input;
+        std::string expectedMsg;
+    };
+
+    ErrTest errTests[] {
+        {"sort(1)", "argument to `sort` must be ARRAY, got INTEGER"},
+        {"sort([1, \"a\"])", "elements of `sort` argument must share a type, got INTEGER and STRING"},
+        {"sort([[1]])", "elements of `sort` argument must be INTEGER or STRING, got ARRAY"},
+        {"sort_by([1, 2], fn(a, b) { c })", "identifier not found: c"},
+    };
+
+    for (ErrTest test : errTests) {
+        object::Environment* env = new object::Environment();
+        object::Error* evalErr = dynamic_cast<object::Error*>(testEval(test.input, env));
+        if (!evalErr || evalErr->Message != test.expectedMsg) {
+            std::cerr << test.input << " did not fail with " << test.expectedMsg << std::endl;
+        }
+        delete env;
     }
 }
 
@@ -595,3 +956,57 @@ bool testNullObject(object::Object* obj) {
     }
     return true;
 }
+
+void TestParallelBuiltins() {
+    struct ParallelTest {
+        std::string input;
+        std::string expected;
+    };
+
+    // large enough inputs are split across tasks, the small ones run in place
+    ParallelTest tests[] {
+        {"pmap([1, 2, 3], fn(x) { x * x })", "[1, 4, 9]"},
+        {"let big = collect(range(20000)); sum(pmap(big, fn(x) { x * 2 })) == sum(map(big, fn(x) { x * 2 }))", "true"},
+        {"pmap(collect(range(20000)), fn(x) { x - 1 })[19999]", "19998"},
+        {"let k = 3; pmap(collect(range(5000)), fn(x) { x * k })[4999]", "14997"},
+        {"let words = map(collect(range(3000)), fn(i) { \"w\" }); pmap(words, fn(w) { w + \"!\" })[2999]", "w!"},
+        {"pmap(collect(range(3000)), fn(x) { [x] })[2999]", "[2999]"},
+        {"pmap(collect(range(3000)), fn(x) { let y = x; y = y + 1; y })[0]", "1"},
+        {"preduce(collect(range(20000)), 5, fn(a, b) { a + b })", "199990005"},
+        {"preduce([4], 1, fn(a, b) { a * b })", "4"},
+        {"preduce([], 7, fn(a, b) { a + b })", "7"},
+    };
+
+    for (ParallelTest test : tests) {
+        object::Environment* env = new object::Environment();
+        object::Object* evaluated = testEval(test.input, env);
+        if (evaluated->Inspect() != test.expected) {
+            std::cerr << test.input << " gave " << evaluated->Inspect() << ", want=" << test.expected << std::endl;
+        }
+        delete env;
+    }
+
+    struct ErrTest {
+        std::string input;
+        std::string expectedMsg;
+    };
+
+    ErrTest errTests[] {
+        {"let c = 0; pmap([1], fn(x) { c = x })", "function passed to `pmap` is not pure: it assigns to c"},
+        {"pmap([1], fn(x) { puts(x) })", "function passed to `pmap` is not pure: it calls `puts`"},
+        {"let add = fn(a, x) { push(a, x) }; preduce([1], [], fn(a, x) { add(a, x) })",
+         "function passed to `preduce` is not pure: it calls `push`"},
+        {"pmap([1], puts)", "function passed to `pmap` is not pure: it is `puts`"},
+        {"pmap(collect(range(3000)), fn(x) { if (x == 2999) { y } else { x } })", "identifier not found: y"},
+        {"pmap(1, fn(x) { x })", "first argument to `pmap` must be ARRAY, got INTEGER"},
+    };
+
+    for (ErrTest test : errTests) {
+        object::Environment* env = new object::Environment();
+        object::Error* evalErr = dynamic_cast<object::Error*>(testEval(test.input, env));
+        if (!evalErr || evalErr->Message != test.expectedMsg) {
+            std::cerr << test.input << " did not fail with " << test.expectedMsg << std::endl;
+        }
+        delete env;
+    }
+}
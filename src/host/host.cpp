@@ -0,0 +1,86 @@
+#include "../../include/host.h"
+
+#include <deque>
+
+class Host::Session {
+public:
+    struct Job {
+        std::string source;
+        std::promise<std::string> result;
+    };
+
+    Isolate* isolate;
+    // guarded by the Host's lock
+    std::deque<Job> pending;
+    bool running = false;
+
+    Session() {
+        // the task that evaluates for the session may be on any thread, so
+        // the isolate is charged to no session on this one
+        allocator::Scope detached(nullptr);
+        isolate = new Isolate();
+    }
+    ~Session() { delete isolate; }
+};
+
+Host::Host(std::size_t slice) {
+    scheduler::SetSlice(slice);
+}
+
+Host::~Host() {
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this]() { return busy == 0; });
+    sessions.clear();
+    scheduler::SetSlice(scheduler::DEFAULT_SLICE);
+}
+
+Host::Session* Host::Open(const allocator::Limits& limits) {
+    std::unique_ptr<Session> session = std::make_unique<Session>();
+    session->isolate->Env()->SetLimits(limits);
+    std::lock_guard<std::mutex> guard(lock);
+    sessions.push_back(std::move(session));
+    return sessions.back().get();
+}
+
+std::future<std::string> Host::Submit(Session* session, std::string source) {
+    std::future<std::string> result;
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        session->pending.push_back(Session::Job{std::move(source), {}});
+        result = session->pending.back().result.get_future();
+        if (!session->running) {
+            session->running = true;
+            busy++;
+            start = true;
+        }
+    }
+
+    if (start) {
+        scheduler::Spawn([this, session]() { drain(session); });
+    }
+    return result;
+}
+
+void Host::drain(Session* session) {
+    for (;;) {
+        Session::Job job;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (session->pending.empty()) {
+                session->running = false;
+                if (--busy == 0) {
+                    idle.notify_all();
+                }
+                return;
+            }
+            job = std::move(session->pending.front());
+            session->pending.pop_front();
+        }
+
+        object::Object* evaluated = session->isolate->Run(job.source);
+        std::string printed = evaluated != nullptr ? evaluated->Inspect() : "";
+        session->isolate->Collect();
+        job.result.set_value(std::move(printed));
+    }
+}
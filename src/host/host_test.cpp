@@ -0,0 +1,79 @@
+#include "../../include/host.h"
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void TestHostSessions();
+void TestHostPreemptsBusySession();
+
+/*
+int main() {
+    TestHostSessions();
+    TestHostPreemptsBusySession();
+}
+*/
+
+void TestHostSessions() {
+    Host host;
+    Host::Session* first = host.Open();
+    Host::Session* second = host.Open();
+
+    // submitted together, a session's sources still run one after another
+    std::future<std::string> let = host.Submit(first, "let x = 5;");
+    std::future<std::string> use = host.Submit(first, "x * 2");
+    std::future<std::string> other = host.Submit(second, "x");
+
+    allocator::Limits limits;
+    limits.depth = 50;
+    Host::Session* limited = host.Open(limits);
+    std::future<std::string> runaway = host.Submit(limited, "let f = fn() { f() }; f()");
+
+    if (let.get() != "") {
+        std::cerr << "let statement printed something" << std::endl;
+    }
+    std::string got = use.get();
+    if (got != "10") {
+        std::cerr << "session lost its binding, got=" << got << std::endl;
+    }
+    got = other.get();
+    if (got.find("identifier not found: x") == std::string::npos) {
+        std::cerr << "binding leaked into another session, got=" << got << std::endl;
+    }
+    got = runaway.get();
+    if (got.find("call depth exceeded: limit is 50 nested calls") == std::string::npos) {
+        std::cerr << "runaway recursion not stopped, got=" << got << std::endl;
+    }
+}
+
+void TestHostPreemptsBusySession() {
+    Host host(1000);
+    Host::Session* busy = host.Open();
+    host.Submit(busy, "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };").get();
+    std::future<std::string> slow = host.Submit(busy, "fib(24)");
+
+    // on a single worker these only get to run by preempting fib
+    std::vector<Host::Session*> sessions;
+    std::vector<std::future<std::string>> quick;
+    for (int i = 0; i < 16; ++i) {
+        sessions.push_back(host.Open());
+        quick.push_back(host.Submit(sessions.back(), std::to_string(i) + " * 3"));
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        std::string got = quick[i].get();
+        if (got != std::to_string(i * 3)) {
+            std::cerr << "quick session " << i << " got=" << got << std::endl;
+        }
+    }
+    if (slow.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        std::cerr << "busy session finished before the quick ones" << std::endl;
+    }
+
+    std::string got = slow.get();
+    if (got != "46368") {
+        std::cerr << "fib(24) got=" << got << std::endl;
+    }
+}
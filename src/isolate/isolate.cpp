@@ -0,0 +1,63 @@
+#include "../../include/isolate.h"
+#include "../../include/eval.h"
+#include "../../include/parser.h"
+
+#include <set>
+
+Isolate::Isolate() : env(new object::Environment()) {}
+
+Isolate::~Isolate() {
+    delete env;
+}
+
+object::Object* Isolate::Eval(ast::Program& program) {
+    return ::Eval(&program, env);
+}
+
+object::Object* Isolate::Run(const std::string& source) {
+    Lexer l(source);
+    Parser p(l);
+    ast::Program program = p.ParseProgram();
+
+    std::vector<std::string> errors = p.Errors();
+    if (!errors.empty()) {
+        std::string message = "parser errors:";
+        for (const std::string& error : errors) {
+            message += " " + error + ";";
+        }
+        message.pop_back();
+
+        object::Error* err = new object::Error(message);
+        env->heap.push_back(err);
+        return err;
+    }
+
+    return Eval(program);
+}
+
+void Isolate::Collect() {
+    env->deleteAnonymousValues();
+}
+
+void Isolate::Reset() {
+    // a value bound under several names is dropped through one of them,
+    // so it is freed once
+    std::set<object::Object*> values;
+    for (auto it = env->store.begin(); it != env->store.end();) {
+        it->second->decRefCount();
+        if (values.insert(it->second).second) {
+            ++it;
+        } else {
+            it = env->store.erase(it);
+        }
+    }
+    // freeing a container may leave a binding it held unreferenced
+    std::size_t bound;
+    do {
+        bound = env->store.size();
+        env->collect();
+    } while (env->store.size() < bound);
+
+    env->store.clear();
+    env->frozen.clear();
+}
@@ -0,0 +1,244 @@
+#include "../../include/isolate.h"
+#include "../../include/frozen.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+void TestIsolatesAreSeparate();
+void TestIsolatesOnThreads();
+void TestSpawnAndChannels();
+void TestAsyncIO();
+void TestFrozenValues();
+void TestIsolateReset();
+
+/*
+int main() {
+    TestIsolatesAreSeparate();
+    TestIsolatesOnThreads();
+    TestSpawnAndChannels();
+    TestAsyncIO();
+    TestFrozenValues();
+    TestIsolateReset();
+}
+*/
+
+void TestIsolatesAreSeparate() {
+    Isolate first;
+    Isolate second;
+
+    first.Run("let x = 5;");
+    object::Object* evaluated = second.Run("x");
+    object::Error* err = dynamic_cast<object::Error*>(evaluated);
+    if (!err || err->Message != "identifier not found: x") {
+        std::cerr << "binding from one isolate is visible in another, got=" << evaluated->Inspect() << std::endl;
+    }
+
+    evaluated = first.Run("x * 2");
+    if (evaluated->Inspect() != "10") {
+        std::cerr << "isolate lost its own binding, got=" << evaluated->Inspect() << std::endl;
+    }
+
+    err = dynamic_cast<object::Error*>(first.Run("let = 1"));
+    if (!err || err->Message.rfind("parser errors:", 0) != 0) {
+        std::cerr << "source that does not parse did not return an Error" << std::endl;
+    }
+}
+
+void TestIsolatesOnThreads() {
+    // exercises the shared singletons and builtins from every thread
+    const std::string script =
+        "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };"
+        "let t = true;"
+        "let picked = map(collect(range(200)), fn(x) { if (t == true) { x } else { null } });"
+        "fib(15) + sum(picked) + len(sort([\"b\", \"a\"]))";
+    const std::string expected = std::to_string(610 + 19900 + 2);
+
+    std::vector<std::string> results(4);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            Isolate isolate;
+            for (int run = 0; run < 5; ++run) {
+                results[i] = isolate.Run(script)->Inspect();
+                isolate.Collect();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const std::string& result : results) {
+        if (result != expected) {
+            std::cerr << "isolate on its own thread got=" << result << ", want=" << expected << std::endl;
+        }
+    }
+}
+
+void TestSpawnAndChannels() {
+    struct Case {
+        std::string input;
+        std::string expected;
+    };
+    std::vector<Case> tests = {
+        // fan out over tasks and fan back in, which copies fib and the
+        // bindings it reaches along with each task
+        {"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };"
+         "let results = chan(4);"
+         "let work = fn(out, n) { send(out, [n, fib(n)]) };"
+         "let started = map([10, 11, 12, 13, 14, 15], fn(n) { spawn(work, results, n) });"
+         "sum(map(collect(range(6)), fn(i) { recv(results)[1] }))", "1508"},
+        // unbuffered requests, replies buffered so the task never waits on them
+        {"let requests = chan(); let replies = chan(3);"
+         "let echo = fn(n) { if (n > 0) { send(replies, recv(requests) * 2); echo(n - 1) } };"
+         "spawn(echo, 3);"
+         "send(requests, 1); send(requests, 2); send(requests, 3);"
+         "[recv(replies), recv(replies), recv(replies)]", "[2, 4, 6]"},
+        // what arrives is a copy, writes to it stay on the receiving side
+        {"let box = chan(1); let sent = [1, \"two\", {\"k\": [3]}];"
+         "send(box, sent); let got = recv(box); push(got, 4); [len(sent), len(got), got[2][\"k\"][0]]", "[3, 4, 3]"},
+        {"let c = chan(1); close(c); recv(c)", "null"},
+        {"let c = chan(1); close(c); send(c, 1)", "ERROR: send on a closed channel"},
+        {"let c = chan(); recv(c)", "ERROR: `recv` would wait forever, every task is blocked"},
+        {"send(chan(1), range(3))", "ERROR: cannot copy SEQUENCE to another isolate"},
+        {"send(chan(1), fn(x) { x })", "ERROR: cannot copy FUNCTION out of its isolate"},
+        {"let a = [1, \"x\"]; push(a, a); send(chan(1), a)", "ERROR: cannot copy ARRAY that holds itself to another isolate"},
+        {"spawn(fn(x) { x })", "ERROR: wrong number of arguments to spawned function. got=0, want=1"},
+        {"spawn(1)", "ERROR: first argument to `spawn` must be FUNCTION, got INTEGER"},
+        {"chan(-1)", "ERROR: capacity of `chan` must not be negative"},
+    };
+
+    for (const Case& test : tests) {
+        Isolate isolate;
+        std::string result = isolate.Run(test.input)->Inspect();
+        if (result != test.expected) {
+            std::cerr << "spawn and channels: got=" << result << ", want=" << test.expected << std::endl;
+        }
+        isolate.Collect();
+    }
+}
+
+void TestAsyncIO() {
+    const std::string path = "/tmp/monkey_async_io_" + std::to_string(getpid());
+    struct Case {
+        std::string input;
+        std::string expected;
+    };
+    std::vector<Case> tests = {
+        {"let w = write_async(\"" + path + "\", \"first\"); await(w)", "5"},
+        // both reads are in flight before either is awaited
+        {"let a = read_file_async(\"" + path + "\"); let b = read_file_async(\"" + path + "\");"
+         "await(a) + \" \" + await(b)", "first first"},
+        {"let p = read_file_async(\"" + path + "\"); await(p); [await(p), p]", "[first, promise(done)]"},
+        // a task parks in await and its worker runs others meanwhile
+        {"let out = chan(2);"
+         "let load = fn(n) { send(out, len(await(read_file_async(\"" + path + "\"))) + n) };"
+         "spawn(load, 1); spawn(load, 2); recv(out) + recv(out)", "13"},
+        {"await(write_async(1, \"\"))", "0"},
+        {"await(read_file_async(\"/nonexistent\"))", "ERROR: could not open /nonexistent: No such file or directory"},
+        {"write_async(true, \"x\")", "ERROR: first argument to `write_async` must be STRING or INTEGER, got BOOLEAN"},
+        {"await(chan())", "ERROR: argument to `await` must be PROMISE, got CHANNEL"},
+        {"pmap([1], fn(x) { await(x) })", "ERROR: function passed to `pmap` is not pure: it calls `await`"},
+    };
+
+    for (const Case& test : tests) {
+        Isolate isolate;
+        std::string result = isolate.Run(test.input)->Inspect();
+        if (result != test.expected) {
+            std::cerr << "async io: got=" << result << ", want=" << test.expected << std::endl;
+        }
+        isolate.Collect();
+    }
+    unlink(path.c_str());
+}
+
+void TestFrozenValues() {
+    struct Case {
+        std::string input;
+        std::string expected;
+    };
+    std::vector<Case> tests = {
+        {"let t = freeze({\"k\": [1, 2], \"s\": \"v\"}); [is_frozen(t), is_frozen(t[\"k\"]), t[\"s\"]]", "[true, true, v]"},
+        {"let t = freeze([1, 2, 3]); push(t, 4)", "ERROR: cannot push to a frozen ARRAY"},
+        {"let t = freeze([[1], 2]); pop(t[0])", "ERROR: cannot pop from a frozen ARRAY"},
+        {"compact(freeze(\"abc\"))", "ERROR: cannot compact a frozen STRING"},
+        // what is made from a frozen value is an ordinary one
+        {"let t = freeze([\"a\", \"b\", \"c\"]); let u = push(tail(t), \"d\"); [u, is_frozen(u), t]", "[[b, c, d], false, [a, b, c]]"},
+        {"let h = set(freeze({\"a\": 1}), \"b\", 2); [h[\"b\"], is_frozen(h)]", "[2, false]"},
+        {"let a = [1]; let t = freeze(a); push(a, 2); [a, t]", "[[1, 2], [1]]"},
+        // freezing a frozen value, or one holding frozen values, shares them
+        {"let t = freeze([\"x\"]); let u = freeze([t, t]); [u, is_frozen(freeze(t))]", "[[[x], [x]], true]"},
+        // sent and spawned without a copy, and still frozen on the other side
+        {"let t = freeze({\"n\": 7}); let c = chan(1); send(c, t); is_frozen(recv(c))", "true"},
+        {"let t = freeze([10, 20]); let out = chan(1); spawn(fn() { send(out, if (is_frozen(t)) { t[1] } else { 0 }) }); recv(out)", "20"},
+        {"freeze(fn(x) { x })", "ERROR: cannot freeze FUNCTION"},
+        {"let a = [1]; push(a, a); freeze(a)", "ERROR: cannot freeze ARRAY that holds itself"},
+    };
+
+    for (const Case& test : tests) {
+        Isolate isolate;
+        std::string result = isolate.Run(test.input)->Inspect();
+        if (result != test.expected) {
+            std::cerr << "frozen values: got=" << result << ", want=" << test.expected << std::endl;
+        }
+        isolate.Collect();
+    }
+
+    // one table read by isolates on several threads at once, each holding
+    // the heap for as long as it runs
+    Isolate owner;
+    object::Object* table = owner.Run(
+        "freeze(reduce(collect(range(500)), {}, fn(h, i) { set(h, i, [i, \"v\" + \"!\"]) }))");
+    std::shared_ptr<object::FrozenHeap> heap = table->frozen() ? object::FrozenHeap::Of(table) : nullptr;
+    if (heap == nullptr) {
+        std::cerr << "freeze did not return a frozen value, got=" << table->Inspect() << std::endl;
+        return;
+    }
+
+    std::vector<std::string> results(4);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            Isolate isolate;
+            isolate.Env()->HoldFrozen(heap);
+            isolate.Env()->Set("table", table);
+            results[i] = isolate.Run("sum(map(collect(range(500)), fn(i) { table[i][0] + len(table[i][1]) }))")->Inspect();
+            isolate.Collect();
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::string& result : results) {
+        if (result != "125750") {
+            std::cerr << "shared frozen table read got=" << result << ", want=125750" << std::endl;
+        }
+    }
+}
+
+void TestIsolateReset() {
+    Isolate isolate;
+    isolate.Collect();
+    const std::size_t empty = isolate.Env()->MemoryUsage();
+
+    // values bound twice, held by containers and left unbound all go; there
+    // are no calls, whose frames Collect does not take back either
+    for (int i = 0; i < 100; ++i) {
+        isolate.Run("let xs = [\"a\", \"b\", [1, 2]]; let ys = xs; let h = {\"k\": xs}; let f = fn(x) { x + 1 };");
+        isolate.Run("[ys[2], h[\"k\"], f]; [1, 2, 3]");
+        isolate.Reset();
+    }
+
+    isolate.Collect();
+    if (isolate.Env()->MemoryUsage() > empty) {
+        std::cerr << "Reset left " << isolate.Env()->MemoryUsage() - empty << " bytes behind" << std::endl;
+    }
+    object::Error* err = dynamic_cast<object::Error*>(isolate.Run("xs"));
+    if (!err || err->Message != "identifier not found: xs") {
+        std::cerr << "binding survived Reset" << std::endl;
+    }
+}
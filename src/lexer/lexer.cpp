@@ -112,7 +112,7 @@ std::string Lexer::readIdentifier() {
         readChar();
     }
 
-    return input.substr(position, this->position - position);
+    return std::string(input.substr(position, this->position - position));
 }
 
 std::string Lexer::readNumber() {
@@ -121,7 +121,7 @@ std::string Lexer::readNumber() {
         readChar();
     }
 
-    return input.substr(position, this->position - position);
+    return std::string(input.substr(position, this->position - position));
 }
 
 std::string Lexer::readString() {
@@ -133,7 +133,7 @@ std::string Lexer::readString() {
         }
     }
     
-    return input.substr(position, this->position - position);
+    return std::string(input.substr(position, this->position - position));
 }
 
 token::Token newToken(token::TokenType tokenType, unsigned char ch) {
@@ -1,7 +1,82 @@
 #include "../include/repl.h"
+#include "../include/batch.h"
 
-int main() {
-    Start(std::cin, std::cout);
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-    return 0;
+static const char* USAGE = " [--stats] [--max-steps n] [--max-depth n] [--max-bytes n] [--timeout ms] [script | --each fn | --map script inputs...]";
+
+// the count given to a limit option, false when there is none
+static bool limitValue(int argc, char* argv[], int& i, std::size_t& value) {
+    if (i + 1 >= argc) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoull(argv[++i], &end, 10);
+    return *argv[i] != '\0' && *end == '\0';
+}
+
+int main(int argc, char* argv[]) {
+    bool printStats = false;
+    allocator::Limits limits;
+    const char* script = nullptr;
+    const char* each = nullptr;
+    const char* map = nullptr;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::size_t value = 0;
+        bool ok = true;
+        if (std::strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (std::strcmp(argv[i], "--max-steps") == 0) {
+            ok = limitValue(argc, argv, i, limits.steps);
+        } else if (std::strcmp(argv[i], "--max-depth") == 0) {
+            ok = limitValue(argc, argv, i, limits.depth);
+        } else if (std::strcmp(argv[i], "--max-bytes") == 0) {
+            ok = limitValue(argc, argv, i, limits.bytes);
+        } else if (std::strcmp(argv[i], "--timeout") == 0) {
+            ok = limitValue(argc, argv, i, value);
+            limits.time = std::chrono::milliseconds(value);
+        } else if (std::strcmp(argv[i], "--each") == 0 && i + 1 < argc) {
+            each = argv[++i];
+        } else if (std::strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            // the rest are the files to run the script over
+            map = argv[++i];
+            inputs.assign(argv + i + 1, argv + argc);
+            i = argc;
+        } else if (argv[i][0] != '-' && script == nullptr) {
+            script = argv[i];
+        } else {
+            std::cerr << "unknown option: " << argv[i] << std::endl;
+            ok = false;
+        }
+
+        if (!ok || (script != nullptr) + (each != nullptr) + (map != nullptr) > 1) {
+            std::cerr << "usage: " << argv[0] << USAGE << std::endl;
+            return 2;
+        }
+    }
+
+    int status = 0;
+    if (script != nullptr || each != nullptr || map != nullptr) {
+        // nobody reads a script's output as it is written, so it goes out
+        // in large blocks
+        std::setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+        if (script != nullptr) {
+            status = RunFile(script, limits, printStats);
+        } else if (each != nullptr) {
+            status = RunEach(each, 0, stdout, limits);
+        } else {
+            status = RunMap(map, inputs, stdout, limits);
+        }
+    } else {
+        Start(std::cin, std::cout, printStats, limits);
+    }
+
+    // spawned tasks may still be running, so skip the static destructors
+    // they could race with
+    std::cout.flush();
+    std::quick_exit(status);
 }
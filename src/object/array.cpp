@@ -0,0 +1,159 @@
+#include "../../include/object.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace object {
+    Array* Array::fromElements(const std::vector<Object*>& elements) {
+        IntVector values;
+        values.reserve(elements.size());
+        for (Object* el : elements) {
+            Integer* integer = dynamic_cast<Integer*>(el);
+            if (integer == nullptr) {
+                return new Array(elements);
+            }
+            values.push_back(integer->Value);
+        }
+
+        return new Array(new PackedInts(std::move(values)));
+    }
+
+    Object* Array::at(std::size_t i) const {
+        if (Packed != nullptr) {
+            return new Integer(ints()[i]);
+        }
+        return Elements[i];
+    }
+
+    // elements [from, to), in a vector of their own
+    static std::vector<Object*> copyElements(const PersistentVector& elements, std::size_t from, std::size_t to) {
+        std::vector<Object*> copy;
+        copy.reserve(to - from);
+        for (std::size_t i = from; i < to; ++i) {
+            copy.push_back(elements[i]);
+        }
+        return copy;
+    }
+
+    Array::Array(const Array& other)
+        : Elements(other.frozen() ? PersistentVector(copyElements(other.Elements, 0, other.Elements.size()))
+                                  : other.Elements),
+          Packed(other.Packed),
+          PackedOffset(other.PackedOffset),
+          PackedLength(other.PackedLength)
+    {
+        if (Packed == nullptr) {
+            return;
+        }
+        if (other.frozen()) {
+            Packed = new PackedInts(IntVector(other.ints(), other.ints() + other.size()));
+            PackedOffset = 0;
+        } else {
+            Packed->owners++;
+        }
+    }
+
+    Array* Array::slice(std::size_t from, std::size_t to) const {
+        if (Packed == nullptr) {
+            if (frozen()) {
+                return new Array(copyElements(Elements, from, to));
+            }
+            return new Array(Elements.slice(from, to));
+        }
+
+        if (frozen()) {
+            return new Array(new PackedInts(IntVector(ints() + from, ints() + to)));
+        }
+
+        Array* view = new Array(*this);
+        view->PackedOffset += from;
+        view->PackedLength = to - from;
+        return view;
+    }
+
+    void Array::unpack() {
+        if (Packed == nullptr) {
+            return;
+        }
+
+        for (std::size_t i = 0; i < PackedLength; ++i) {
+            Elements.push_back(new Integer(ints()[i]));
+        }
+        release(Packed);
+        Packed = nullptr;
+        PackedOffset = 0;
+        PackedLength = 0;
+    }
+
+    void Array::push(Object* obj) {
+        if (Packed != nullptr) {
+            Integer* integer = dynamic_cast<Integer*>(obj);
+            if (integer != nullptr) {
+                pushInt(integer->Value);
+                return;
+            }
+            unpack();
+        }
+        Elements.push_back(obj);
+    }
+
+    // the slot after this view is free to take when nothing else owns the
+    // storage, or when no other view has taken it yet and it is already
+    // allocated; otherwise the view moves to storage of its own, with room
+    // to grow so that pushing n values copies O(n) of them in all
+    void Array::pushInt(int64_t value) {
+        IntVector& values = Packed->values;
+        std::size_t end = PackedOffset + PackedLength;
+
+        if (Packed->owners == 1) {
+            values.resize(end);
+            values.push_back(value);
+        } else if (end == values.size() && end < values.capacity()) {
+            values.push_back(value);
+        } else {
+            PackedInts* copy = new PackedInts();
+            copy->values.reserve(std::max<std::size_t>(2 * PackedLength, 8));
+            copy->values.assign(ints(), ints() + PackedLength);
+            copy->values.push_back(value);
+            release(Packed);
+            Packed = copy;
+            PackedOffset = 0;
+        }
+        PackedLength++;
+    }
+
+    void Array::pop() {
+        if (Packed != nullptr) {
+            PackedLength--;
+            return;
+        }
+        Elements.pop_back();
+    }
+
+    std::string Array::Inspect() const {
+        std::stringstream out;
+        out << "[";
+
+        bool first = true;
+        auto separate = [&]() {
+            if (!first) {
+                out << ", ";
+            }
+            first = false;
+        };
+        if (Packed != nullptr) {
+            for (std::size_t i = 0; i < PackedLength; ++i) {
+                separate();
+                out << ints()[i];
+            }
+        } else {
+            for (Object* el : Elements) {
+                separate();
+                out << el->Inspect();
+            }
+        }
+        out << "]";
+
+        return out.str();
+    }
+}
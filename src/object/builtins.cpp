@@ -1,7 +1,630 @@
 #include "../../include/object.h"
+#include "../../include/snapshot.h"
+#include "../../include/simd.h"
+#include "../../include/eval.h"
+#include "../../include/sort.h"
+#include "../../include/isolate.h"
+#include "../../include/transfer.h"
+#include "../../include/frozen.h"
+
+#include <fstream>
+#include <set>
+#include <thread>
 
 namespace object {
-    std::map<std::string, Builtin*> builtins {
+    static void setHashEntry(Hash* hash, const std::string& key, Object* value) {
+        String* keyObj = new String(key);
+        // the stats hashes only ever have these names as keys
+        hash->pushLiteral(keyObj->getHashKey(), HashPair{keyObj, value});
+    }
+
+    static Hash* newStatsHash(const allocator::Account& account) {
+        const allocator::Stats& stats = account.stats;
+        Hash* hash = new Hash({});
+
+        setHashEntry(hash, "live_bytes",      new Integer(account.liveBytes));
+        setHashEntry(hash, "peak_bytes",      new Integer(account.peakBytes));
+        setHashEntry(hash, "bytes_allocated", new Integer(stats.bytesAllocated));
+        setHashEntry(hash, "bytes_freed",     new Integer(stats.bytesFreed));
+        setHashEntry(hash, "frames_created",  new Integer(
+                    stats.allocations[static_cast<std::size_t>(allocator::Kind::Environment)]));
+        setHashEntry(hash, "collections",     new Integer(stats.collections));
+        setHashEntry(hash, "max_pause_ns",    new Integer(stats.maxPauseNanos));
+
+        Hash* allocations = new Hash({});
+        for (std::size_t i = 0; i < allocator::KIND_COUNT; ++i) {
+            if (stats.allocations[i] == 0) continue;
+            setHashEntry(allocations, allocator::KindName(static_cast<allocator::Kind>(i)),
+                    new Integer(stats.allocations[i]));
+        }
+        setHashEntry(hash, "allocations", allocations);
+
+        // keyed by the bucket's upper bound in microseconds
+        Hash* pauses = new Hash({});
+        for (std::size_t i = 0; i < allocator::PAUSE_BUCKETS; ++i) {
+            if (stats.pauses[i] == 0) continue;
+            Integer* bound = new Integer(int64_t(1) << i);
+            pauses->push(bound->getHashKey(), HashPair{bound, new Integer(stats.pauses[i])});
+        }
+        setHashEntry(hash, "pause_us", pauses);
+
+        return hash;
+    }
+
+    // the integers of an ARRAY argument, read in place when it is packed
+    struct IntArgument {
+        const int64_t* data = nullptr;
+        std::size_t size    = 0;
+        IntVector gathered;
+    };
+
+    // nullptr once arg is loaded into out, otherwise the Error to return
+    static Error* loadInts(const std::string& name, Object* arg, IntArgument& out) {
+        if (arg->Type() != ARRAY_OBJ) {
+            return new Error("argument to `" + name + "` must be ARRAY, got " + arg->Type());
+        }
+
+        Array* arrObj = dynamic_cast<Array*>(arg);
+        if (arrObj->packed()) {
+            out.data = arrObj->ints();
+            out.size = arrObj->size();
+            return nullptr;
+        }
+
+        out.gathered.reserve(arrObj->size());
+        for (Object* el : arrObj->Elements) {
+            Integer* integer = dynamic_cast<Integer*>(el);
+            if (integer == nullptr) {
+                return new Error("elements of `" + name + "` argument must be INTEGER, got " + el->Type());
+            }
+            out.gathered.push_back(integer->Value);
+        }
+        out.data = out.gathered.data();
+        out.size = out.gathered.size();
+        return nullptr;
+    }
+
+    // the result of a callback, null for a body that evaluated to nothing
+    static Object* resultOf(Object* result) {
+        return result != nullptr ? result : NULL_T.get();
+    }
+
+    // boxes runSequence makes for source elements; the ones nothing kept are
+    // freed as they pile up, the rest move to the session's heap at the end
+    class SourceBoxes {
+    public:
+        ~SourceBoxes() {
+            Environment* session = activeSession();
+            if (session != nullptr) {
+                session->heap.insert(session->heap.end(), boxes.begin(), boxes.end());
+            }
+        }
+
+        void track(Object* box) {
+            if (boxes.size() >= collectAt) {
+                boxes.erase(std::remove_if(boxes.begin(), boxes.end(), [](Object* obj) {
+                            if (obj->isAnon && obj->refCount <= 0) {
+                                delete obj;
+                                return true;
+                            }
+                            return !obj->isAnon;
+                        }), boxes.end());
+                collectAt = std::max(COLLECT_MIN, 2 * boxes.size());
+            }
+            boxes.push_back(box);
+        }
+
+    private:
+        static constexpr std::size_t COLLECT_MIN = 64;
+
+        std::vector<Object*> boxes;
+        std::size_t collectAt = COLLECT_MIN;
+    };
+
+    // Runs seq one element at a time, each going through every stage before
+    // the next is read. visit sees the elements that come out of the last
+    // stage and returns false to stop; it must take a reference on one it
+    // keeps past the next element. An Error from a stage ends the run and
+    // is returned.
+    static Object* runSequence(Sequence* seq, const std::function<bool(Object*)>& visit) {
+        const std::vector<Sequence::Stage>& stages = seq->Stages;
+        std::vector<std::unique_ptr<FrameCall>> calls;
+        for (const Sequence::Stage& stage : stages) {
+            if (stage.Kind == Sequence::StageKind::Take && stage.Count == 0) {
+                return nullptr;
+            }
+            calls.push_back(stage.Fn != nullptr ? std::make_unique<FrameCall>(stage.Fn) : nullptr);
+        }
+
+        SourceBoxes boxes;
+        std::vector<int64_t> taken(stages.size(), 0);
+        std::vector<Object*> callArgs(1);
+        bool exhausted = false;
+        for (std::size_t i = 0, size = seq->sourceSize(); i < size && !exhausted; ++i) {
+            Object* el = seq->sourceAt(i);
+            if (seq->boxesSource()) {
+                boxes.track(el);
+            }
+
+            bool kept = true;
+            for (std::size_t s = 0; s < stages.size() && kept; ++s) {
+                if (stages[s].Kind == Sequence::StageKind::Take) {
+                    // nothing is read past the last element a take lets through
+                    exhausted = exhausted || ++taken[s] == stages[s].Count;
+                    continue;
+                }
+
+                callArgs[0] = el;
+                Object* result = resultOf((*calls[s])(callArgs));
+                if (isError(result)) {
+                    return result;
+                }
+                if (stages[s].Kind == Sequence::StageKind::Map) {
+                    el = result;
+                } else {
+                    kept = isTruthy(result);
+                }
+            }
+            if (kept && !visit(el)) {
+                break;
+            }
+        }
+        return nullptr;
+    }
+
+    // elements a SEQUENCE hands to sum, min and max at a time
+    const std::size_t SEQUENCE_CHUNK = 1024;
+
+    // passes the integers seq yields to chunk in runs of up to SEQUENCE_CHUNK,
+    // a plain range without boxing them; nullptr or the Error to return
+    static Object* sequenceInts(const std::string& name, Sequence* seq,
+            const std::function<void(const int64_t*, std::size_t)>& chunk) {
+        IntVector buffer;
+        buffer.reserve(SEQUENCE_CHUNK);
+        auto add = [&](int64_t value) {
+            buffer.push_back(value);
+            if (buffer.size() == SEQUENCE_CHUNK) {
+                chunk(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        };
+
+        if (seq->plainRange()) {
+            for (std::size_t i = 0, size = seq->plainSize(); i < size; ++i) {
+                add(seq->rangeAt(i));
+            }
+        } else {
+            Object* failed = nullptr;
+            Object* err = runSequence(seq, [&](Object* el) {
+                        Integer* integer = dynamic_cast<Integer*>(el);
+                        if (integer == nullptr) {
+                            failed = new Error("elements of `" + name + "` argument must be INTEGER, got " + el->Type());
+                            return false;
+                        }
+                        add(integer->Value);
+                        return true;
+                    });
+            if (err != nullptr || failed != nullptr) {
+                return err != nullptr ? err : failed;
+            }
+        }
+
+        if (!buffer.empty()) {
+            chunk(buffer.data(), buffer.size());
+        }
+        return nullptr;
+    }
+
+    // sum, min and max over an array or a sequence; min and max of no
+    // elements are null
+    static Builtin* newReduction(const std::string& name, int64_t (*kernel)(const int64_t*, std::size_t), bool needsElements) {
+        return new Builtin([name, kernel, needsElements](std::vector<Object*> &args)->Object* {
+                    if (args.size() != 1) {
+                        std::stringstream out;
+                        out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                        return new Error(out.str());
+                    }
+
+                    // a sequence is reduced a chunk at a time, folding each
+                    // chunk's result into the running one with the same kernel
+                    if (Sequence* seq = dynamic_cast<Sequence*>(args[0])) {
+                        bool any = false;
+                        int64_t acc = 0;
+                        Object* err = sequenceInts(name, seq, [&](const int64_t* data, std::size_t size) {
+                                    int64_t pair[2] = {acc, kernel(data, size)};
+                                    acc = any ? kernel(pair, 2) : pair[1];
+                                    any = true;
+                                });
+                        if (err != nullptr) {
+                            return err;
+                        }
+                        if (!any && needsElements) {
+                            return NULL_T.get();
+                        }
+                        return new Integer(acc);
+                    }
+
+                    IntArgument ints;
+                    if (Error* err = loadInts(name, args[0], ints)) {
+                        return err;
+                    }
+                    if (ints.size == 0 && needsElements) {
+                        return NULL_T.get();
+                    }
+
+                    return new Integer(ints.size == 0 ? 0 : kernel(ints.data, ints.size));
+                });
+    }
+
+    // vadd, vsub and vmul: a packed array of a[i] op b[i], where b is an
+    // array of the same length or an integer used for every element
+    static Builtin* newElementWise(const std::string& name, void (*kernel)(const int64_t*, const int64_t*, int64_t*, std::size_t)) {
+        return new Builtin([name, kernel](std::vector<Object*> &args)->Object* {
+                    if (args.size() != 2) {
+                        std::stringstream out;
+                        out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                        return new Error(out.str());
+                    }
+
+                    IntArgument left, right;
+                    if (Error* err = loadInts(name, args[0], left)) {
+                        return err;
+                    }
+                    if (args[1]->Type() == INTEGER_OBJ) {
+                        right.gathered.assign(left.size, dynamic_cast<Integer*>(args[1])->Value);
+                        right.data = right.gathered.data();
+                        right.size = left.size;
+                    } else if (Error* err = loadInts(name, args[1], right)) {
+                        return err;
+                    }
+
+                    if (left.size != right.size) {
+                        std::stringstream out;
+                        out << "arguments to `" << name << "` differ in length: " << left.size << " and " << right.size;
+                        return new Error(out.str());
+                    }
+
+                    IntVector result(left.size);
+                    kernel(left.data, right.data, result.data(), left.size);
+                    return new Array(new PackedInts(std::move(result)));
+                });
+    }
+
+    // nullptr if args[0] is an ARRAY or a SEQUENCE and the last argument
+    // something callable, otherwise the Error to return
+    static Error* checkCollectionArgs(const std::string& name, std::vector<Object*>& args, std::size_t want) {
+        if (args.size() != want) {
+            std::stringstream out;
+            out << "wrong number of arguments. got=" << args.size() << ", want=" << want;
+            return new Error(out.str());
+        }
+        if (args[0]->Type() != ARRAY_OBJ && args[0]->Type() != SEQUENCE_OBJ) {
+            return new Error("argument to `" + name + "` must be ARRAY or SEQUENCE, got " + args[0]->Type());
+        }
+        Object* fn = args[want - 1];
+        if (fn->Type() != FUNCTION_OBJ && fn->Type() != BUILTIN_OBJ) {
+            return new Error("last argument to `" + name + "` must be FUNCTION, got " + fn->Type());
+        }
+        return nullptr;
+    }
+
+    // element i of arr as a call argument, boxing packed ones into call's frame
+    static Object* elementFor(FrameCall& call, Array* arr, std::size_t i) {
+        Object* el = arr->at(i);
+        if (arr->packed()) {
+            call.track(el);
+        }
+        return el;
+    }
+
+    // visits the elements of coll, an ARRAY or a SEQUENCE, in order with a
+    // callback; visit returns false to stop early, and an Error from the
+    // callback stops the walk and is returned
+    static Object* eachElement(Object* coll, Object* fn, std::size_t argCount,
+            const std::function<bool(Object* el, Object* result)>& visit,
+            const std::function<void(std::vector<Object*>&)>& extraArgs = nullptr) {
+        FrameCall call(fn);
+        std::vector<Object*> callArgs(argCount);
+        Object* failed = nullptr;
+        auto apply = [&](Object* el) {
+            callArgs[argCount - 1] = el;
+            if (extraArgs) {
+                extraArgs(callArgs);
+            }
+
+            Object* result = resultOf(call(callArgs));
+            if (isError(result)) {
+                failed = result;
+                return false;
+            }
+            return visit(el, result);
+        };
+
+        if (Sequence* seq = dynamic_cast<Sequence*>(coll)) {
+            Object* err = runSequence(seq, apply);
+            return err != nullptr ? err : failed;
+        }
+
+        Array* arr = dynamic_cast<Array*>(coll);
+        for (std::size_t i = 0; i < arr->size(); ++i) {
+            if (!apply(elementFor(call, arr, i))) {
+                break;
+            }
+        }
+        return failed;
+    }
+
+    // threads sort splits n elements across, each keeping a run large
+    // enough to be worth a thread of its own
+    static unsigned int sortWorkers(std::size_t n) {
+        if (n < sort::PARALLEL_THRESHOLD) {
+            return 1;
+        }
+        std::size_t runs = n / (sort::PARALLEL_THRESHOLD / 4);
+        return unsigned(std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), runs));
+    }
+
+    // a new Sequence running source, an ARRAY or a SEQUENCE, through its
+    // stages and then stage; an Error for any other source
+    static Object* addStage(const std::string& name, Object* source, const Sequence::Stage& stage) {
+        Sequence* seq = nullptr;
+        if (Sequence* from = dynamic_cast<Sequence*>(source)) {
+            seq = new Sequence(*from);
+        } else if (Array* arr = dynamic_cast<Array*>(source)) {
+            seq = new Sequence(arr);
+        } else {
+            return new Error("argument to `" + name + "` must be ARRAY or SEQUENCE, got " + source->Type());
+        }
+
+        if (stage.Fn != nullptr) {
+            stage.Fn->incrRefCount();
+        }
+        seq->Stages.push_back(stage);
+        return seq;
+    }
+
+    // Calls fn with args as a task of its own, in an isolate that gets
+    // copies of both. Whatever the call returns is dropped, an Error it ends
+    // with has nowhere to go but stderr.
+    static Object* spawnTask(Object* fn, const std::vector<Object*>& args) {
+        Isolate* isolate = nullptr;
+        {
+            // freed by the task, so it must not be charged to this session
+            allocator::Scope detached(nullptr);
+            isolate = new Isolate();
+        }
+        // the task runs under the limits of the session spawning it
+        if (Environment* parent = activeSession()) {
+            isolate->Env()->SetLimits(parent->account->limits);
+        }
+        // the task frees the copies once the isolate, whose bindings may
+        // reference them, is gone
+        std::shared_ptr<Transfer> transfer = std::make_shared<Transfer>(isolate->Env());
+
+        Object* fnCopy = nullptr;
+        std::vector<Object*> argCopies;
+        std::string failure;
+        {
+            SessionScope scope(isolate->Env());
+            Error* err = transfer->Copy(fn, fnCopy);
+            for (std::size_t i = 0; err == nullptr && i < args.size(); ++i) {
+                Object* argCopy = nullptr;
+                err = transfer->Copy(args[i], argCopy);
+                argCopies.push_back(argCopy);
+            }
+            if (err != nullptr) {
+                failure = err->Message;
+                delete err;
+            }
+        }
+        if (!failure.empty()) {
+            delete isolate;
+            return new Error(failure);
+        }
+
+        scheduler::Spawn([isolate, transfer, fnCopy, argCopies]() mutable {
+            {
+                SessionScope scope(isolate->Env());
+                startEvaluation(isolate->Env()->account);
+                Object* result = applyFunction(fnCopy, argCopies);
+                if (isError(result)) {
+                    std::cerr << "spawned task failed: " << result->Inspect() << std::endl;
+                }
+                isolate->Collect();
+            }
+            // the copies' scopes may bind frozen values, whose heaps have
+            // to outlast them
+            std::vector<std::shared_ptr<FrozenHeap>> frozen = std::move(isolate->Env()->frozen);
+            delete isolate;
+            transfer.reset();
+        });
+        return NULL_T.get();
+    }
+
+    // builtins a callback run in parallel must not reach: they write to
+    // their arguments, print, or talk to other tasks
+    static const std::set<std::string> IMPURE_BUILTINS = {
+        "puts", "push", "pop", "heap_snapshot", "spawn", "send", "recv", "close",
+        "read_file_async", "write_async", "await", "DEC_REF_COUNT",
+    };
+
+    // nullptr when fn, and every function its body reaches by name, only
+    // assigns to names it binds itself and calls no impure builtin; the
+    // Error saying why not otherwise
+    static Error* checkPure(const std::string& name, Object* fn, std::set<Object*>& checked) {
+        if (fn->Type() == BUILTIN_OBJ) {
+            for (const auto& entry : builtins) {
+                if (entry.second == fn && IMPURE_BUILTINS.count(entry.first) != 0) {
+                    return new Error("function passed to `" + name + "` is not pure: it is `" + entry.first + "`");
+                }
+            }
+            return nullptr;
+        }
+
+        Function* function = dynamic_cast<Function*>(fn);
+        if (function == nullptr || !checked.insert(fn).second) {
+            return nullptr;
+        }
+
+        std::set<symbol::Id> locals = ast::BoundNames(function->Parameters, function->Body);
+        Error* impure = nullptr;
+        ast::Walk(function->Body, [&](ast::Node* node) {
+            if (impure != nullptr) {
+                return;
+            }
+            if (node->GetType() == ast::NodeType::AssignExpression) {
+                ast::Identifier* target = static_cast<ast::AssignExpression*>(node)->Left;
+                if (locals.count(target->Symbol) == 0) {
+                    impure = new Error("function passed to `" + name + "` is not pure: it assigns to " + target->Value);
+                }
+                return;
+            }
+            if (node->GetType() != ast::NodeType::Identifier) {
+                return;
+            }
+
+            ast::Identifier* ident = static_cast<ast::Identifier*>(node);
+            if (locals.count(ident->Symbol) != 0) {
+                return;
+            }
+            std::pair<Object*, bool> bound = function->Env->Get(ident->Symbol);
+            if (bound.second) {
+                impure = checkPure(name, bound.first, checked);
+            } else if (IMPURE_BUILTINS.count(ident->Value) != 0 && lookupBuiltin(ident->Symbol) != nullptr) {
+                impure = new Error("function passed to `" + name + "` is not pure: it calls `" + ident->Value + "`");
+            }
+        });
+        return impure;
+    }
+
+    // arrays shorter than this are not worth splitting
+    static const std::size_t PARALLEL_CHUNK_MIN = 512;
+
+    // Runs one chunk of a parallel builtin over count elements: element(i)
+    // gives element i of the chunk as a call argument, call calls the
+    // callback. Returns what the chunk yields, or an Error.
+    typedef std::function<Object*(FrameCall& call, const std::function<Object*(std::size_t)>& element,
+            std::size_t count)> ChunkBody;
+
+    // Splits arr into chunks and runs body over each as a task of its own,
+    // in an isolate that gets copies of fn and the chunk's elements, while
+    // the calling task or thread waits. What each chunk yields is copied
+    // back onto the session's heap and put in out in the order of the
+    // chunks; the Error that stopped a chunk is returned instead. An array
+    // too short to split runs as a single chunk in the calling session.
+    static Object* runChunks(Array* arr, Object* fn, const ChunkBody& body, std::vector<Object*>& out) {
+        const std::size_t n = arr->size();
+        const std::size_t chunks = std::min(scheduler::Workers() * 4, n / PARALLEL_CHUNK_MIN);
+        if (chunks <= 1) {
+            FrameCall call(fn);
+            Object* value = body(call, [&](std::size_t i) { return elementFor(call, arr, i); }, n);
+            if (isError(value)) {
+                return value;
+            }
+            out.push_back(value);
+            return nullptr;
+        }
+
+        // each chunk runs under the caller's limits
+        Environment* caller = activeSession();
+        const allocator::Limits limits = caller != nullptr ? caller->account->limits : allocator::Limits();
+        std::vector<Message> yields(chunks);
+        std::vector<std::string> failures(chunks);
+        auto done = std::make_shared<scheduler::Channel<std::size_t>>(chunks);
+
+        for (std::size_t c = 0; c < chunks; ++c) {
+            const std::size_t from = n * c / chunks;
+            const std::size_t to = n * (c + 1) / chunks;
+
+            // the caller waits for every chunk, so the task may use its locals
+            scheduler::Spawn([&, c, from, to, done]() {
+                Isolate* isolate = new Isolate();
+                isolate->Env()->SetLimits(limits);
+                {
+                    Transfer in(isolate->Env());
+                    SessionScope scope(isolate->Env());
+                    startEvaluation(isolate->Env()->account);
+
+                    Object* fnCopy = nullptr;
+                    Object* value = in.Copy(fn, fnCopy);
+                    if (value == nullptr) {
+                        FrameCall call(fnCopy);
+                        value = body(call, [&](std::size_t i) -> Object* {
+                            if (arr->packed()) {
+                                return elementFor(call, arr, from + i);
+                            }
+                            Object* copy = nullptr;
+                            if (Error* err = in.Copy(arr->Elements[from + i], copy)) {
+                                call.track(err);
+                                return err;
+                            }
+                            return copy;
+                        }, to - from);
+                    } else {
+                        isolate->Env()->heap.push_back(value);
+                    }
+
+                    if (isError(value)) {
+                        failures[c] = dynamic_cast<Error*>(value)->Message;
+                    } else {
+                        Transfer back;
+                        Object* copy = nullptr;
+                        allocator::Scope transit(nullptr);
+                        if (Error* err = back.Copy(value, copy)) {
+                            failures[c] = err->Message;
+                            delete err;
+                        } else {
+                            yields[c] = Message(copy, back.release(), back.releaseFrozen());
+                        }
+                    }
+
+                    // frees what the chunk left while the copies it may
+                    // reference are still there
+                    isolate->Collect();
+                }
+                delete isolate;
+                done->send(c);
+            });
+        }
+
+        std::size_t finished = 0;
+        for (std::size_t c = 0; c < chunks; ++c) {
+            done->recv(finished);
+        }
+
+        for (std::size_t c = 0; c < chunks; ++c) {
+            if (!failures[c].empty()) {
+                return new Error(failures[c]);
+            }
+        }
+        Environment* session = activeSession();
+        for (Message& yield : yields) {
+            out.push_back(session != nullptr ? yield.adopt(session) : yield.Value);
+        }
+        return nullptr;
+    }
+
+    // the first two arguments of pmap and preduce, checked the way
+    // checkCollectionArgs checks them for map and reduce
+    static Error* checkParallelArgs(const std::string& name, std::vector<Object*>& args, std::size_t want) {
+        if (args.size() != want) {
+            std::stringstream out;
+            out << "wrong number of arguments. got=" << args.size() << ", want=" << want;
+            return new Error(out.str());
+        }
+        if (args[0]->Type() != ARRAY_OBJ) {
+            return new Error("first argument to `" + name + "` must be ARRAY, got " + args[0]->Type());
+        }
+        Object* fn = args[want - 1];
+        if (fn->Type() != FUNCTION_OBJ && fn->Type() != BUILTIN_OBJ) {
+            return new Error("last argument to `" + name + "` must be FUNCTION, got " + fn->Type());
+        }
+
+        std::set<Object*> checked;
+        return checkPure(name, fn, checked);
+    }
+
+    const std::map<std::string, Builtin*> builtins {
         {
             "len",
                 new Builtin([](std::vector<Object*> &args)->Object* {
@@ -16,7 +639,7 @@ namespace object {
                                 return new Integer(strObj->Value.length());
                             } else if (args[0]->Type() == ARRAY_OBJ) {
                                 Array* arrObj = dynamic_cast<Array*>(args[0]); 
-                            return new Integer(arrObj->Elements.size());
+                            return new Integer(arrObj->size());
                             }
 
                             return new Error("argument to `len` not supported, got " + args[0]->Type());
@@ -36,11 +659,11 @@ namespace object {
                             }
 
                             Array* arrObj = dynamic_cast<Array*>(args[0]);
-                                if (arrObj->Elements.size() == 0) {
+                                if (arrObj->empty()) {
                                 return new Error("arrObj->Elements size is 0");
                             }
 
-                            return arrObj->Elements.back();
+                            return arrObj->at(arrObj->size() - 1);
                         })
             },
             {
@@ -57,13 +680,12 @@ namespace object {
                             }
 
                             Array* arrObj = dynamic_cast<Array*>(args[0]);
-                            if (arrObj->Elements.size() < 2) {
+                            if (arrObj->size() < 2) {
                                 return new Error("arrObj->Elements size less than minimum required (2)");
                             }
 
 
-                            std::vector<Object*> elements = arrObj->Elements;
-                            return new Array(std::vector<Object*>(elements.begin() + 1, elements.end()));
+                            return arrObj->slice(1, arrObj->size());
                         })
             },
             {
@@ -80,6 +702,9 @@ namespace object {
                             }
 
                             Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            if (arrObj->frozen()) {
+                                return new Error("cannot push to a frozen ARRAY");
+                            }
                             arrObj->push(args[1]);
 
                             return arrObj;
@@ -99,28 +724,330 @@ namespace object {
                             }
 
                             Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            if (arrObj->frozen()) {
+                                return new Error("cannot pop from a frozen ARRAY");
+                            }
+                            if (arrObj->empty()) {
+                                return new Error("cannot pop from an empty ARRAY");
+                            }
                             arrObj->pop();
 
-                            return new Integer(arrObj->Elements.size());
+                            return new Integer(arrObj->size());
                         })
             },
-            // DEBUG OBJ REF COUNT
             {
+                "slice",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2 && args.size() != 3) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2 or 3";
+                                return new Error(out.str());
+                            }
 
-                "GET_REF_COUNT",
+                            if (args[0]->Type() != ARRAY_OBJ && args[0]->Type() != STRING_OBJ) {
+                                return new Error("argument to `slice` must be ARRAY or STRING, got " + args[0]->Type());
+                            }
+                            for (unsigned int i = 1; i < args.size(); ++i) {
+                                if (args[i]->Type() != INTEGER_OBJ) {
+                                    return new Error("bounds of `slice` must be INTEGER, got " + args[i]->Type());
+                                }
+                            }
+
+                            String* strObj = dynamic_cast<String*>(args[0]);
+                            Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            int64_t size = strObj ? strObj->Value.size() : arrObj->size();
+                            int64_t from = dynamic_cast<Integer*>(args[1])->Value;
+                            int64_t to = args.size() == 3 ? dynamic_cast<Integer*>(args[2])->Value : size;
+
+                            from = std::clamp<int64_t>(from, 0, size);
+                            to = std::clamp<int64_t>(to, from, size);
+
+                            if (strObj) {
+                                return new String(*strObj, from, to);
+                            }
+                            return arrObj->slice(from, to);
+                        })
+            },
+            // INTEGER ARRAYS
+            { "sum",  newReduction("sum", simd::Sum, false) },
+            { "min",  newReduction("min", simd::Min, true) },
+            { "max",  newReduction("max", simd::Max, true) },
+            { "vadd", newElementWise("vadd", simd::Add) },
+            { "vsub", newElementWise("vsub", simd::Sub) },
+            { "vmul", newElementWise("vmul", simd::Mul) },
+            {
+                "dot",
                 new Builtin([](std::vector<Object*> &args)->Object* {
-                            if (args.size() != 1) {
+                            if (args.size() != 2) {
                                 std::stringstream out;
-                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
                                 return new Error(out.str());
                             }
 
-                            return new Integer(args[0]->refCount);
+                            IntArgument left, right;
+                            if (Error* err = loadInts("dot", args[0], left)) {
+                                return err;
+                            }
+                            if (Error* err = loadInts("dot", args[1], right)) {
+                                return err;
+                            }
+                            if (left.size != right.size) {
+                                std::stringstream out;
+                                out << "arguments to `dot` differ in length: " << left.size << " and " << right.size;
+                                return new Error(out.str());
+                            }
+
+                            return new Integer(simd::Dot(left.data, right.data, left.size));
                         })
             },
+            // COLLECTIONS
             {
+                "map",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("map", args, 2)) {
+                                return err;
+                            }
 
-                "DEC_REF_COUNT",
+                            // each result is held until the array owns it, so
+                            // collections during the walk leave it alone
+                            std::vector<Object*> results;
+                            if (Array* arrObj = dynamic_cast<Array*>(args[0])) {
+                                results.reserve(arrObj->size());
+                            }
+                            Object* err = eachElement(args[0], args[1], 1, [&](Object*, Object* result) {
+                                result->incrRefCount();
+                                results.push_back(result);
+                                return true;
+                            });
+
+                            Array* mapped = err == nullptr ? Array::fromElements(results) : nullptr;
+                            for (Object* result : results) {
+                                result->decRefCount();
+                            }
+                            return err != nullptr ? err : mapped;
+                        })
+            },
+            {
+                "filter",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("filter", args, 2)) {
+                                return err;
+                            }
+
+                            Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            if (arrObj != nullptr && arrObj->packed()) {
+                                IntVector kept;
+                                kept.reserve(arrObj->size());
+                                Object* err = eachElement(arrObj, args[1], 1, [&](Object* el, Object* result) {
+                                    if (isTruthy(result)) kept.push_back(dynamic_cast<Integer*>(el)->Value);
+                                    return true;
+                                });
+                                return err != nullptr ? err : new Array(new PackedInts(std::move(kept)));
+                            }
+
+                            // elements of a sequence may be temporaries, held
+                            // like map's results until the array owns them
+                            bool hold = arrObj == nullptr;
+                            std::vector<Object*> kept;
+                            Object* err = eachElement(args[0], args[1], 1, [&](Object* el, Object* result) {
+                                if (isTruthy(result)) {
+                                    if (hold) el->incrRefCount();
+                                    kept.push_back(el);
+                                }
+                                return true;
+                            });
+
+                            Array* filtered = err == nullptr ? Array::fromElements(kept) : nullptr;
+                            for (Object* el : kept) {
+                                if (hold) el->decRefCount();
+                            }
+                            return err != nullptr ? err : filtered;
+                        })
+            },
+            {
+                "reduce",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("reduce", args, 3)) {
+                                return err;
+                            }
+
+                            // reduce(arr, initial, fn) calls fn(acc, el) for every element
+                            Object* acc = args[1];
+                            Object* err = eachElement(args[0], args[2], 2,
+                                    [&](Object*, Object* result) { acc = result; return true; },
+                                    [&](std::vector<Object*>& callArgs) { callArgs[0] = acc; });
+                            return err != nullptr ? err : acc;
+                        })
+            },
+            {
+                "each",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("each", args, 2)) {
+                                return err;
+                            }
+
+                            Object* err = eachElement(args[0], args[1], 1,
+                                    [](Object*, Object*) { return true; });
+                            return err != nullptr ? err : NULL_T.get();
+                        })
+            },
+            {
+                "find",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("find", args, 2)) {
+                                return err;
+                            }
+
+                            Object* found = NULL_T.get();
+                            Object* err = eachElement(args[0], args[1], 1,
+                                    [&](Object* el, Object* result) {
+                                        if (!isTruthy(result)) return true;
+                                        found = el;
+                                        return false;
+                                    });
+                            return err != nullptr ? err : found;
+                        })
+            },
+            {
+                "pmap",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkParallelArgs("pmap", args, 2)) {
+                                return err;
+                            }
+
+                            // each chunk maps its elements the way map does
+                            std::vector<Object*> parts;
+                            Object* err = runChunks(dynamic_cast<Array*>(args[0]), args[1],
+                                    [](FrameCall& call, const std::function<Object*(std::size_t)>& element, std::size_t count) -> Object* {
+                                        std::vector<Object*> callArgs(1);
+                                        std::vector<Object*> results;
+                                        results.reserve(count);
+                                        Object* failed = nullptr;
+                                        for (std::size_t i = 0; i < count && failed == nullptr; ++i) {
+                                            callArgs[0] = element(i);
+                                            Object* result = isError(callArgs[0]) ? callArgs[0] : resultOf(call(callArgs));
+                                            if (isError(result)) {
+                                                failed = result;
+                                            } else {
+                                                result->incrRefCount();
+                                                results.push_back(result);
+                                            }
+                                        }
+
+                                        Array* mapped = failed == nullptr ? Array::fromElements(results) : nullptr;
+                                        for (Object* result : results) {
+                                            result->decRefCount();
+                                        }
+                                        return failed != nullptr ? failed : mapped;
+                                    }, parts);
+                            if (err != nullptr) {
+                                return err;
+                            }
+                            if (parts.size() == 1) {
+                                return parts[0];
+                            }
+
+                            bool packed = std::all_of(parts.begin(), parts.end(),
+                                    [](Object* part) { return dynamic_cast<Array*>(part)->packed(); });
+                            if (packed) {
+                                IntVector values;
+                                for (Object* part : parts) {
+                                    Array* partArr = dynamic_cast<Array*>(part);
+                                    values.insert(values.end(), partArr->ints(), partArr->ints() + partArr->size());
+                                }
+                                return new Array(new PackedInts(std::move(values)));
+                            }
+
+                            // integers boxed out of packed parts go on the
+                            // session's heap, the array holds them from there
+                            Environment* session = activeSession();
+                            std::vector<Object*> elements;
+                            for (Object* part : parts) {
+                                Array* partArr = dynamic_cast<Array*>(part);
+                                for (std::size_t i = 0; i < partArr->size(); ++i) {
+                                    Object* el = partArr->at(i);
+                                    if (partArr->packed() && session != nullptr) {
+                                        session->heap.push_back(el);
+                                    }
+                                    elements.push_back(el);
+                                }
+                            }
+                            return new Array(elements);
+                        })
+            },
+            {
+                "preduce",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkParallelArgs("preduce", args, 3)) {
+                                return err;
+                            }
+
+                            // preduce(arr, initial, fn) takes its arguments
+                            // like reduce; fn must be associative, each chunk
+                            // folds its own elements and the partial results
+                            // are combined pairwise, level by level
+                            Array* arr = dynamic_cast<Array*>(args[0]);
+                            Object* initial = args[1];
+                            Object* fn = args[2];
+                            if (arr->empty()) {
+                                return initial;
+                            }
+
+                            std::vector<Object*> level;
+                            Object* err = runChunks(arr, fn,
+                                    [](FrameCall& call, const std::function<Object*(std::size_t)>& element, std::size_t count) -> Object* {
+                                        std::vector<Object*> callArgs(2);
+                                        Object* acc = element(0);
+                                        for (std::size_t i = 1; i < count && !isError(acc); ++i) {
+                                            callArgs[0] = acc;
+                                            callArgs[1] = element(i);
+                                            acc = isError(callArgs[1]) ? callArgs[1] : resultOf(call(callArgs));
+                                        }
+                                        return acc;
+                                    }, level);
+                            if (err != nullptr) {
+                                return err;
+                            }
+
+                            // partial results are held until the end, so
+                            // collections between the calls leave them alone
+                            FrameCall call(fn);
+                            std::vector<Object*> callArgs(2);
+                            std::vector<Object*> held;
+                            Object* failed = nullptr;
+                            auto combine = [&](Object* left, Object* right) {
+                                callArgs[0] = left;
+                                callArgs[1] = right;
+                                Object* result = resultOf(call(callArgs));
+                                if (isError(result)) {
+                                    failed = result;
+                                } else {
+                                    result->incrRefCount();
+                                    held.push_back(result);
+                                }
+                                return result;
+                            };
+
+                            while (level.size() > 1 && failed == nullptr) {
+                                std::vector<Object*> next;
+                                for (std::size_t i = 0; i + 1 < level.size() && failed == nullptr; i += 2) {
+                                    next.push_back(combine(level[i], level[i + 1]));
+                                }
+                                if (level.size() % 2 == 1) {
+                                    next.push_back(level.back());
+                                }
+                                level = std::move(next);
+                            }
+                            Object* result = failed == nullptr ? combine(initial, level[0]) : nullptr;
+
+                            for (Object* obj : held) {
+                                obj->decRefCount();
+                            }
+                            return failed != nullptr ? failed : result;
+                        })
+            },
+            {
+                "sort",
                 new Builtin([](std::vector<Object*> &args)->Object* {
                             if (args.size() != 1) {
                                 std::stringstream out;
@@ -128,21 +1055,691 @@ namespace object {
                                 return new Error(out.str());
                             }
 
-                            args[0]->decRefCount();
+                            if (args[0]->Type() != ARRAY_OBJ) {
+                                return new Error("argument to `sort` must be ARRAY, got " + args[0]->Type());
+                            }
 
-                            return NULL_T.get();
+                            Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            if (arrObj->packed()) {
+                                IntVector values(arrObj->ints(), arrObj->ints() + arrObj->size());
+                                sort::parallelSort<true>(values.data(), values.size(), std::less<int64_t>(),
+                                        sortWorkers(values.size()));
+                                return new Array(new PackedInts(std::move(values)));
+                            }
+                            if (arrObj->empty()) {
+                                return new Array(std::vector<Object*>{});
+                            }
+
+                            // a boxed array sorts the same way once its elements
+                            // are known to be all integers or all strings
+                            ObjectType type = arrObj->Elements[0]->Type();
+                            for (Object* el : arrObj->Elements) {
+                                if (el->Type() != INTEGER_OBJ && el->Type() != STRING_OBJ) {
+                                    return new Error("elements of `sort` argument must be INTEGER or STRING, got " + el->Type());
+                                }
+                                if (el->Type() != type) {
+                                    return new Error("elements of `sort` argument must share a type, got " + type + " and " + el->Type());
+                                }
+                            }
+
+                            if (type == INTEGER_OBJ) {
+                                IntVector values;
+                                values.reserve(arrObj->size());
+                                for (Object* el : arrObj->Elements) {
+                                    values.push_back(dynamic_cast<Integer*>(el)->Value);
+                                }
+                                sort::parallelSort<true>(values.data(), values.size(), std::less<int64_t>(),
+                                        sortWorkers(values.size()));
+                                return new Array(new PackedInts(std::move(values)));
+                            }
+
+                            std::vector<Object*> strings(arrObj->Elements.begin(), arrObj->Elements.end());
+                            sort::parallelSort(strings.data(), strings.size(), [](Object* a, Object* b) {
+                                        return static_cast<String*>(a)->Value < static_cast<String*>(b)->Value;
+                                    }, sortWorkers(strings.size()));
+                            return new Array(strings);
                         })
             },
-            // REPL
             {
-                "puts",
+                "sort_by",
                 new Builtin([](std::vector<Object*> &args)->Object* {
-                    for (Object* arg : args) {
-                        std::cout << arg->Inspect() << std::endl;
-                    }
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
 
-                    return NULL_T.get();
-                })
-            }
-    };
+                            if (args[0]->Type() != ARRAY_OBJ) {
+                                return new Error("argument to `sort_by` must be ARRAY, got " + args[0]->Type());
+                            }
+                            if (args[1]->Type() != FUNCTION_OBJ && args[1]->Type() != BUILTIN_OBJ) {
+                                return new Error("last argument to `sort_by` must be FUNCTION, got " + args[1]->Type());
+                            }
+
+                            // sort_by(arr, fn) puts a before b when fn(a, b) is
+                            // truthy; every comparison reuses the one frame
+                            Array* arrObj = dynamic_cast<Array*>(args[0]);
+                            FrameCall call(args[1]);
+                            std::vector<Object*> items(arrObj->size());
+                            for (std::size_t i = 0; i < items.size(); ++i) {
+                                items[i] = elementFor(call, arrObj, i);
+                                items[i]->incrRefCount();
+                            }
+
+                            // after an Error the rest of the sort compares nothing
+                            Object* failed = nullptr;
+                            std::vector<Object*> callArgs(2);
+                            sort::stableSort(items, [&](Object* a, Object* b) {
+                                        if (failed != nullptr) {
+                                            return false;
+                                        }
+                                        callArgs[0] = a;
+                                        callArgs[1] = b;
+                                        Object* result = resultOf(call(callArgs));
+                                        if (isError(result)) {
+                                            failed = result;
+                                            return false;
+                                        }
+                                        return isTruthy(result);
+                                    });
+
+                            Array* sorted = failed == nullptr ? Array::fromElements(items) : nullptr;
+                            for (Object* item : items) {
+                                item->decRefCount();
+                            }
+                            return failed != nullptr ? failed : sorted;
+                        })
+            },
+            {
+                "range",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.empty() || args.size() > 3) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1, 2 or 3";
+                                return new Error(out.str());
+                            }
+
+                            // range(stop), range(start, stop) or range(start, stop, step)
+                            int64_t bounds[3] = {0, 0, 1};
+                            for (std::size_t i = 0; i < args.size(); ++i) {
+                                Integer* integer = dynamic_cast<Integer*>(args[i]);
+                                if (integer == nullptr) {
+                                    return new Error("arguments to `range` must be INTEGER, got " + args[i]->Type());
+                                }
+                                bounds[args.size() == 1 ? 1 : i] = integer->Value;
+                            }
+                            if (bounds[2] == 0) {
+                                return new Error("step of `range` must not be 0");
+                            }
+
+                            return new Sequence(bounds[0], bounds[1], bounds[2]);
+                        })
+            },
+            {
+                "lmap",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("lmap", args, 2)) {
+                                return err;
+                            }
+                            return addStage("lmap", args[0], {Sequence::StageKind::Map, args[1]});
+                        })
+            },
+            {
+                "lfilter",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (Error* err = checkCollectionArgs("lfilter", args, 2)) {
+                                return err;
+                            }
+                            return addStage("lfilter", args[0], {Sequence::StageKind::Filter, args[1]});
+                        })
+            },
+            {
+                "take",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
+
+                            Integer* count = dynamic_cast<Integer*>(args[1]);
+                            if (count == nullptr) {
+                                return new Error("second argument to `take` must be INTEGER, got " + args[1]->Type());
+                            }
+                            if (count->Value < 0) {
+                                return new Error("count of `take` must not be negative");
+                            }
+                            return addStage("take", args[0], {Sequence::StageKind::Take, nullptr, count->Value});
+                        })
+            },
+            {
+                "collect",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() == ARRAY_OBJ) {
+                                return args[0];
+                            }
+                            Sequence* seq = dynamic_cast<Sequence*>(args[0]);
+                            if (seq == nullptr) {
+                                return new Error("argument to `collect` must be ARRAY or SEQUENCE, got " + args[0]->Type());
+                            }
+
+                            if (seq->plainRange()) {
+                                IntVector values(seq->plainSize());
+                                for (std::size_t i = 0; i < values.size(); ++i) {
+                                    values[i] = seq->rangeAt(i);
+                                }
+                                return new Array(new PackedInts(std::move(values)));
+                            }
+
+                            // packed as long as the elements are integers, the
+                            // array holds a reference on any boxed one it takes
+                            Array* collected = new Array(new PackedInts());
+                            Object* err = runSequence(seq, [&](Object* el) {
+                                        collected->push(el);
+                                        return true;
+                                    });
+                            if (err != nullptr) {
+                                delete collected;
+                                return err;
+                            }
+                            return collected;
+                        })
+            },
+            {
+                "split",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != STRING_OBJ || args[1]->Type() != STRING_OBJ) {
+                                return new Error("arguments to `split` must be STRING, got " +
+                                        args[0]->Type() + " and " + args[1]->Type());
+                            }
+
+                            String* strObj = dynamic_cast<String*>(args[0]);
+                            std::string_view sep = dynamic_cast<String*>(args[1])->Value;
+                            std::string_view text = strObj->Value;
+
+                            // the parts are views into the string being split
+                            Array* parts = new Array(std::vector<Object*>{});
+                            if (sep.empty()) {
+                                for (std::size_t i = 0; i < text.size(); ++i) {
+                                    parts->push(new String(*strObj, i, i + 1));
+                                }
+                                return parts;
+                            }
+
+                            std::size_t from = 0;
+                            for (std::size_t at = text.find(sep); at != std::string_view::npos; at = text.find(sep, from)) {
+                                parts->push(new String(*strObj, from, at));
+                                from = at + sep.size();
+                            }
+                            parts->push(new String(*strObj, from, text.size()));
+
+                            return parts;
+                        })
+            },
+            {
+                "compact",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != STRING_OBJ) {
+                                return new Error("argument to `compact` must be STRING, got " + args[0]->Type());
+                            }
+
+                            // lets the buffer a small slice was cut from go
+                            String* strObj = dynamic_cast<String*>(args[0]);
+                            if (strObj->frozen()) {
+                                return new Error("cannot compact a frozen STRING");
+                            }
+                            strObj->compact();
+
+                            return strObj;
+                        })
+            },
+            {
+                "set",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 3) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=3";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != HASH_OBJ) {
+                                return new Error("argument to `set` must be HASH, got " + args[0]->Type());
+                            }
+
+                            Hashable* hashable = dynamic_cast<Hashable*>(args[1]);
+                            if (!hashable) {
+                                return new Error("unusable as hash key: " + args[1]->Type());
+                            }
+
+                            // the copy shares all but the path to the new key with the original
+                            Hash* hashObj = dynamic_cast<Hash*>(args[0])->clone();
+                            hashObj->push(hashable->getHashKey(), HashPair{args[1], args[2]});
+
+                            return hashObj;
+                        })
+            },
+            {
+                "delete",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != HASH_OBJ) {
+                                return new Error("argument to `delete` must be HASH, got " + args[0]->Type());
+                            }
+
+                            Hashable* hashable = dynamic_cast<Hashable*>(args[1]);
+                            if (!hashable) {
+                                return new Error("unusable as hash key: " + args[1]->Type());
+                            }
+
+                            Hash* hashObj = dynamic_cast<Hash*>(args[0])->clone();
+                            hashObj->pop(hashable->getHashKey());
+
+                            return hashObj;
+                        })
+            },
+            {
+                "intern",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != STRING_OBJ) {
+                                return new Error("argument to `intern` must be STRING, got " + args[0]->Type());
+                            }
+
+                            // comparing the result against other interned strings skips their text
+                            String* strObj = dynamic_cast<String*>(args[0]);
+                            if (strObj->Symbol != symbol::NONE) {
+                                return strObj;
+                            }
+                            return strObj->clone()->intern();
+                        })
+            },
+            // DEBUG OBJ REF COUNT
+            {
+
+                "GET_REF_COUNT",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            return new Integer(args[0]->refCount);
+                        })
+            },
+            {
+
+                "DEC_REF_COUNT",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            args[0]->decRefCount();
+
+                            return NULL_T.get();
+                        })
+            },
+            // MEMORY
+            {
+                "mem_usage",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 0) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=0";
+                                return new Error(out.str());
+                            }
+
+                            allocator::Account* account = allocator::active();
+                            if (account == nullptr) {
+                                return new Integer(0);
+                            }
+
+                            return new Integer(account->liveBytes);
+                        })
+            },
+            {
+                "gc_stats",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 0) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=0";
+                                return new Error(out.str());
+                            }
+
+                            allocator::Account* account = allocator::active();
+                            if (account == nullptr) {
+                                return NULL_T.get();
+                            }
+
+                            return newStatsHash(*account);
+                        })
+            },
+            {
+                "heap_snapshot",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            if (args[0]->Type() != STRING_OBJ) {
+                                return new Error("argument to `heap_snapshot` must be STRING, got " + args[0]->Type());
+                            }
+
+                            Environment* session = activeSession();
+                            if (session == nullptr) {
+                                return new Error("heap_snapshot called outside of a session");
+                            }
+
+                            std::string path(dynamic_cast<String*>(args[0])->Value);
+                            std::ofstream file(path, std::ios::binary);
+                            if (!file) {
+                                return new Error("could not open " + path + " for writing");
+                            }
+
+                            std::size_t nodes = snapshot::Write(session, file);
+                            if (!file) {
+                                return new Error("could not write snapshot to " + path);
+                            }
+
+                            return new Integer(nodes);
+                        })
+            },
+            {
+                "freeze",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+                            Environment* session = activeSession();
+                            if (session == nullptr) {
+                                return new Error("freeze called outside of a session");
+                            }
+
+                            Object* frozen = nullptr;
+                            std::shared_ptr<FrozenHeap> heap;
+                            if (Error* err = FrozenHeap::Freeze(args[0], frozen, heap)) {
+                                return err;
+                            }
+                            if (heap != nullptr) {
+                                session->HoldFrozen(heap);
+                            }
+                            return frozen;
+                        })
+            },
+            {
+                "is_frozen",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            return args[0]->frozen() ? TRUE.get() : FALSE.get();
+                        })
+            },
+            {
+                "spawn",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.empty()) {
+                                return new Error("wrong number of arguments. got=0, want=1 or more");
+                            }
+
+                            Object* fn = args[0];
+                            if (fn->Type() != FUNCTION_OBJ && fn->Type() != BUILTIN_OBJ) {
+                                return new Error("first argument to `spawn` must be FUNCTION, got " + fn->Type());
+                            }
+                            if (Function* function = dynamic_cast<Function*>(fn)) {
+                                if (function->Parameters.size() != args.size() - 1) {
+                                    std::stringstream out;
+                                    out << "wrong number of arguments to spawned function. got=" << args.size() - 1 <<
+                                        ", want=" << function->Parameters.size();
+                                    return new Error(out.str());
+                                }
+                            }
+
+                            return spawnTask(fn, std::vector<Object*>(args.begin() + 1, args.end()));
+                        })
+            },
+            {
+                "chan",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() > 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=0 or 1";
+                                return new Error(out.str());
+                            }
+
+                            int64_t capacity = 0;
+                            if (args.size() == 1) {
+                                if (args[0]->Type() != INTEGER_OBJ) {
+                                    return new Error("argument to `chan` must be INTEGER, got " + args[0]->Type());
+                                }
+                                capacity = dynamic_cast<Integer*>(args[0])->Value;
+                                if (capacity < 0) {
+                                    return new Error("capacity of `chan` must not be negative");
+                                }
+                            }
+
+                            return new Channel(capacity);
+                        })
+            },
+            {
+                "send",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
+
+                            Channel* ch = dynamic_cast<Channel*>(args[0]);
+                            if (ch == nullptr) {
+                                return new Error("first argument to `send` must be CHANNEL, got " + args[0]->Type());
+                            }
+
+                            // the copy belongs to no session until it is received
+                            Transfer transfer;
+                            Object* copy = nullptr;
+                            {
+                                allocator::Scope transit(nullptr);
+                                if (Error* err = transfer.Copy(args[1], copy)) {
+                                    return err;
+                                }
+                            }
+
+                            switch (ch->Core->send(Message(copy, transfer.release(), transfer.releaseFrozen()))) {
+                                case scheduler::Channel<Message>::Status::Closed :
+                                    return new Error("send on a closed channel");
+                                case scheduler::Channel<Message>::Status::Stalled :
+                                    return new Error("`send` would wait forever, every task is blocked");
+                                default :
+                                    return NULL_T.get();
+                            }
+                        })
+            },
+            {
+                "recv",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            Channel* ch = dynamic_cast<Channel*>(args[0]);
+                            if (ch == nullptr) {
+                                return new Error("argument to `recv` must be CHANNEL, got " + args[0]->Type());
+                            }
+                            Environment* session = activeSession();
+                            if (session == nullptr) {
+                                return new Error("recv called outside of a session");
+                            }
+
+                            Message message;
+                            switch (ch->Core->recv(message)) {
+                                case scheduler::Channel<Message>::Status::Closed :
+                                    return NULL_T.get();
+                                case scheduler::Channel<Message>::Status::Stalled :
+                                    return new Error("`recv` would wait forever, every task is blocked");
+                                default :
+                                    return message.adopt(session);
+                            }
+                        })
+            },
+            {
+                "close",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            Channel* ch = dynamic_cast<Channel*>(args[0]);
+                            if (ch == nullptr) {
+                                return new Error("argument to `close` must be CHANNEL, got " + args[0]->Type());
+                            }
+                            if (!ch->Core->close()) {
+                                return new Error("channel is already closed");
+                            }
+
+                            return NULL_T.get();
+                        })
+            },
+            {
+                "read_file_async",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+                            if (args[0]->Type() != STRING_OBJ) {
+                                return new Error("argument to `read_file_async` must be STRING, got " + args[0]->Type());
+                            }
+
+                            return new Promise(aio::ReadFile(std::string(dynamic_cast<String*>(args[0])->Value)));
+                        })
+            },
+            {
+                "write_async",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 2) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=2";
+                                return new Error(out.str());
+                            }
+                            if (args[1]->Type() != STRING_OBJ) {
+                                return new Error("second argument to `write_async` must be STRING, got " + args[1]->Type());
+                            }
+                            std::string text(dynamic_cast<String*>(args[1])->Value);
+
+                            // a path names a file to replace, an integer an open descriptor
+                            if (String* path = dynamic_cast<String*>(args[0])) {
+                                return new Promise(aio::WriteFile(std::string(path->Value), std::move(text)));
+                            }
+                            if (Integer* fd = dynamic_cast<Integer*>(args[0])) {
+                                if (fd->Value < 0 || fd->Value > INT32_MAX) {
+                                    return new Error("descriptor passed to `write_async` is out of range");
+                                }
+                                return new Promise(aio::Write(int(fd->Value), std::move(text)));
+                            }
+                            return new Error("first argument to `write_async` must be STRING or INTEGER, got " + args[0]->Type());
+                        })
+            },
+            {
+                "await",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                            if (args.size() != 1) {
+                                std::stringstream out;
+                                out << "wrong number of arguments. got=" << args.size() << ", want=1";
+                                return new Error(out.str());
+                            }
+
+                            Promise* promise = dynamic_cast<Promise*>(args[0]);
+                            if (promise == nullptr) {
+                                return new Error("argument to `await` must be PROMISE, got " + args[0]->Type());
+                            }
+
+                            // a task gives its worker to others meanwhile
+                            aio::Operation& op = *promise->Op;
+                            op.wait();
+                            if (!op.Failure().empty()) {
+                                return new Error(op.Failure());
+                            }
+                            if (op.GetKind() == aio::Operation::Kind::Read) {
+                                return new String(op.Data());
+                            }
+                            return new Integer(op.Bytes());
+                        })
+            },
+            // REPL
+            {
+                "puts",
+                new Builtin([](std::vector<Object*> &args)->Object* {
+                    // no flush, so a script's output goes out in blocks; the
+                    // REPL's input is tied to std::cout and flushes it
+                    Environment* session = activeSession();
+                    std::ostream& out = session != nullptr && session->out != nullptr ? *session->out : std::cout;
+                    for (Object* arg : args) {
+                        out << arg->Inspect() << '\n';
+                    }
+
+                    return NULL_T.get();
+                })
+            }
+    };
+
+    Builtin* lookupBuiltin(symbol::Id name) {
+        // indexed by symbol id, built once the builtins above exist
+        static const std::vector<Builtin*> byId = []() {
+            std::vector<Builtin*> table;
+            for (const auto& entry : builtins) {
+                symbol::Id id = symbol::Intern(entry.first);
+                if (id >= table.size()) {
+                    table.resize(id + 1, nullptr);
+                }
+                table[id] = entry.second;
+            }
+            return table;
+        }();
+
+        return name < byId.size() ? byId[name] : nullptr;
+    }
 };
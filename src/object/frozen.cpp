@@ -0,0 +1,184 @@
+#include "../../include/frozen.h"
+
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace object {
+    // heaps by id, 0 marks an object that is not frozen; never destroyed,
+    // heaps may outlive static destruction
+    struct Registry {
+        std::mutex lock;
+        std::vector<std::weak_ptr<FrozenHeap>> heaps{1};
+        std::vector<std::uint32_t> freeIds;
+
+        static Registry& get() {
+            static Registry* registry = new Registry();
+            return *registry;
+        }
+    };
+
+    FrozenHeap::FrozenHeap() : id(0) {}
+
+    FrozenHeap::~FrozenHeap() {
+        // id is 0 when freezing failed before the heap was registered
+        if (id != 0) {
+            Registry& registry = Registry::get();
+            std::lock_guard<std::mutex> guard(registry.lock);
+            registry.heaps[id].reset();
+            registry.freeIds.push_back(id);
+        }
+        for (auto it = objects.rbegin(); it != objects.rend(); ++it) {
+            delete *it;
+        }
+    }
+
+    std::shared_ptr<FrozenHeap> FrozenHeap::Of(const Object* obj) {
+        Registry& registry = Registry::get();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        return registry.heaps[obj->region].lock();
+    }
+
+    // copies a graph into a new heap, sharing what is frozen already
+    class Freezer {
+    public:
+        explicit Freezer(FrozenHeap& heap) : heap(heap) {}
+
+        Object* freeze(Object* value) {
+            if (value->immortal) {
+                if (value->frozen() && heldIds.insert(value->region).second) {
+                    heap.held.push_back(FrozenHeap::Of(value));
+                }
+                return value;
+            }
+
+            auto seen = copies.find(value);
+            if (seen != copies.end()) {
+                if (seen->second == nullptr) {
+                    failure = "cannot freeze " + value->Type() + " that holds itself";
+                }
+                return seen->second;
+            }
+
+            const ObjectType type = value->Type();
+            if (type == INTEGER_OBJ) {
+                return finish(value, new Integer(dynamic_cast<Integer*>(value)->Value));
+            } else if (type == STRING_OBJ) {
+                return finish(value, new String(*dynamic_cast<String*>(value)));
+            } else if (type == BOOLEAN) {
+                return finish(value, new Boolean(dynamic_cast<Boolean*>(value)->Value));
+            } else if (type == NULL_OBJ) {
+                return finish(value, new Null());
+            } else if (type == ARRAY_OBJ) {
+                Array* arr = dynamic_cast<Array*>(value);
+                if (arr->packed()) {
+                    return finish(value, new Array(new PackedInts(IntVector(arr->ints(), arr->ints() + arr->size()))));
+                }
+
+                copies[value] = nullptr;
+                std::vector<Object*> elements;
+                elements.reserve(arr->size());
+                for (Object* el : arr->Elements) {
+                    Object* copy = freeze(el);
+                    if (copy == nullptr) {
+                        return nullptr;
+                    }
+                    elements.push_back(copy);
+                }
+                return finish(value, new Array(elements));
+            } else if (type == HASH_OBJ) {
+                Hash* hash = dynamic_cast<Hash*>(value);
+                copies[value] = nullptr;
+                std::vector<std::pair<HashKey, HashPair>> pairs;
+                bool failed = false;
+                hash->forEach([&](const HashKey& key, const HashPair& pair) {
+                    if (failed) return;
+                    Object* keyCopy = freeze(pair.Key);
+                    Object* valueCopy = keyCopy != nullptr ? freeze(pair.Value) : nullptr;
+                    if (valueCopy == nullptr) {
+                        failed = true;
+                        return;
+                    }
+                    pairs.push_back({key, HashPair{keyCopy, valueCopy}});
+                });
+                if (failed) {
+                    return nullptr;
+                }
+
+                // built by pushing, so the copy never takes the Trie layout,
+                // whose nodes later copies would share
+                // a shaped hash's keys are already in a shape, so it keeps it
+                Hash* copy = new Hash({});
+                for (const auto& pair : pairs) {
+                    if (hash->shape != nullptr) {
+                        copy->pushLiteral(pair.first, pair.second);
+                    } else {
+                        copy->push(pair.first, pair.second);
+                    }
+                }
+                return finish(value, copy);
+            }
+
+            failure = "cannot freeze " + type;
+            return nullptr;
+        }
+
+        const std::string& Failure() const { return failure; }
+
+    private:
+        FrozenHeap& heap;
+        // nullptr while the copy of a container is still being made
+        std::map<Object*, Object*> copies;
+        std::set<std::uint32_t> heldIds;
+        std::string failure;
+
+        // every copy comes after the ones it holds, so the heap frees
+        // containers before what they hold
+        Object* finish(Object* value, Object* copy) {
+            heap.objects.push_back(copy);
+            copies[value] = copy;
+            return copy;
+        }
+    };
+
+    Error* FrozenHeap::Freeze(Object* value, Object*& frozen, std::shared_ptr<FrozenHeap>& heap) {
+        heap.reset();
+        if (value->immortal) {
+            frozen = value;
+            return nullptr;
+        }
+
+        // the heap outlives the session freezing it, so no session pays for it
+        std::shared_ptr<FrozenHeap> made(new FrozenHeap());
+        std::string failure;
+        {
+            allocator::Scope shared(nullptr);
+            Freezer freezer(*made);
+            frozen = freezer.freeze(value);
+            failure = freezer.Failure();
+        }
+        if (frozen == nullptr) {
+            return new Error(failure);
+        }
+
+        {
+            Registry& registry = Registry::get();
+            std::lock_guard<std::mutex> guard(registry.lock);
+            if (!registry.freeIds.empty()) {
+                made->id = registry.freeIds.back();
+                registry.freeIds.pop_back();
+                registry.heaps[made->id] = made;
+            } else {
+                made->id = registry.heaps.size();
+                registry.heaps.push_back(made);
+            }
+        }
+        for (Object* obj : made->objects) {
+            obj->makeImmortal();
+            obj->region = made->id;
+        }
+
+        heap = std::move(made);
+        return nullptr;
+    }
+}
@@ -0,0 +1,444 @@
+#include "../../include/object.h"
+
+#include <mutex>
+
+namespace object {
+    // guards the shape registry and the making of transitions
+    static std::mutex& shapeLock() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    int Shape::slotOf(const HashKey& key) const {
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    const Shape* Shape::cached(const HashKey& key) const {
+        for (const Transition* t = transitions.load(std::memory_order_acquire); t != nullptr; t = t->next) {
+            if (t->key == key) {
+                return t->to;
+            }
+        }
+        return nullptr;
+    }
+
+    const Shape* Shape::with(const HashKey& key) const {
+        const Shape* shape = cached(key);
+        if (shape != nullptr || keys.size() >= MAX_KEYS) {
+            return shape;
+        }
+
+        std::lock_guard<std::mutex> guard(shapeLock());
+        // another thread may have made it while this one waited
+        shape = cached(key);
+        if (shape != nullptr) {
+            return shape;
+        }
+
+        std::vector<HashKey> next(keys);
+        next.push_back(key);
+
+        shape = intern(std::move(next));
+        transitions.store(new Transition{key, shape, transitions.load(std::memory_order_relaxed)},
+                          std::memory_order_release);
+        return shape;
+    }
+
+    const Shape* Shape::empty() {
+        static const Shape* shape = [] {
+            std::lock_guard<std::mutex> guard(shapeLock());
+            return intern({});
+        }();
+        return shape;
+    }
+
+    // called with shapeLock held; keys reached through different
+    // transitions still end up with one shape
+    const Shape* Shape::intern(std::vector<HashKey> keys) {
+        static std::map<std::vector<HashKey>, const Shape*> registry;
+        static uint32_t nextId = 1;
+
+        auto it = registry.find(keys);
+        if (it != registry.end()) {
+            return it->second;
+        }
+
+        const Shape* shape = new Shape(nextId++, keys);
+        registry.emplace(std::move(keys), shape);
+        return shape;
+    }
+
+    static void replace(HashPair& slot, const HashPair& pair) {
+        slot.Key->decRefCount();
+        slot.Value->decRefCount();
+        slot = pair;
+    }
+
+    // Table index slots hold a position in entries or one of these
+    static const int32_t EMPTY   = -1;
+    static const int32_t REMOVED = -2;
+
+    static std::size_t indexSlot(const HashKey& key, std::size_t mask) {
+        uint64_t hash = key.Value * 0x9E3779B97F4A7C15;
+        return (hash ^ (hash >> 32)) & mask;
+    }
+
+    Hash::Hash(const Hash& other) : layout(other.layout), shape(other.shape) {
+        if (layout != Layout::Trie && other.size() >= SHARE_MIN) {
+            if (other.frozen()) {
+                layout = Layout::Trie;
+                shape = nullptr;
+                other.forEach([this](const HashKey& key, const HashPair& pair) {
+                    Pairs.set(key, pair);
+                });
+                return;
+            }
+            // the original stays on the Trie, so the next copy of it shares too
+            const_cast<Hash&>(other).toTrie();
+            layout = Layout::Trie;
+            shape = nullptr;
+        }
+
+        if (layout == Layout::Trie) {
+            HashTrie shared(other.Pairs);
+            Pairs.swap(shared);
+            return;
+        }
+        slots = other.slots;
+        entries = other.entries;
+        index = other.index;
+        count = other.count;
+        retainLocal();
+    }
+
+    std::size_t Hash::size() const {
+        switch (layout) {
+            case Layout::Shaped : return slots.size();
+            case Layout::Dense  :
+            case Layout::Table  : return count;
+            case Layout::Trie   : return Pairs.size();
+        }
+        return 0;
+    }
+
+    int Hash::locate(const HashKey& key) const {
+        if (index.empty()) {
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                if (entries[i].second.Key != nullptr && entries[i].first == key) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        std::size_t mask = index.size() - 1;
+        for (std::size_t i = indexSlot(key, mask); index[i] != EMPTY; i = (i + 1) & mask) {
+            if (index[i] != REMOVED && entries[index[i]].first == key) {
+                return index[i];
+            }
+        }
+        return -1;
+    }
+
+    const HashPair* Hash::find(const HashKey& key) const {
+        switch (layout) {
+            case Layout::Shaped :
+                {
+                    int slot = shape->slotOf(key);
+                    return slot < 0 ? nullptr : &slots[slot];
+                }
+            case Layout::Dense :
+                if (key.Type != INTEGER_OBJ || key.Value >= slots.size() || slots[key.Value].Key == nullptr) {
+                    return nullptr;
+                }
+                return &slots[key.Value];
+            case Layout::Table :
+                {
+                    int i = locate(key);
+                    return i < 0 ? nullptr : &entries[i].second;
+                }
+            case Layout::Trie :
+                {
+                    auto it = Pairs.find(key);
+                    return it == Pairs.end() ? nullptr : &it->second;
+                }
+        }
+        return nullptr;
+    }
+
+    void Hash::forEach(const std::function<void(const HashKey&, const HashPair&)>& visit) const {
+        switch (layout) {
+            case Layout::Shaped :
+                for (std::size_t i = 0; i < slots.size(); ++i) {
+                    visit(shape->keys[i], slots[i]);
+                }
+                break;
+            case Layout::Dense :
+                for (std::size_t i = 0; i < slots.size(); ++i) {
+                    if (slots[i].Key != nullptr) {
+                        visit(HashKey(INTEGER_OBJ, i), slots[i]);
+                    }
+                }
+                break;
+            case Layout::Table :
+                for (const HashEntry& entry : entries) {
+                    if (entry.second.Key != nullptr) {
+                        visit(entry.first, entry.second);
+                    }
+                }
+                break;
+            case Layout::Trie :
+                for (const HashEntry& entry : Pairs) {
+                    visit(entry.first, entry.second);
+                }
+                break;
+        }
+    }
+
+    void Hash::push(HashKey hashKey, HashPair hashPair) {
+        hashPair.Key->incrRefCount();
+        hashPair.Value->incrRefCount();
+
+        if (!store(hashKey, hashPair, false)) {
+            relayout(hashKey);
+            store(hashKey, hashPair, false);
+        }
+    }
+
+    void Hash::pushLiteral(HashKey hashKey, HashPair hashPair) {
+        hashPair.Key->incrRefCount();
+        hashPair.Value->incrRefCount();
+
+        if (!store(hashKey, hashPair, true)) {
+            relayout(hashKey);
+            store(hashKey, hashPair, true);
+        }
+    }
+
+    void Hash::pop(HashKey key) {
+        switch (layout) {
+            case Layout::Shaped :
+                // a shape with the key taken out could come from any data, so
+                // the hash leaves its shape for a Table, as key is a string
+                if (shape->slotOf(key) < 0) return;
+                relayout(key);
+                pop(key);
+                break;
+            case Layout::Dense :
+                if (find(key) != nullptr) {
+                    slots[key.Value].Key->decRefCount();
+                    slots[key.Value].Value->decRefCount();
+                    slots[key.Value] = HashPair{nullptr, nullptr};
+                    count--;
+                }
+                break;
+            case Layout::Table :
+                {
+                    int i = locate(key);
+                    if (i < 0) return;
+                    entries[i].second.Key->decRefCount();
+                    entries[i].second.Value->decRefCount();
+                    entries[i].second = HashPair{nullptr, nullptr};
+                    count--;
+
+                    if (!index.empty()) {
+                        std::size_t mask = index.size() - 1;
+                        std::size_t slot = indexSlot(key, mask);
+                        while (index[slot] != i) slot = (slot + 1) & mask;
+                        index[slot] = REMOVED;
+                    }
+                    // holes are dropped once they make up half of the entries
+                    if (count * 2 < entries.size()) {
+                        reindex();
+                    }
+                }
+                break;
+            case Layout::Trie :
+                Pairs.erase(key);
+                break;
+        }
+    }
+
+    // stores pair, which already carries its references, if the current
+    // layout has room for key
+    bool Hash::store(const HashKey& key, const HashPair& pair, bool literal) {
+        switch (layout) {
+            case Layout::Shaped :
+                {
+                    if (key.Type != STRING_OBJ) return false;
+
+                    int slot = shape->slotOf(key);
+                    if (slot >= 0) {
+                        replace(slots[slot], pair);
+                        return true;
+                    }
+                    if (!literal) return false;
+
+                    const Shape* next = shape->with(key);
+                    if (next == nullptr) return false;
+                    shape = next;
+                    slots.push_back(pair);
+                    return true;
+                }
+            case Layout::Dense :
+                if (key.Type != INTEGER_OBJ) return false;
+
+                if (key.Value < slots.size() && slots[key.Value].Key != nullptr) {
+                    replace(slots[key.Value], pair);
+                    return true;
+                }
+                // a new key below the highest one would iterate out of insertion order
+                if (key.Value < slots.size() || key.Value >= 2 * count + SMALL_MAX) return false;
+                slots.resize(key.Value + 1, HashPair{nullptr, nullptr});
+                slots[key.Value] = pair;
+                count++;
+                return true;
+            case Layout::Table :
+                {
+                    int i = locate(key);
+                    if (i >= 0) {
+                        replace(entries[i].second, pair);
+                        return true;
+                    }
+
+                    entries.push_back({key, pair});
+                    count++;
+                    // rebuilt past SMALL_MAX entries and whenever it is two thirds full
+                    if (entries.size() > SMALL_MAX && (index.empty() || entries.size() * 3 > index.size() * 2)) {
+                        reindex();
+                    } else if (!index.empty()) {
+                        std::size_t mask = index.size() - 1;
+                        std::size_t slot = indexSlot(key, mask);
+                        while (index[slot] >= 0) slot = (slot + 1) & mask;
+                        index[slot] = entries.size() - 1;
+                    }
+                    return true;
+                }
+            case Layout::Trie :
+                Pairs.set(key, pair);
+                pair.Key->decRefCount();
+                pair.Value->decRefCount();
+                return true;
+        }
+        return false;
+    }
+
+    // moves every pair over to the layout that fits them and key, which the
+    // current layout had no room for
+    void Hash::relayout(const HashKey& key) {
+        std::vector<HashEntry> all;
+        forEach([&all](const HashKey& k, const HashPair& pair) {
+            all.push_back({k, pair});
+        });
+
+        // Dense only while the keys came in ascending order
+        bool dense = key.Type == INTEGER_OBJ;
+        for (std::size_t i = 0; dense && i < all.size(); ++i) {
+            uint64_t next = i + 1 < all.size() ? all[i + 1].first.Value : key.Value;
+            dense = all[i].first.Type == INTEGER_OBJ && all[i].first.Value < next;
+        }
+        dense = dense && key.Value < 2 * all.size() + SMALL_MAX;
+
+        // the new layout takes its own references before the old one drops its
+        for (const HashEntry& entry : all) {
+            entry.second.Key->incrRefCount();
+            entry.second.Value->incrRefCount();
+        }
+        reset();
+
+        if (dense) {
+            layout = Layout::Dense;
+            // every key so far is below key, which store() appends
+            slots.assign(key.Value, HashPair{nullptr, nullptr});
+            for (const HashEntry& entry : all) {
+                slots[entry.first.Value] = entry.second;
+            }
+            count = all.size();
+        } else {
+            layout = Layout::Table;
+            entries.reserve(std::max<std::size_t>(all.size() + 1, SMALL_MAX));
+            for (const HashEntry& entry : all) {
+                entries.push_back({entry.first, entry.second});
+            }
+            count = all.size();
+            if (entries.size() > SMALL_MAX) {
+                reindex();
+            }
+        }
+    }
+
+    void Hash::toTrie() {
+        HashTrie trie;
+        forEach([&trie](const HashKey& key, const HashPair& pair) {
+            trie.set(key, pair);
+        });
+        reset();
+        layout = Layout::Trie;
+        Pairs.swap(trie);
+    }
+
+    void Hash::reindex() {
+        std::size_t live = 0;
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].second.Key != nullptr) {
+                entries[live++] = entries[i];
+            }
+        }
+        entries.erase(entries.begin() + live, entries.end());
+
+        index.clear();
+        if (live <= SMALL_MAX) {
+            return;
+        }
+
+        // a power of two at least twice the entries, so it stays under two thirds full until the next rebuild
+        std::size_t size = SMALL_MAX * 2;
+        while (size < live * 2) size *= 2;
+        index.assign(size, EMPTY);
+
+        std::size_t mask = size - 1;
+        for (std::size_t i = 0; i < live; ++i) {
+            std::size_t slot = indexSlot(entries[i].first, mask);
+            while (index[slot] != EMPTY) slot = (slot + 1) & mask;
+            index[slot] = i;
+        }
+    }
+
+    void Hash::retainLocal() {
+        for (const HashPair& pair : slots) {
+            if (pair.Key == nullptr) continue;
+            pair.Key->incrRefCount();
+            pair.Value->incrRefCount();
+        }
+        for (const HashEntry& entry : entries) {
+            if (entry.second.Key == nullptr) continue;
+            entry.second.Key->incrRefCount();
+            entry.second.Value->incrRefCount();
+        }
+    }
+
+    void Hash::reset() {
+        for (const HashPair& pair : slots) {
+            if (pair.Key == nullptr) continue;
+            pair.Key->decRefCount();
+            pair.Value->decRefCount();
+        }
+        for (const HashEntry& entry : entries) {
+            if (entry.second.Key == nullptr) continue;
+            entry.second.Key->decRefCount();
+            entry.second.Value->decRefCount();
+        }
+
+        slots.clear();
+        entries.clear();
+        index.clear();
+        Pairs.clear();
+        shape = nullptr;
+        count = 0;
+    }
+}
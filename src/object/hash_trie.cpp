@@ -0,0 +1,318 @@
+#include "../../include/object.h"
+
+namespace object {
+    void HashTrie::const_iterator::settle() {
+        while (!stack.empty()) {
+            Frame& top = stack.back();
+            if (top.pos < top.node->entries.size()) {
+                // an erased key leaves a hole in the log
+                if (top.node->entries[top.pos].second.Key != nullptr) {
+                    return;
+                }
+                top.pos++;
+                continue;
+            }
+
+            std::size_t child = top.pos - top.node->entries.size();
+            if (child < top.node->children.size()) {
+                top.pos++;
+                const HashNode* next = top.node->children[child];
+                stack.push_back({next, 0});
+            } else {
+                stack.pop_back();
+            }
+        }
+    }
+
+    HashTrie::HashTrie(const std::map<HashKey, HashPair>& pairs) {
+        // every node is uniquely owned while building, so each set is done in place
+        for (const auto& pair : pairs) {
+            set(pair.first, pair.second);
+        }
+    }
+
+    // integer keys are their own hash, so dense keys spread evenly over the
+    // first levels; the type only tells keys apart in the deepest ones
+    uint64_t HashTrie::hashOf(const HashKey& key) {
+        return key.Value ^ (uint64_t(key.Type.empty() ? 0 : key.Type[0]) << 56);
+    }
+
+    const HashEntry* HashTrie::lookup(const HashKey& key) const {
+        uint64_t hash = hashOf(key);
+
+        const HashNode* node = root;
+        for (unsigned int shift = 0; node != nullptr; shift += HashNode::BITS) {
+            if (shift >= 64) {
+                for (const HashEntry& entry : node->entries) {
+                    if (entry.first == key) {
+                        return &entry;
+                    }
+                }
+                return nullptr;
+            }
+
+            uint32_t bit = 1u << ((hash >> shift) & HashNode::MASK);
+            if (node->dataMap & bit) {
+                const HashEntry& entry = node->entries[slot(node->dataMap, bit)];
+                return entry.first == key ? &entry : nullptr;
+            }
+            if (!(node->nodeMap & bit)) {
+                return nullptr;
+            }
+            node = node->children[slot(node->nodeMap, bit)];
+        }
+
+        return nullptr;
+    }
+
+    HashTrie::const_iterator HashTrie::find(const HashKey& key) const {
+        const HashEntry* indexed = lookup(key);
+        if (indexed == nullptr) {
+            return end();
+        }
+
+        const_iterator it;
+        std::size_t position = indexed->order;
+        const HashNode* node = log;
+        for (unsigned int shift = logShift; shift > 0; shift -= HashNode::LOG_BITS) {
+            // resume after this child once the iterator is done with it
+            std::size_t child = (position >> shift) & HashNode::LOG_MASK;
+            it.stack.push_back({node, child + 1});
+            node = node->children[child];
+        }
+        it.stack.push_back({node, position & HashNode::LOG_MASK});
+        return it;
+    }
+
+    void HashTrie::set(const HashKey& key, const HashPair& pair) {
+        pair.Key->incrRefCount();
+        pair.Value->incrRefCount();
+
+        const HashEntry* indexed = lookup(key);
+        if (indexed != nullptr) {
+            log = replace(log, logShift, indexed->order, pair);
+            return;
+        }
+
+        if (root == nullptr) {
+            root = new HashNode();
+        }
+        root = assoc(root, 0, hashOf(key), HashEntry{key, HashPair{nullptr, nullptr}, logSize});
+
+        // a full log gets another level on top
+        if (log != nullptr && logSize == std::size_t(HashNode::LOG_MASK + 1) << logShift) {
+            HashNode* top = new HashNode();
+            top->children.push_back(log);
+            log = top;
+            logShift += HashNode::LOG_BITS;
+        }
+        log = append(log, logShift, logSize, HashEntry{key, pair, logSize});
+        logSize++;
+        count++;
+    }
+
+    void HashTrie::erase(const HashKey& key) {
+        const HashEntry* indexed = lookup(key);
+        if (indexed == nullptr) {
+            return;
+        }
+
+        std::size_t position = indexed->order;
+        root = dissoc(root, 0, hashOf(key), key);
+        log = replace(log, logShift, position, HashPair{nullptr, nullptr});
+        count--;
+
+        // holes are dropped once they make up half of the log
+        if (count * 2 < logSize) {
+            compact();
+        }
+    }
+
+    void HashTrie::compact() {
+        HashTrie live;
+        for (const HashEntry& entry : *this) {
+            live.set(entry.first, entry.second);
+        }
+        swap(live);
+    }
+
+    HashNode* HashTrie::append(HashNode* node, unsigned int shift, std::size_t position, const HashEntry& entry) {
+        node = node == nullptr ? new HashNode() : unique(node);
+
+        if (shift == 0) {
+            node->entries.push_back(entry);
+            return node;
+        }
+
+        std::size_t child = (position >> shift) & HashNode::LOG_MASK;
+        if (child == node->children.size()) {
+            node->children.push_back(append(nullptr, shift - HashNode::LOG_BITS, position, entry));
+        } else {
+            node->children[child] = append(node->children[child], shift - HashNode::LOG_BITS, position, entry);
+        }
+        return node;
+    }
+
+    HashNode* HashTrie::replace(HashNode* node, unsigned int shift, std::size_t position, const HashPair& pair) {
+        node = unique(node);
+
+        if (shift == 0) {
+            HashPair& existing = node->entries[position & HashNode::LOG_MASK].second;
+            existing.Key->decRefCount();
+            existing.Value->decRefCount();
+            existing = pair;
+            return node;
+        }
+
+        std::size_t child = (position >> shift) & HashNode::LOG_MASK;
+        node->children[child] = replace(node->children[child], shift - HashNode::LOG_BITS, position, pair);
+        return node;
+    }
+
+    // the index entry for a key not there yet, or moved for one that is
+    HashNode* HashTrie::assoc(HashNode* node, unsigned int shift, uint64_t hash, const HashEntry& entry) {
+        node = unique(node);
+
+        if (shift >= 64) {
+            for (HashEntry& existing : node->entries) {
+                if (existing.first == entry.first) {
+                    existing = entry;
+                    return node;
+                }
+            }
+            node->entries.push_back(entry);
+            return node;
+        }
+
+        uint32_t bit = 1u << ((hash >> shift) & HashNode::MASK);
+        if (node->dataMap & bit) {
+            unsigned int i = slot(node->dataMap, bit);
+            HashEntry& existing = node->entries[i];
+            if (existing.first == entry.first) {
+                existing = entry;
+                return node;
+            }
+
+            // two keys share this fragment now, push both a level down
+            HashNode* child = merge(shift + HashNode::BITS, existing, hashOf(existing.first), entry, hash);
+            node->entries.erase(node->entries.begin() + i);
+            node->dataMap &= ~bit;
+            node->children.insert(node->children.begin() + slot(node->nodeMap, bit), child);
+            node->nodeMap |= bit;
+        } else if (node->nodeMap & bit) {
+            unsigned int i = slot(node->nodeMap, bit);
+            node->children[i] = assoc(node->children[i], shift + HashNode::BITS, hash, entry);
+        } else {
+            node->entries.insert(node->entries.begin() + slot(node->dataMap, bit), entry);
+            node->dataMap |= bit;
+        }
+
+        return node;
+    }
+
+    // the caller has checked that key is present; returns nullptr once node is empty
+    HashNode* HashTrie::dissoc(HashNode* node, unsigned int shift, uint64_t hash, const HashKey& key) {
+        node = unique(node);
+
+        if (shift >= 64) {
+            for (auto it = node->entries.begin(); it != node->entries.end(); ++it) {
+                if (it->first == key) {
+                    node->entries.erase(it);
+                    break;
+                }
+            }
+        } else {
+            uint32_t bit = 1u << ((hash >> shift) & HashNode::MASK);
+            if (node->dataMap & bit) {
+                unsigned int i = slot(node->dataMap, bit);
+                node->entries.erase(node->entries.begin() + i);
+                node->dataMap &= ~bit;
+            } else {
+                unsigned int i = slot(node->nodeMap, bit);
+                HashNode* child = dissoc(node->children[i], shift + HashNode::BITS, hash, key);
+
+                if (child == nullptr || (child->children.empty() && child->entries.size() == 1)) {
+                    node->children.erase(node->children.begin() + i);
+                    node->nodeMap &= ~bit;
+                }
+                if (child != nullptr && child->children.empty() && child->entries.size() == 1) {
+                    // a lone entry moves back up, keeping the trie as shallow as its keys allow
+                    HashEntry entry = child->entries[0];
+                    release(child);
+
+                    node->entries.insert(node->entries.begin() + slot(node->dataMap, bit), entry);
+                    node->dataMap |= bit;
+                } else if (child != nullptr) {
+                    node->children[i] = child;
+                }
+            }
+        }
+
+        if (node->entries.empty() && node->children.empty()) {
+            release(node);
+            return nullptr;
+        }
+        return node;
+    }
+
+    HashNode* HashTrie::merge(unsigned int shift, const HashEntry& a, uint64_t hashA, const HashEntry& b, uint64_t hashB) {
+        HashNode* node = new HashNode();
+
+        if (shift >= 64) {
+            node->entries = {a, b};
+            return node;
+        }
+
+        uint32_t bitA = 1u << ((hashA >> shift) & HashNode::MASK);
+        uint32_t bitB = 1u << ((hashB >> shift) & HashNode::MASK);
+        if (bitA == bitB) {
+            node->children.push_back(merge(shift + HashNode::BITS, a, hashA, b, hashB));
+            node->nodeMap = bitA;
+        } else {
+            node->entries = bitA < bitB ? std::vector<HashEntry>{a, b} : std::vector<HashEntry>{b, a};
+            node->dataMap = bitA | bitB;
+        }
+        return node;
+    }
+
+    // node itself if the caller is its only owner, otherwise a private copy
+    // that replaces the caller's reference to it
+    HashNode* HashTrie::unique(HashNode* node) {
+        if (node->owners == 1) {
+            return node;
+        }
+
+        HashNode* copy = new HashNode();
+        copy->dataMap  = node->dataMap;
+        copy->nodeMap  = node->nodeMap;
+        copy->entries  = node->entries;
+        copy->children = node->children;
+        for (const HashEntry& entry : copy->entries) {
+            if (entry.second.Key == nullptr) continue;
+            entry.second.Key->incrRefCount();
+            entry.second.Value->incrRefCount();
+        }
+        for (HashNode* child : copy->children) {
+            retain(child);
+        }
+
+        node->owners--;
+        return copy;
+    }
+
+    void HashTrie::release(HashNode* node) {
+        if (node == nullptr || --node->owners > 0) {
+            return;
+        }
+
+        for (const HashEntry& entry : node->entries) {
+            if (entry.second.Key == nullptr) continue;
+            entry.second.Key->decRefCount();
+            entry.second.Value->decRefCount();
+        }
+        for (HashNode* child : node->children) {
+            release(child);
+        }
+        delete node;
+    }
+}
@@ -1,12 +1,39 @@
 #include "../../include/object.h"
 
 namespace object {
-    std::shared_ptr<Boolean> TRUE  =  std::make_shared<Boolean>(true);
-    std::shared_ptr<Boolean> FALSE =  std::make_shared<Boolean>(false);
-    std::shared_ptr<Null>    NULL_T = std::make_shared<Null>();
+    template <typename T, typename... Args>
+    static std::shared_ptr<T> makeSingleton(Args... args) {
+        std::shared_ptr<T> singleton = std::make_shared<T>(args...);
+        singleton->makeImmortal();
+        return singleton;
+    }
+
+    const std::shared_ptr<Boolean> TRUE   = makeSingleton<Boolean>(true);
+    const std::shared_ptr<Boolean> FALSE  = makeSingleton<Boolean>(false);
+    const std::shared_ptr<Null>    NULL_T = makeSingleton<Null>();
     
-    std::vector<Object*>& getMemhold() {
-        static std::vector<Object*> memhold;
-        return memhold;
+    thread_local Environment* activeRoot = nullptr;
+
+    Environment* activeSession() {
+        return activeRoot;
+    }
+
+    SessionScope::SessionScope(Environment* env)
+        : previous(activeRoot), accounting(env->account)
+    {
+        activeRoot = env->root();
+    }
+
+    SessionScope::~SessionScope() {
+        activeRoot = previous;
+    }
+
+    SessionState saveSession() {
+        return {activeRoot, allocator::active()};
+    }
+
+    void restoreSession(const SessionState& state) {
+        activeRoot = state.root;
+        allocator::setActive(state.account);
     }
 }
@@ -1,10 +1,32 @@
 #include "../../include/object.h"
 
 void TestStringHashKey();
+void TestArrayCopyOnWrite();
+void TestHashCopyOnWrite();
+void TestPersistentVector();
+void TestHashTrie();
+void TestHashShapes();
+void TestHashLayouts();
+void TestStringInterning();
+void TestStringViews();
+void TestPackedArray();
+void TestPackedViews();
+void TestRangeSizes();
 
 /*
 int main() {
     TestStringHashKey();
+    TestArrayCopyOnWrite();
+    TestHashCopyOnWrite();
+    TestPersistentVector();
+    TestHashTrie();
+    TestHashShapes();
+    TestHashLayouts();
+    TestStringInterning();
+    TestStringViews();
+    TestPackedArray();
+    TestPackedViews();
+    TestRangeSizes();
 }
 */
 
@@ -31,3 +53,522 @@ void TestStringHashKey() {
         std::cerr << "strings with the same content have different hash keys" << std::endl;
     }
 }
+
+
+void TestArrayCopyOnWrite() {
+    object::Integer* one = new object::Integer(1);
+    object::Array* original = new object::Array({one, new object::Integer(2)});
+    object::Array* copy = original->clone();
+
+    if (!original->Elements.shared() || copy->Elements[0] != one) {
+        std::cerr << "cloned Array does not share its elements" << std::endl;
+        return;
+    }
+
+    copy->push(new object::Integer(3));
+
+    if (original->Elements.shared() || copy->Elements.shared()) {
+        std::cerr << "Array still shared after push" << std::endl;
+        return;
+    }
+    if (original->Elements.size() != 2 || copy->Elements.size() != 3) {
+        std::cerr << "push on a copy changed the original, got sizes " <<
+            original->Elements.size() << " and " << copy->Elements.size() << std::endl;
+        return;
+    }
+    if (one->refCount != 2) {
+        std::cerr << "shared element refCount not 2 after copy, got=" << one->refCount << std::endl;
+        return;
+    }
+
+    delete copy;
+    if (one->refCount != 1) {
+        std::cerr << "element refCount not 1 after deleting the copy, got=" << one->refCount << std::endl;
+    }
+    delete original;
+}
+
+void TestHashCopyOnWrite() {
+    // sparse integer keys, enough for a copy of the Table to become a Trie
+    std::map<object::HashKey, object::HashPair> pairs;
+    for (int64_t i = 0; i < object::Hash::SHARE_MIN; ++i) {
+        object::Integer* key = new object::Integer(i * 1000);
+        pairs.emplace(key->getHashKey(), object::HashPair{key, new object::Integer(i)});
+    }
+    object::Hash* table = new object::Hash(pairs);
+    object::Hash* original = table->clone();
+    delete table;
+    object::Hash* copy = original->clone();
+    std::size_t size = pairs.size();
+
+    if (!original->Pairs.shared()) {
+        std::cerr << "cloned Hash does not share its pairs" << std::endl;
+        return;
+    }
+
+    // the copy's log grows a level over the leaf it still shares with the original
+    std::string before = original->Inspect();
+    object::Integer* other = new object::Integer(-1);
+    copy->push(other->getHashKey(), {other, new object::Integer(2)});
+
+    if (original->Inspect() != before || original->size() != size || copy->size() != size + 1) {
+        std::cerr << "push on a copied Hash changed the original" << std::endl;
+        return;
+    }
+    if (original->find(other->getHashKey()) != nullptr) {
+        std::cerr << "original Hash sees the copy's key" << std::endl;
+    }
+
+    delete copy;
+    delete original;
+}
+
+void TestPersistentVector() {
+    std::vector<object::Object*> ints;
+    for (int64_t i = 0; i < 2000; ++i) {
+        ints.push_back(new object::Integer(i));
+    }
+
+    object::Array* arr = new object::Array(ints);
+    object::Array* rest = new object::Array(arr->Elements.slice(1, arr->Elements.size()));
+
+    if (!arr->Elements.shared() || rest->Elements.size() != 1999) {
+        std::cerr << "slice does not share the original's nodes" << std::endl;
+        return;
+    }
+
+    for (unsigned int i = 0; i < rest->Elements.size(); ++i) {
+        object::Integer* el = dynamic_cast<object::Integer*>(rest->Elements[i]);
+        if (el == nullptr || el->Value != i + 1) {
+            std::cerr << "rest->Elements[" << i << "] wrong after slice" << std::endl;
+            return;
+        }
+    }
+
+    // popping the original past the tail must not disturb the slice
+    for (int i = 0; i < 1500; ++i) {
+        arr->pop();
+    }
+    rest->push(new object::Integer(2000));
+
+    if (arr->Elements.size() != 500 || rest->Elements.size() != 2000) {
+        std::cerr << "sizes wrong after mutating both vectors, got " <<
+            arr->Elements.size() << " and " << rest->Elements.size() << std::endl;
+        return;
+    }
+
+    int64_t expected = 1;
+    for (object::Object* el : rest->Elements) {
+        if (dynamic_cast<object::Integer*>(el)->Value != expected++) {
+            std::cerr << "rest iteration out of order at " << expected - 1 << std::endl;
+            return;
+        }
+    }
+
+    delete rest;
+    delete arr;
+    if (ints[0]->refCount != 0 || ints[1999]->refCount != 0) {
+        std::cerr << "elements still referenced after deleting both arrays" << std::endl;
+    }
+}
+
+void TestHashTrie() {
+    // sparse keys, dense ones would get a Dense hash instead
+    object::Hash* table = new object::Hash({});
+    std::vector<object::Integer*> keys;
+    for (int64_t i = 0; i < 1000; ++i) {
+        keys.push_back(new object::Integer(i * 1000));
+        table->push(keys[i]->getHashKey(), {keys[i], keys[i]});
+    }
+    object::Hash* original = table->clone();
+    delete table;
+
+    object::Hash* copy = original->clone();
+    object::Integer* extra = new object::Integer(1);
+    copy->push(extra->getHashKey(), {extra, extra});
+    copy->pop(keys[0]->getHashKey());
+
+    if (original->Pairs.size() != 1000 || copy->Pairs.size() != 1000) {
+        std::cerr << "sizes wrong after updating the copy, got " <<
+            original->Pairs.size() << " and " << copy->Pairs.size() << std::endl;
+        return;
+    }
+    if (original->Pairs.find(extra->getHashKey()) != original->Pairs.end() ||
+        original->Pairs.find(keys[0]->getHashKey()) == original->Pairs.end()) {
+        std::cerr << "updating the copy changed the original" << std::endl;
+        return;
+    }
+    // the copy still shares the log leaf holding keys[500], so it is
+    // referenced once as a key and once as a value
+    if (keys[500]->refCount != 2) {
+        std::cerr << "shared entry refCount not 2, got=" << keys[500]->refCount << std::endl;
+        return;
+    }
+
+    for (int64_t i = 1; i < 1000; ++i) {
+        auto it = copy->Pairs.find(keys[i]->getHashKey());
+        if (it == copy->Pairs.end() || it->second.Value != keys[i]) {
+            std::cerr << "copy lost key " << i << std::endl;
+            return;
+        }
+    }
+
+    // keys whose hashes are identical share a collision node
+    object::HashKey same(object::INTEGER_OBJ, 7000);
+    object::HashKey other("INTX", 7000);
+    copy->push(other, {extra, extra});
+    auto it = copy->Pairs.find(same);
+    if (it == copy->Pairs.end() || it->second.Value != keys[7] ||
+        copy->Pairs.find(other)->second.Value != extra) {
+        std::cerr << "colliding keys not told apart" << std::endl;
+        return;
+    }
+
+    // iteration skips the erased keys[0] and follows insertion order
+    std::vector<object::Object*> visited;
+    for (const auto& pair : copy->Pairs) {
+        visited.push_back(pair.second.Key);
+    }
+    if (visited.size() != copy->Pairs.size() || visited[0] != keys[1] ||
+        visited[998] != keys[999] || visited[999] != extra || visited[1000] != extra) {
+        std::cerr << "iteration visited " << visited.size() << " of " << copy->Pairs.size() <<
+            " or out of insertion order" << std::endl;
+        return;
+    }
+
+    // erasing most keys compacts the log, keeping the order of the rest
+    for (int64_t i = 1; i < 900; ++i) {
+        copy->pop(keys[i]->getHashKey());
+    }
+    visited.clear();
+    for (const auto& pair : copy->Pairs) {
+        visited.push_back(pair.second.Key);
+    }
+    if (visited.size() != 102 || visited[0] != keys[900] || visited[101] != extra ||
+        copy->Pairs.find(keys[950]->getHashKey())->second.Value != keys[950]) {
+        std::cerr << "log lost its order when compacted" << std::endl;
+        return;
+    }
+
+    delete copy;
+    delete original;
+    if (keys[1]->refCount != 0 || extra->refCount != 0) {
+        std::cerr << "entries still referenced after deleting both hashes" << std::endl;
+    }
+}
+
+void TestHashShapes() {
+    object::String* name = new object::String("name");
+    object::String* id   = new object::String("id");
+    object::Integer* one = new object::Integer(1);
+
+    object::Hash* first  = new object::Hash({});
+    object::Hash* second = new object::Hash({});
+    object::Hash* third  = new object::Hash({});
+    first->pushLiteral(name->getHashKey(), {name, one});
+    first->pushLiteral(id->getHashKey(), {id, one});
+    second->pushLiteral(name->getHashKey(), {name, one});
+    second->pushLiteral(id->getHashKey(), {id, one});
+    third->pushLiteral(id->getHashKey(), {id, one});
+    third->pushLiteral(name->getHashKey(), {name, one});
+
+    if (first->shape == nullptr || first->shape != second->shape) {
+        std::cerr << "hashes with the same string keys do not share a shape" << std::endl;
+        return;
+    }
+    // slots follow insertion order, so the other order needs its own shape
+    if (third->shape == first->shape || third->slots[0].Key != id) {
+        std::cerr << "keys inserted in another order share a shape" << std::endl;
+        return;
+    }
+    if (first->shape->keys.size() != 2 || first->slots.size() != 2) {
+        std::cerr << "shape does not lay out both keys" << std::endl;
+        return;
+    }
+
+    int slot = first->shape->slotOf(object::String::hashKeyOf("id"));
+    if (slot < 0 || first->slots[slot].Key != id) {
+        std::cerr << "shape slot for \"id\" does not hold its pair" << std::endl;
+        return;
+    }
+
+    // a non-string key leaves the shape behind, keeping every pair
+    object::Hash* copy = first->clone();
+    copy->push(one->getHashKey(), {one, one});
+    if (copy->shape != nullptr || copy->size() != 3 || first->shape != second->shape) {
+        std::cerr << "integer key did not move the copy off its shape" << std::endl;
+        return;
+    }
+    const object::HashPair* pair = copy->find(name->getHashKey());
+    if (pair == nullptr || pair->Value != one) {
+        std::cerr << "pair lost when leaving the shape" << std::endl;
+        return;
+    }
+
+    // keys computed at run time never make a shape, and neither does removing one
+    object::Hash* computed = new object::Hash({});
+    computed->push(name->getHashKey(), {name, one});
+    third->pop(name->getHashKey());
+    if (computed->shape != nullptr || computed->layout != object::Hash::Layout::Table ||
+        third->shape != nullptr || third->size() != 1 || third->find(id->getHashKey()) == nullptr) {
+        std::cerr << "computed key or pop kept a hash Shaped" << std::endl;
+        return;
+    }
+
+    delete computed;
+    delete copy;
+    delete third;
+    delete second;
+    delete first;
+    if (name->refCount != 0 || one->refCount != 0) {
+        std::cerr << "pairs still referenced after deleting the hashes" << std::endl;
+    }
+}
+
+void TestHashLayouts() {
+    typedef object::Hash::Layout Layout;
+    object::Hash* hash = new object::Hash({});
+    std::vector<object::Integer*> ints;
+    for (int64_t i = 0; i < 64; ++i) {
+        ints.push_back(new object::Integer(i));
+    }
+
+    for (int64_t i = 0; i < 64; ++i) {
+        hash->push(ints[i]->getHashKey(), {ints[i], ints[i]});
+    }
+    if (hash->layout != Layout::Dense || hash->size() != 64) {
+        std::cerr << "keys 0 to 63 did not get a Dense hash" << std::endl;
+        return;
+    }
+
+    hash->pop(ints[10]->getHashKey());
+    if (hash->find(ints[10]->getHashKey()) != nullptr || hash->find(ints[11]->getHashKey()) == nullptr) {
+        std::cerr << "pop on a Dense hash removed the wrong key" << std::endl;
+        return;
+    }
+
+    // putting 10 back after 63 has to keep it last
+    hash->push(ints[10]->getHashKey(), {ints[10], ints[10]});
+    if (hash->layout != Layout::Table || hash->size() != 64) {
+        std::cerr << "out of order key did not move the hash to a Table" << std::endl;
+        return;
+    }
+    const object::HashPair* pair = hash->find(ints[63]->getHashKey());
+    if (pair == nullptr || pair->Value != ints[63]) {
+        std::cerr << "pair lost moving from Dense to Table" << std::endl;
+        return;
+    }
+
+    std::vector<int64_t> order;
+    hash->forEach([&order](const object::HashKey& key, const object::HashPair&) {
+        order.push_back(key.Value);
+    });
+    if (order.size() != 64 || order[9] != 9 || order[10] != 11 || order.back() != 10) {
+        std::cerr << "Table does not iterate in insertion order" << std::endl;
+        return;
+    }
+
+    // erasing most keys drops the holes, at most half the entries stay holes
+    for (int64_t i = 0; i < 60; ++i) {
+        hash->pop(ints[i]->getHashKey());
+    }
+    pair = hash->find(ints[62]->getHashKey());
+    if (hash->size() != 4 || hash->entries.size() > 2 * hash->size() || pair == nullptr || pair->Value != ints[62]) {
+        std::cerr << "Table not compacted after erasing, " << hash->entries.size() << " entries" << std::endl;
+        return;
+    }
+    delete hash;
+
+    // mixed keys go to a Table, which keeps its order when copied into a Trie
+    object::Hash* mixed = new object::Hash({});
+    object::String* name = new object::String("name");
+    mixed->push(name->getHashKey(), {name, ints[1]});
+    mixed->push(object::TRUE->getHashKey(), {object::TRUE.get(), ints[2]});
+    if (mixed->layout != Layout::Table || mixed->size() != 2) {
+        std::cerr << "mixed keys did not get a Table" << std::endl;
+        return;
+    }
+    for (int64_t i = mixed->size(); i < object::Hash::SHARE_MIN; ++i) {
+        object::Integer* key = new object::Integer(-i);
+        mixed->push(key->getHashKey(), {key, key});
+    }
+
+    object::Hash* copy = mixed->clone();
+    if (copy->layout != Layout::Trie || copy->Inspect() != mixed->Inspect()) {
+        std::cerr << "copy of a big Table differs, got=" << copy->Inspect() << std::endl;
+        return;
+    }
+    // the original moved to the Trie too, so the copy shares its nodes
+    if (mixed->layout != Layout::Trie || !mixed->Pairs.shared()) {
+        std::cerr << "big Table copied instead of shared" << std::endl;
+        return;
+    }
+    if (mixed->Inspect().rfind("{name: 1, true: 2, -2: -2", 0) != 0) {
+        std::cerr << "Inspect not in insertion order, got=" << mixed->Inspect() << std::endl;
+        return;
+    }
+    delete copy;
+    delete mixed;
+
+    object::Hash* dense = new object::Hash({});
+    for (int64_t i = 0; i < 64; ++i) {
+        dense->push(ints[i]->getHashKey(), {ints[i], ints[i]});
+    }
+    copy = dense->clone();
+    if (dense->layout != Layout::Trie || !copy->Pairs.shared() || copy->Inspect() != dense->Inspect()) {
+        std::cerr << "big Dense hash copied instead of shared" << std::endl;
+        return;
+    }
+    delete copy;
+    delete dense;
+
+    if (ints[1]->refCount != 0 || ints[62]->refCount != 0 || name->refCount != 0) {
+        std::cerr << "pairs still referenced after deleting the hashes" << std::endl;
+    }
+}
+
+void TestStringInterning() {
+    symbol::Id id = symbol::Intern("interned name");
+    if (id == symbol::NONE || symbol::Intern(std::string("interned ") + "name") != id) {
+        std::cerr << "the same name was not interned to the same id" << std::endl;
+        return;
+    }
+    if (symbol::Name(id) != "interned name" || symbol::Find("never interned") != symbol::NONE) {
+        std::cerr << "symbol table lookups are wrong" << std::endl;
+        return;
+    }
+
+    object::String* a = (new object::String("interned name"))->intern();
+    object::String* b = (new object::String("interned name"))->intern();
+    object::String* plain = new object::String("interned name");
+    if (a->Symbol != id || b->Symbol != id || !a->equals(*b) || !a->equals(*plain)) {
+        std::cerr << "interned strings with the same text are not equal" << std::endl;
+    }
+    if (a->clone()->Symbol != id) {
+        std::cerr << "cloned String lost its symbol" << std::endl;
+    }
+}
+
+void TestStringViews() {
+    object::String* line = new object::String("2024-01-01 GET /index.html 200");
+    object::String* method = new object::String(*line, 11, 14);
+
+    if (method->Value != "GET" || method->Buffer != line->Buffer) {
+        std::cerr << "slice did not share its parent's buffer, got=" << method->Value << std::endl;
+        return;
+    }
+    if (method->getHashKey() != object::String("GET").getHashKey()) {
+        std::cerr << "slice hashes differently from a String with the same text" << std::endl;
+    }
+
+    if (!method->pinsBuffer() || !method->compact()) {
+        std::cerr << "small slice was not compacted" << std::endl;
+        return;
+    }
+    if (method->Value != "GET" || method->Buffer == line->Buffer || method->Buffer->size() != 3) {
+        std::cerr << "compacted slice does not own just its text, got=" << method->Value << std::endl;
+    }
+    if (line->compact()) {
+        std::cerr << "a String showing its whole buffer was compacted" << std::endl;
+    }
+}
+
+void TestPackedArray() {
+    object::Array* packed = object::Array::fromElements({new object::Integer(1), new object::Integer(2)});
+    if (!packed->packed() || packed->size() != 2 || !packed->Elements.empty()) {
+        std::cerr << "array of integers was not packed" << std::endl;
+        return;
+    }
+
+    object::Array* copy = packed->clone();
+    copy->push(new object::Integer(3));
+    if (packed->size() != 2 || copy->size() != 3 || packed->Packed == copy->Packed) {
+        std::cerr << "push to a shared packed array was seen by its original" << std::endl;
+        return;
+    }
+
+    copy->push(new object::String("x"));
+    if (copy->packed() || copy->size() != 4 || copy->Inspect() != "[1, 2, 3, x]") {
+        std::cerr << "push of a STRING did not unpack the array, got=" << copy->Inspect() << std::endl;
+    }
+    if (!packed->packed() || packed->Inspect() != "[1, 2]") {
+        std::cerr << "unpacking a copy changed its original, got=" << packed->Inspect() << std::endl;
+    }
+}
+
+void TestPackedViews() {
+    std::vector<object::Object*> elements;
+    for (int64_t i = 0; i < 8; ++i) {
+        elements.push_back(new object::Integer(i));
+    }
+    object::Array* packed = object::Array::fromElements(elements);
+
+    object::Array* tail = packed->slice(1, 8);
+    object::Array* middle = tail->slice(2, 5);
+    if (tail->Packed != packed->Packed || middle->Packed != packed->Packed || middle->Inspect() != "[3, 4, 5]") {
+        std::cerr << "slice of a packed array did not view its storage, got=" << middle->Inspect() << std::endl;
+        return;
+    }
+
+    // the storage is full, so the first push moves tail to storage with room to spare
+    tail->push(new object::Integer(8));
+    if (tail->Packed == packed->Packed || tail->Packed->values.capacity() < 14 || tail->Inspect() != "[1, 2, 3, 4, 5, 6, 7, 8]") {
+        std::cerr << "push to a full shared packed array did not copy it, got=" << tail->Inspect() << std::endl;
+        return;
+    }
+
+    // the slot after tail's view is free, so a clone of tail takes it in place
+    object::Array* longer = tail->clone();
+    longer->push(new object::Integer(9));
+    if (longer->Packed != tail->Packed || tail->size() != 8 || longer->Inspect() != "[1, 2, 3, 4, 5, 6, 7, 8, 9]") {
+        std::cerr << "push to the end of a shared packed array copied it, got=" << longer->Inspect() << std::endl;
+        return;
+    }
+
+    // ... after which that slot is longer's, and tail has to copy
+    tail->push(new object::Integer(10));
+    if (tail->Packed == longer->Packed || longer->Inspect() != "[1, 2, 3, 4, 5, 6, 7, 8, 9]" ||
+            tail->Inspect() != "[1, 2, 3, 4, 5, 6, 7, 8, 10]") {
+        std::cerr << "push to a shared packed array overwrote another view, got=" << longer->Inspect() << std::endl;
+        return;
+    }
+
+    middle->pop();
+    if (middle->Inspect() != "[3, 4]" || packed->Inspect() != "[0, 1, 2, 3, 4, 5, 6, 7]") {
+        std::cerr << "pop from a packed view changed the array it views, got=" << packed->Inspect() << std::endl;
+    }
+}
+
+void TestRangeSizes() {
+    struct SizeTest {
+        int64_t start, stop, step;
+        std::size_t expected;
+    };
+
+    SizeTest tests[] {
+        {0, 10, 1, 10},
+        {0, 10, 3, 4},
+        {10, 0, -3, 4},
+        {5, 5, 1, 0},
+        {5, 0, 1, 0},
+        {INT64_MIN, INT64_MAX, INT64_MAX, 3},
+    };
+
+    for (SizeTest test : tests) {
+        object::Sequence range(test.start, test.stop, test.step);
+        if (range.sourceSize() != test.expected) {
+            std::cerr << range.Inspect() << " has " << range.sourceSize() <<
+                " elements, want=" << test.expected << std::endl;
+        }
+    }
+
+    object::Sequence range(10, 0, -3);
+    if (range.rangeAt(3) != 1) {
+        std::cerr << "element 3 of " << range.Inspect() << " is " << range.rangeAt(3) << ", want=1" << std::endl;
+    }
+
+    range.Stages.push_back({object::Sequence::StageKind::Take, nullptr, 2});
+    if (!range.plainRange() || range.plainSize() != 2 || range.Inspect() != "range(10, 0, -3) | take(2)") {
+        std::cerr << "take did not cut the range short, got=" << range.Inspect() << std::endl;
+    }
+}
@@ -0,0 +1,250 @@
+#include "../../include/persistent_vector.h"
+#include "../../include/object.h"
+
+#include <utility>
+
+namespace object {
+    PersistentVector::PersistentVector(const std::vector<Object*>& elements) {
+        // every node is uniquely owned while building, so each push is done in place
+        for (Object* el : elements) {
+            push_back(el);
+        }
+    }
+
+    PersistentVector::PersistentVector(const PersistentVector& other)
+        : root(other.root), tail(other.tail), shift(other.shift),
+          physical(other.physical), start(other.start), length(other.length)
+    {
+        retain(root);
+        retain(tail);
+    }
+
+    PersistentVector::~PersistentVector() {
+        release(root);
+        release(tail);
+    }
+
+    bool PersistentVector::shared() const {
+        return (root != nullptr && root->owners > 1) || (tail != nullptr && tail->owners > 1);
+    }
+
+    std::size_t PersistentVector::bytes() const {
+        return (length + VectorNode::WIDTH - 1) / VectorNode::WIDTH * sizeof(VectorNode);
+    }
+
+    Object* const* PersistentVector::leafFor(std::size_t index) const {
+        if (index >= tailOffset()) {
+            return tail->items;
+        }
+
+        VectorNode* node = root;
+        for (unsigned int level = shift; level > 0; level -= VectorNode::BITS) {
+            node = node->children[(index >> level) & VectorNode::MASK];
+        }
+        return node->items;
+    }
+
+    void PersistentVector::push_back(Object* obj) {
+        if (start + length != physical) {
+            materialize();
+        }
+
+        obj->incrRefCount();
+
+        if (tail == nullptr) {
+            tail = new VectorNode(true);
+        } else if (physical - tailOffset() < VectorNode::WIDTH) {
+            tail = unique(tail);
+        } else {
+            // the tail is full, hand it over to the trie and start a new one
+            if (root == nullptr) {
+                root = new VectorNode(false);
+                root->children[0] = tail;
+                root->count = 1;
+                shift = VectorNode::BITS;
+            } else if ((physical >> VectorNode::BITS) > (std::size_t(1) << shift)) {
+                VectorNode* newRoot = new VectorNode(false);
+                newRoot->children[0] = root;
+                newRoot->children[1] = newPath(shift, tail);
+                newRoot->count = 2;
+                root = newRoot;
+                shift += VectorNode::BITS;
+            } else {
+                root = pushTail(shift, root, tail);
+            }
+            tail = new VectorNode(true);
+        }
+
+        tail->items[tail->count++] = obj;
+        physical++;
+        length++;
+    }
+
+    void PersistentVector::pop_back() {
+        if (length == 0) {
+            return;
+        }
+
+        if (start + length != physical) {
+            // a view cut short of its nodes' end just stops seeing the element
+            length--;
+            if (length == 0) clear();
+            return;
+        }
+
+        if (physical - tailOffset() > 1) {
+            tail = unique(tail);
+            tail->items[--tail->count]->decRefCount();
+        } else {
+            release(tail);
+            tail = nullptr;
+
+            if (root != nullptr) {
+                VectorNode* leaf = nullptr;
+                root = popTail(shift, root, leaf);
+                tail = leaf;
+
+                if (root != nullptr && shift > VectorNode::BITS && root->count == 1) {
+                    VectorNode* child = root->children[0];
+                    root->children[0] = nullptr;
+                    root->count = 0;
+                    release(root);
+                    root = child;
+                    shift -= VectorNode::BITS;
+                }
+            }
+        }
+
+        physical--;
+        length--;
+        if (length == 0) {
+            clear();
+        }
+    }
+
+    PersistentVector PersistentVector::slice(std::size_t from, std::size_t to) const {
+        if (to > length) to = length;
+        if (from > to) from = to;
+
+        PersistentVector view(*this);
+        view.start = start + from;
+        view.length = to - from;
+        if (view.length == 0) {
+            view.clear();
+        }
+        return view;
+    }
+
+    void PersistentVector::clear() {
+        release(root);
+        release(tail);
+        root = nullptr;
+        tail = nullptr;
+        shift = VectorNode::BITS;
+        physical = 0;
+        start = 0;
+        length = 0;
+    }
+
+    // rebuilds a view as a vector of its own so it can grow past its end
+    void PersistentVector::materialize() {
+        PersistentVector fresh(std::vector<Object*>(begin(), end()));
+        std::swap(root, fresh.root);
+        std::swap(tail, fresh.tail);
+        std::swap(shift, fresh.shift);
+        std::swap(physical, fresh.physical);
+        std::swap(start, fresh.start);
+        std::swap(length, fresh.length);
+    }
+
+    VectorNode* PersistentVector::pushTail(unsigned int level, VectorNode* parent, VectorNode* leaf) {
+        parent = unique(parent);
+        unsigned int subidx = ((physical - 1) >> level) & VectorNode::MASK;
+
+        if (level == VectorNode::BITS) {
+            parent->children[subidx] = leaf;
+        } else if (subidx < parent->count) {
+            parent->children[subidx] = pushTail(level - VectorNode::BITS, parent->children[subidx], leaf);
+        } else {
+            parent->children[subidx] = newPath(level - VectorNode::BITS, leaf);
+        }
+
+        if (subidx >= parent->count) {
+            parent->count = subidx + 1;
+        }
+        return parent;
+    }
+
+    // detaches the trie's last leaf into leaf, returns nullptr once node is empty
+    VectorNode* PersistentVector::popTail(unsigned int level, VectorNode* node, VectorNode*& leaf) {
+        node = unique(node);
+        unsigned int subidx = ((physical - 2) >> level) & VectorNode::MASK;
+
+        if (level > VectorNode::BITS) {
+            VectorNode* child = popTail(level - VectorNode::BITS, node->children[subidx], leaf);
+            node->children[subidx] = child;
+            if (child == nullptr) {
+                node->count = subidx;
+            }
+        } else {
+            leaf = node->children[subidx];
+            node->children[subidx] = nullptr;
+            node->count = subidx;
+        }
+
+        if (node->count == 0) {
+            release(node);
+            return nullptr;
+        }
+        return node;
+    }
+
+    // node itself if the caller is its only owner, otherwise a private copy
+    // that replaces the caller's reference to it
+    VectorNode* PersistentVector::unique(VectorNode* node) {
+        if (node->owners == 1) {
+            return node;
+        }
+
+        VectorNode* copy = new VectorNode(node->leaf);
+        copy->count = node->count;
+        for (unsigned int i = 0; i < node->count; ++i) {
+            if (node->leaf) {
+                copy->items[i] = node->items[i];
+                copy->items[i]->incrRefCount();
+            } else {
+                copy->children[i] = node->children[i];
+                retain(copy->children[i]);
+            }
+        }
+
+        node->owners--;
+        return copy;
+    }
+
+    VectorNode* PersistentVector::newPath(unsigned int level, VectorNode* leaf) {
+        if (level == 0) {
+            return leaf;
+        }
+
+        VectorNode* node = new VectorNode(false);
+        node->children[0] = newPath(level - VectorNode::BITS, leaf);
+        node->count = 1;
+        return node;
+    }
+
+    void PersistentVector::release(VectorNode* node) {
+        if (node == nullptr || --node->owners > 0) {
+            return;
+        }
+
+        for (unsigned int i = 0; i < node->count; ++i) {
+            if (node->leaf) {
+                node->items[i]->decRefCount();
+            } else {
+                release(node->children[i]);
+            }
+        }
+        delete node;
+    }
+}
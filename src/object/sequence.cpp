@@ -0,0 +1,74 @@
+#include "../../include/object.h"
+
+#include <sstream>
+
+namespace object {
+    Sequence::Sequence(const Sequence& other)
+        : Source(other.Source), Start(other.Start), Stop(other.Stop), Step(other.Step), Stages(other.Stages)
+    {
+        if (Source != nullptr) Source->incrRefCount();
+        for (const Stage& stage : Stages) {
+            if (stage.Fn != nullptr) stage.Fn->incrRefCount();
+        }
+    }
+
+    Sequence::~Sequence() {
+        if (Source != nullptr) Source->decRefCount();
+        for (const Stage& stage : Stages) {
+            if (stage.Fn != nullptr) stage.Fn->decRefCount();
+        }
+    }
+
+    std::size_t Sequence::sourceSize() const {
+        if (Source != nullptr) {
+            return Source->size();
+        }
+
+        // wide enough for any span between two int64_t
+        __int128 span = __int128(Stop) - Start;
+        if (Step > 0 ? span <= 0 : span >= 0) {
+            return 0;
+        }
+        __int128 step = Step;
+        return std::size_t(span > 0 ? (span + step - 1) / step : (span + step + 1) / step);
+    }
+
+    Object* Sequence::sourceAt(std::size_t i) const {
+        if (Source != nullptr) {
+            return Source->at(i);
+        }
+        return new Integer(rangeAt(i));
+    }
+
+    bool Sequence::plainRange() const {
+        return Source == nullptr && std::all_of(Stages.begin(), Stages.end(),
+                [](const Stage& stage) { return stage.Kind == StageKind::Take; });
+    }
+
+    std::size_t Sequence::plainSize() const {
+        std::size_t size = sourceSize();
+        for (const Stage& stage : Stages) {
+            size = std::min(size, std::size_t(stage.Count));
+        }
+        return size;
+    }
+
+    std::string Sequence::Inspect() const {
+        std::stringstream out;
+
+        if (Source != nullptr) {
+            out << Source->Inspect();
+        } else {
+            out << "range(" << Start << ", " << Stop << ", " << Step << ")";
+        }
+        for (const Stage& stage : Stages) {
+            switch (stage.Kind) {
+                case StageKind::Map    : out << " | lmap"; break;
+                case StageKind::Filter : out << " | lfilter"; break;
+                case StageKind::Take   : out << " | take(" << stage.Count << ")"; break;
+            }
+        }
+
+        return out.str();
+    }
+}
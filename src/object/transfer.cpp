@@ -0,0 +1,224 @@
+#include "../../include/transfer.h"
+#include "../../include/frozen.h"
+
+namespace object {
+    // objects listed after the ones they hold are freed first, so each is
+    // still alive when its holders drop their references to it
+    static void freeObjects(std::vector<Object*>& objects) {
+        for (auto it = objects.rbegin(); it != objects.rend(); ++it) {
+            delete *it;
+        }
+        objects.clear();
+    }
+
+    Message& Message::operator=(Message&& other) noexcept {
+        if (this != &other) {
+            release();
+            Value = other.Value;
+            Objects = std::move(other.Objects);
+            Frozen = std::move(other.Frozen);
+            other.Value = nullptr;
+            other.Objects.clear();
+            other.Frozen.clear();
+        }
+        return *this;
+    }
+
+    Object* Message::adopt(Environment* env) {
+        env->heap.insert(env->heap.end(), Objects.begin(), Objects.end());
+        Objects.clear();
+        for (const std::shared_ptr<FrozenHeap>& heap : Frozen) {
+            env->HoldFrozen(heap);
+        }
+        Frozen.clear();
+
+        Object* value = Value;
+        Value = nullptr;
+        return value;
+    }
+
+    void Message::release() {
+        freeObjects(Objects);
+        Frozen.clear();
+        Value = nullptr;
+    }
+
+    Transfer::~Transfer() {
+        // scopes drop their references to the copies they bind
+        for (Environment* scope : scopes) {
+            delete scope;
+        }
+        freeObjects(made);
+    }
+
+    Error* Transfer::Copy(Object* value, Object*& copy) {
+        copy = copyValue(value);
+        if (copy == nullptr) {
+            return new Error(failure);
+        }
+        return nullptr;
+    }
+
+    std::vector<Object*> Transfer::release() {
+        std::vector<Object*> objects = std::move(made);
+        made.clear();
+        return objects;
+    }
+
+    std::vector<std::shared_ptr<FrozenHeap>> Transfer::releaseFrozen() {
+        std::vector<std::shared_ptr<FrozenHeap>> heaps = std::move(frozen);
+        frozen.clear();
+        return heaps;
+    }
+
+    std::vector<Environment*> Transfer::releaseScopes() {
+        std::vector<Environment*> released = std::move(scopes);
+        scopes.clear();
+        return released;
+    }
+
+    Object* Transfer::finish(Object* value, Object* copy) {
+        made.push_back(copy);
+        copies[value] = copy;
+        return copy;
+    }
+
+    Object* Transfer::copyValue(Object* value) {
+        if (value->immortal) {
+            // frozen values are shared as they are, with their heap
+            if (value->frozen() && frozenIds.insert(value->region).second) {
+                std::shared_ptr<FrozenHeap> heap = FrozenHeap::Of(value);
+                if (target != nullptr) {
+                    target->HoldFrozen(heap);
+                } else {
+                    frozen.push_back(heap);
+                }
+            }
+            return value;
+        }
+
+        auto seen = copies.find(value);
+        if (seen != copies.end()) {
+            if (seen->second == nullptr) {
+                failure = "cannot copy " + value->Type() + " that holds itself to another isolate";
+            }
+            return seen->second;
+        }
+
+        const ObjectType type = value->Type();
+        if (type == INTEGER_OBJ) {
+            return finish(value, new Integer(dynamic_cast<Integer*>(value)->Value));
+        } else if (type == STRING_OBJ) {
+            return finish(value, new String(*dynamic_cast<String*>(value)));
+        } else if (type == BOOLEAN) {
+            return finish(value, new Boolean(dynamic_cast<Boolean*>(value)->Value));
+        } else if (type == NULL_OBJ) {
+            return finish(value, new Null());
+        } else if (type == ERROR_OBJ) {
+            return finish(value, new Error(dynamic_cast<Error*>(value)->Message));
+        } else if (type == CHANNEL_OBJ) {
+            return finish(value, new Channel(*dynamic_cast<Channel*>(value)));
+        } else if (type == PROMISE_OBJ) {
+            return finish(value, new Promise(*dynamic_cast<Promise*>(value)));
+        } else if (type == ARRAY_OBJ) {
+            Array* arr = dynamic_cast<Array*>(value);
+            if (arr->packed()) {
+                return finish(value, new Array(new PackedInts(IntVector(arr->ints(), arr->ints() + arr->size()))));
+            }
+
+            copies[value] = nullptr;
+            std::vector<Object*> elements;
+            elements.reserve(arr->size());
+            for (Object* el : arr->Elements) {
+                Object* copy = copyValue(el);
+                if (copy == nullptr) {
+                    return nullptr;
+                }
+                elements.push_back(copy);
+            }
+            return finish(value, new Array(elements));
+        } else if (type == HASH_OBJ) {
+            Hash* hash = dynamic_cast<Hash*>(value);
+
+            copies[value] = nullptr;
+            std::vector<std::pair<HashKey, HashPair>> pairs;
+            bool failed = false;
+            hash->forEach([&](const HashKey& key, const HashPair& pair) {
+                if (failed) return;
+                Object* keyCopy = copyValue(pair.Key);
+                Object* valueCopy = keyCopy != nullptr ? copyValue(pair.Value) : nullptr;
+                if (valueCopy == nullptr) {
+                    failed = true;
+                    return;
+                }
+                pairs.push_back({key, HashPair{keyCopy, valueCopy}});
+            });
+            if (failed) {
+                return nullptr;
+            }
+
+            // a shaped hash's keys are already in a shape, so it keeps it
+            Hash* copy = new Hash({});
+            for (const auto& pair : pairs) {
+                if (hash->shape != nullptr) {
+                    copy->pushLiteral(pair.first, pair.second);
+                } else {
+                    copy->push(pair.first, pair.second);
+                }
+            }
+            return finish(value, copy);
+        } else if (type == FUNCTION_OBJ) {
+            // without a target, as for a channel, no session is known to
+            // hold the function's scope
+            if (target == nullptr) {
+                failure = "cannot copy FUNCTION out of its isolate";
+                return nullptr;
+            }
+            return copyFunction(dynamic_cast<Function*>(value));
+        }
+
+        failure = "cannot copy " + type + " to another isolate";
+        return nullptr;
+    }
+
+    Object* Transfer::copyFunction(Function* fn) {
+        std::vector<ast::Identifier*> params;
+        for (ast::Identifier* param : fn->Parameters) {
+            params.push_back(param->clone());
+        }
+        Environment* scope = target->NewEnclosedEnvironment();
+        scopes.push_back(scope);
+
+        Function* copy = new Function(params, fn->Body->clone(), scope);
+        // recorded before the body is looked at, so a function that calls
+        // itself finds this copy instead of starting another
+        copies[fn] = copy;
+
+        std::set<symbol::Id> locals = ast::BoundNames(params, copy->Body);
+
+        bool failed = false;
+        ast::Walk(copy->Body, [&](ast::Node* node) {
+            if (failed || node->GetType() != ast::NodeType::Identifier) {
+                return;
+            }
+            symbol::Id name = static_cast<ast::Identifier*>(node)->Symbol;
+            if (locals.count(name) != 0 || scope->store.count(name) != 0) {
+                return;
+            }
+
+            std::pair<Object*, bool> captured = fn->Env->Get(name);
+            if (!captured.second) {
+                return;
+            }
+            Object* capturedCopy = copyValue(captured.first);
+            if (capturedCopy == nullptr) {
+                failed = true;
+                return;
+            }
+            scope->Set(name, capturedCopy);
+        });
+
+        made.push_back(copy);
+        return failed ? nullptr : copy;
+    }
+}
@@ -3,7 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 
-int Tracelog::nestingLevel = 0;
+thread_local int Tracelog::nestingLevel = 0;
 
 enum class Parser::Order {
     LOWEST,
@@ -16,7 +16,7 @@ enum class Parser::Order {
     INDEX
 };
 
-std::map<token::TokenType, Parser::Order> Parser::precedences{
+const std::map<token::TokenType, Parser::Order> Parser::precedences{
     {token::EQ,       Parser::Order::EQUALS},
     {token::NOT_EQ,   Parser::Order::EQUALS},
     {token::LT,       Parser::Order::LESSGREATER},
@@ -341,16 +341,42 @@ ast::Expression* Parser::parseCallExpression(ast::Expression* function) {
 }
 
 ast::Expression* Parser::parseIndexExpression(ast::Expression* left) {
-    ast::IndexExpression* indexpr = new ast::IndexExpression(curToken, left);
+    token::Token bracket = curToken;
 
     nextToken();
-    indexpr->Index = parseExpression(Order::LOWEST);
+    ast::Expression* index = curTokenIs(token::COLON) ? nullptr : parseExpression(Order::LOWEST);
+
+    if (index != nullptr && !peekTokenIs(token::COLON)) {
+        ast::IndexExpression* indexpr = new ast::IndexExpression(bracket, left);
+        indexpr->Index = index;
+
+        if (!expectPeek(token::RBRACKET)) {
+            return nullptr;
+        }
+        return indexpr;
+    }
+
+    return parseSliceExpression(bracket, left, index);
+}
+
+// called with curToken on or just before the colon of left[start:end]
+ast::Expression* Parser::parseSliceExpression(token::Token bracket, ast::Expression* left, ast::Expression* start) {
+    ast::SliceExpression* slicexpr = new ast::SliceExpression(bracket, left);
+    slicexpr->Start = start;
+
+    if (start != nullptr) {
+        nextToken();
+    }
+    if (!peekTokenIs(token::RBRACKET)) {
+        nextToken();
+        slicexpr->End = parseExpression(Order::LOWEST);
+    }
 
     if (!expectPeek(token::RBRACKET)) {
         return nullptr;
     }
 
-    return indexpr;
+    return slicexpr;
 }
 
 ast::Expression* Parser::parseHashLiteral() {
@@ -368,7 +394,7 @@ ast::Expression* Parser::parseHashLiteral() {
         nextToken();
         ast::Expression* value = parseExpression(Order::LOWEST);
 
-        hashlit->Pairs[key] = value;
+        hashlit->Pairs.push_back({key, value});
 
         if (!peekTokenIs(token::RBRACE) && !expectPeek(token::COMMA)) {
             return nullptr;
@@ -45,6 +45,7 @@ void TestCallExpressionParsing();
 void TestAssignExpressionParsing();
 void TestArrayLiteralParsing();
 void TestParsingIndexExpressions();
+void TestParsingSliceExpressions();
 void TestParsingHashLiteralStringKeys();
 void TestParsingHashLiteralWithExpressions();
 bool testLetStatement(ast::Statement *s, std::string name);
@@ -77,6 +78,7 @@ int main() {
     TestParsingHashLiteralStringKeys();
     // TestParsingHashLiteralWithExpressions();
     TestParsingIndexExpressions();
+    TestParsingSliceExpressions();
 
     return 0;
 }
@@ -865,6 +867,45 @@ void TestParsingIndexExpressions() {
     }
 }
 
+void TestParsingSliceExpressions() {
+    struct Test {
+        std::string input;
+        std::string expected;
+    };
+
+    Test tests[] {
+        {"s[1:2]",         "(s[1:2])"},
+        {"s[:2]",          "(s[:2])"},
+        {"s[1 + 1:]",      "(s[(1 + 1):])"},
+        {"s[:]",           "(s[:])"},
+        {"s[1:len(s)][0]", "((s[1:len(s)])[0])"},
+    };
+
+    for (Test test : tests) {
+        Lexer l(test.input);
+        Parser p(l);
+        ast::Program program = p.ParseProgram();
+        p.checkParserErrors();
+
+        if (program.Statements.size() != 1) {
+            std::cerr << "program.Statements size not 1, got=" <<
+                program.Statements.size() << std::endl;
+            continue;
+        }
+
+        ast::ExpressionStatement* exprStmt = dynamic_cast<ast::ExpressionStatement*>(program.Statements[0]);
+        if (!exprStmt || exprStmt->expression == nullptr) {
+            std::cerr << "program.Statements[0] not an ast::ExpressionStatement" << std::endl;
+            continue;
+        }
+
+        if (exprStmt->expression->String() != test.expected) {
+            std::cerr << "expected=" << test.expected << ", got=" <<
+                exprStmt->expression->String() << std::endl;
+        }
+    }
+}
+
 void TestParsingHashLiteralStringKeys() {
     std::string input = "{\"one\": 1, \"two\": 2, \"three\": 3}";
 
@@ -1,14 +1,15 @@
 #include "../../include/repl.h"
 #include "../../include/parser.h"
-#include "../../include/eval.h"
+#include "../../include/isolate.h"
 
-void Start(std::istream &in, std::ostream &out) {
+void Start(std::istream &in, std::ostream &out, bool printStats, const allocator::Limits& limits) {
     std::string line;
-    object::Environment* env = new object::Environment();
+    Isolate isolate;
+    isolate.Env()->SetLimits(limits);
     while (true) {
         out << PROMPT;
         if (!std::getline(in, line)) {
-            return;
+            break;
         }
 
         Lexer l(line);
@@ -20,13 +21,15 @@ void Start(std::istream &in, std::ostream &out) {
             continue;
         }
 
-        object::Object* evaluated = Eval(&program, env);
+        object::Object* evaluated = isolate.Eval(program);
         if (evaluated != nullptr) {
             out << evaluated->Inspect() << std::endl;
         }
 
-        env->deleteAnonymousValues();
+        isolate.Collect();
     }
 
-    delete env;
+    if (printStats) {
+        allocator::PrintStats(std::cerr, *isolate.Env()->account);
+    }
 }
@@ -0,0 +1,385 @@
+#include "../../include/scheduler.h"
+#include "../../include/object.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <new>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_THREAD__)
+#include <sanitizer/tsan_interface.h>
+#define SCHEDULER_TSAN_FIBERS 1
+#endif
+
+namespace scheduler {
+    // as large as a main thread's stack usually is, so recursion goes as
+    // deep in a task; pages are only backed once touched, and a guard page
+    // below the stack catches an overflow
+    static const std::size_t STACK_SIZE = 8 << 20;
+    // stacks kept around for the next tasks instead of unmapped
+    static const std::size_t SPARE_STACKS = 64;
+    // how often a thread blocked outside the pool checks for a stall
+    static const std::chrono::milliseconds STALL_POLL(20);
+
+    struct Worker;
+
+    class Task {
+    public:
+        enum class State { Running, Parked, Yielded, Done };
+
+        std::function<void()> body;
+        State state = State::Running;
+        ucontext_t context;
+        char* stack = nullptr;
+        // where the task runs now, set each time a worker resumes it
+        Worker* worker = nullptr;
+        // set while a parked task is still on its way off its worker, a
+        // worker that picks it up again waits for its context to be saved
+        std::atomic<bool> switching{false};
+        // steps left before Tick lets other tasks run
+        std::size_t stepsLeft = 0;
+        object::SessionState session;
+#ifdef SCHEDULER_TSAN_FIBERS
+        void* fiber = nullptr;
+#endif
+    };
+
+    struct Worker {
+        std::size_t index;
+        std::mutex lock;
+        std::deque<Task*> ready;
+        ucontext_t context;
+#ifdef SCHEDULER_TSAN_FIBERS
+        void* fiber = nullptr;
+#endif
+    };
+
+    // counted apart from the Pool so Stalled can answer before it starts
+    static std::atomic<std::size_t> liveTasks{0};
+    static std::atomic<std::size_t> parkedTasks{0};
+    static std::atomic<std::size_t> heldWakeups{0};
+    static std::atomic<std::size_t> sliceSteps{DEFAULT_SLICE};
+
+    static std::size_t stepsPerSlice() {
+        std::size_t steps = sliceSteps.load(std::memory_order_relaxed);
+        return steps == 0 ? SIZE_MAX : steps;
+    }
+
+    class Pool {
+    public:
+        // never destroyed, its workers run until the process exits
+        static Pool& get() {
+            static Pool* pool = new Pool();
+            return *pool;
+        }
+
+        std::size_t size() const { return workers.size(); }
+
+        // the owner's deque when a task queues work, so it runs where its
+        // data is warm, otherwise the deques take turns
+        void push(Task* task, Worker* owner) {
+            Worker* worker = owner != nullptr ? owner : workers[nextWorker++ % workers.size()].get();
+            {
+                std::lock_guard<std::mutex> guard(worker->lock);
+                worker->ready.push_back(task);
+            }
+
+            queued.fetch_add(1);
+            if (sleeping.load() > 0) {
+                std::lock_guard<std::mutex> guard(idleLock);
+                idle.notify_one();
+            }
+        }
+
+        // a task that yielded goes to the end its worker takes from last,
+        // so the tasks queued there before it run first
+        void requeue(Task* task, Worker* worker) {
+            {
+                std::lock_guard<std::mutex> guard(worker->lock);
+                worker->ready.push_front(task);
+            }
+
+            queued.fetch_add(1);
+            if (sleeping.load() > 0) {
+                std::lock_guard<std::mutex> guard(idleLock);
+                idle.notify_one();
+            }
+        }
+
+        bool anyQueued() const { return queued.load(std::memory_order_relaxed) > 0; }
+
+        char* newStack() {
+            {
+                std::lock_guard<std::mutex> guard(stackLock);
+                if (!spareStacks.empty()) {
+                    char* stack = spareStacks.back();
+                    spareStacks.pop_back();
+                    return stack;
+                }
+            }
+
+            std::size_t page = sysconf(_SC_PAGESIZE);
+            void* mapping = mmap(nullptr, STACK_SIZE + page, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+            if (mapping == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            mprotect(mapping, page, PROT_NONE);
+            return static_cast<char*>(mapping) + page;
+        }
+
+        void freeStack(char* stack) {
+            {
+                std::lock_guard<std::mutex> guard(stackLock);
+                if (spareStacks.size() < SPARE_STACKS) {
+                    spareStacks.push_back(stack);
+                    return;
+                }
+            }
+
+            std::size_t page = sysconf(_SC_PAGESIZE);
+            munmap(stack - page, STACK_SIZE + page);
+        }
+
+    private:
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<std::size_t> nextWorker{0};
+        // tasks sitting in some deque, which idle workers sleep until
+        std::atomic<std::size_t> queued{0};
+        std::atomic<std::size_t> sleeping{0};
+        std::mutex idleLock;
+        std::condition_variable idle;
+
+        std::mutex stackLock;
+        std::vector<char*> spareStacks;
+
+        Pool() {
+            std::size_t count = std::max(1u, std::thread::hardware_concurrency());
+            for (std::size_t i = 0; i < count; ++i) {
+                workers.push_back(std::make_unique<Worker>());
+                workers.back()->index = i;
+            }
+            for (std::unique_ptr<Worker>& worker : workers) {
+                std::thread(&Pool::run, this, worker.get()).detach();
+            }
+        }
+
+        void run(Worker* self);
+        void resume(Worker* self, Task* task);
+
+        // the newest task of self, or the oldest one of another worker
+        Task* next(Worker* self) {
+            for (;;) {
+                for (std::size_t i = 0; i < workers.size(); ++i) {
+                    Worker* victim = workers[(self->index + i) % workers.size()].get();
+                    std::lock_guard<std::mutex> guard(victim->lock);
+                    if (victim->ready.empty()) {
+                        continue;
+                    }
+
+                    Task* task;
+                    if (victim == self) {
+                        task = victim->ready.back();
+                        victim->ready.pop_back();
+                    } else {
+                        task = victim->ready.front();
+                        victim->ready.pop_front();
+                    }
+                    queued.fetch_sub(1);
+                    return task;
+                }
+
+                // push counts a task before it checks for sleepers, a
+                // worker counts itself before it checks for tasks, so one
+                // of them always sees the other
+                std::unique_lock<std::mutex> guard(idleLock);
+                sleeping.fetch_add(1);
+                idle.wait(guard, [this]() { return queued.load() > 0; });
+                sleeping.fetch_sub(1);
+            }
+        }
+    };
+
+    // only touched by the workers' own loops and through the functions
+    // below, never cached by a task across a switch to another thread
+    static thread_local Task* running = nullptr;
+
+    __attribute__((noinline)) Task* Current() {
+        return running;
+    }
+
+    // back to the worker the task runs on, returns once it is resumed
+    static void suspend(Task* task) {
+        Worker* worker = task->worker;
+#ifdef SCHEDULER_TSAN_FIBERS
+        __tsan_switch_to_fiber(worker->fiber, 0);
+#endif
+        swapcontext(&task->context, &worker->context);
+    }
+
+    static void start() {
+        Task* task = Current();
+        task->body();
+        task->body = nullptr;
+        task->state = Task::State::Done;
+        suspend(task);
+    }
+
+    void Pool::run(Worker* self) {
+#ifdef SCHEDULER_TSAN_FIBERS
+        self->fiber = __tsan_get_current_fiber();
+#endif
+        for (;;) {
+            resume(self, next(self));
+        }
+    }
+
+    void Pool::resume(Worker* self, Task* task) {
+        while (task->switching.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        task->state = Task::State::Running;
+        task->worker = self;
+        running = task;
+        object::restoreSession(task->session);
+
+#ifdef SCHEDULER_TSAN_FIBERS
+        __tsan_switch_to_fiber(task->fiber, 0);
+#endif
+        swapcontext(&self->context, &task->context);
+
+        task->session = object::saveSession();
+        object::restoreSession({});
+        running = nullptr;
+
+        switch (task->state) {
+            case Task::State::Done :
+#ifdef SCHEDULER_TSAN_FIBERS
+                __tsan_destroy_fiber(task->fiber);
+#endif
+                freeStack(task->stack);
+                delete task;
+                liveTasks.fetch_sub(1);
+                break;
+            case Task::State::Parked :
+                // from here on another worker may resume it
+                task->switching.store(false, std::memory_order_release);
+                break;
+            case Task::State::Yielded :
+                requeue(task, self);
+                break;
+            case Task::State::Running :
+                break;
+        }
+    }
+
+    void Spawn(std::function<void()> body) {
+        Pool& pool = Pool::get();
+
+        Task* task = new Task();
+        task->body = std::move(body);
+        task->stepsLeft = stepsPerSlice();
+        task->stack = pool.newStack();
+        getcontext(&task->context);
+        task->context.uc_stack.ss_sp = task->stack;
+        task->context.uc_stack.ss_size = STACK_SIZE;
+        task->context.uc_link = nullptr;
+        makecontext(&task->context, start, 0);
+#ifdef SCHEDULER_TSAN_FIBERS
+        task->fiber = __tsan_create_fiber(0);
+#endif
+
+        liveTasks.fetch_add(1);
+        Task* self = Current();
+        pool.push(task, self != nullptr ? self->worker : nullptr);
+    }
+
+    void Park(std::unique_lock<std::mutex>& lock) {
+        Task* task = Current();
+        task->state = Task::State::Parked;
+        task->switching.store(true, std::memory_order_relaxed);
+        parkedTasks.fetch_add(1);
+
+        // a waker can queue the task as soon as the lock is free, the
+        // worker that resumes it waits for the switch below to finish
+        lock.unlock();
+        suspend(task);
+        lock.lock();
+    }
+
+    void Ready(Task* task) {
+        parkedTasks.fetch_sub(1);
+
+        Task* self = Current();
+        Pool::get().push(task, self != nullptr ? self->worker : nullptr);
+    }
+
+    void Tick() {
+        Task* task = running;
+        if (task == nullptr || --task->stepsLeft > 0) {
+            return;
+        }
+
+        task->stepsLeft = stepsPerSlice();
+        if (Pool::get().anyQueued()) {
+            task->state = Task::State::Yielded;
+            suspend(task);
+        }
+    }
+
+    void SetSlice(std::size_t steps) {
+        sliceSteps.store(steps, std::memory_order_relaxed);
+    }
+
+    bool Stalled() {
+        return parkedTasks.load() == liveTasks.load() && heldWakeups.load() == 0;
+    }
+
+    void Hold() {
+        heldWakeups.fetch_add(1);
+    }
+
+    void Release() {
+        heldWakeups.fetch_sub(1);
+    }
+
+    std::size_t Workers() {
+        return Pool::get().size();
+    }
+
+    bool Waiter::wait(std::unique_lock<std::mutex>& lock) {
+        if (task != nullptr) {
+            Park(lock);
+            return true;
+        }
+
+        // a stall has to last two polls in a row, so a task that is only
+        // between being woken and running again is not mistaken for one
+        int stalledPolls = 0;
+        while (!woken) {
+            if (signal.wait_for(lock, STALL_POLL) == std::cv_status::no_timeout || woken) {
+                continue;
+            }
+            stalledPolls = Stalled() ? stalledPolls + 1 : 0;
+            if (stalledPolls == 2) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Waiter::wake() {
+        woken = true;
+        if (task != nullptr) {
+            Ready(task);
+        } else {
+            signal.notify_one();
+        }
+    }
+}
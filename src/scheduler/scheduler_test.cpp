@@ -0,0 +1,157 @@
+#include "../../include/scheduler.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+void TestChannelPingPong();
+void TestChannelFanIn();
+void TestChannelClose();
+void TestRecvStall();
+void TestTickYields();
+
+/*
+int main() {
+    TestChannelPingPong();
+    TestChannelFanIn();
+    TestChannelClose();
+    TestRecvStall();
+    TestTickYields();
+}
+*/
+
+typedef scheduler::Channel<int> IntChannel;
+
+void TestChannelPingPong() {
+    // every send on an unbuffered channel waits for its receiver, so the
+    // two tasks take turns
+    auto ping = std::make_shared<IntChannel>(0);
+    auto pong = std::make_shared<IntChannel>(0);
+    auto done = std::make_shared<IntChannel>(0);
+    const int rounds = 1000;
+
+    scheduler::Spawn([=]() {
+        int value = 0;
+        while (ping->recv(value) == IntChannel::Status::Ok) {
+            pong->send(value + 1);
+        }
+    });
+    scheduler::Spawn([=]() {
+        int value = 0;
+        for (int i = 0; i < rounds; ++i) {
+            ping->send(value);
+            pong->recv(value);
+        }
+        ping->close();
+        done->send(value);
+    });
+
+    int result = 0;
+    if (done->recv(result) != IntChannel::Status::Ok || result != rounds) {
+        std::cerr << "ping pong ended at " << result << ", want=" << rounds << std::endl;
+    }
+}
+
+void TestChannelFanIn() {
+    auto results = std::make_shared<IntChannel>(16);
+    const int producers = 32;
+    const int perProducer = 500;
+
+    for (int p = 0; p < producers; ++p) {
+        scheduler::Spawn([=]() {
+            for (int i = 1; i <= perProducer; ++i) {
+                results->send(i);
+            }
+        });
+    }
+
+    long long sum = 0;
+    for (int i = 0; i < producers * perProducer; ++i) {
+        int value = 0;
+        if (results->recv(value) != IntChannel::Status::Ok) {
+            std::cerr << "fan in lost a value after " << i << " receives" << std::endl;
+            return;
+        }
+        sum += value;
+    }
+
+    long long want = (long long)producers * perProducer * (perProducer + 1) / 2;
+    if (sum != want) {
+        std::cerr << "fan in summed to " << sum << ", want=" << want << std::endl;
+    }
+}
+
+void TestChannelClose() {
+    IntChannel ch(2);
+    ch.send(1);
+    ch.send(2);
+    if (!ch.close() || ch.close()) {
+        std::cerr << "close did not report whether the channel was open" << std::endl;
+    }
+    if (ch.send(3) != IntChannel::Status::Closed) {
+        std::cerr << "send on a closed channel went through" << std::endl;
+    }
+
+    // what was sent before the close is still received
+    int first = 0, second = 0, third = 0;
+    if (ch.recv(first) != IntChannel::Status::Ok || ch.recv(second) != IntChannel::Status::Ok ||
+        first != 1 || second != 2) {
+        std::cerr << "values sent before close were lost" << std::endl;
+    }
+    if (ch.recv(third) != IntChannel::Status::Closed) {
+        std::cerr << "recv on a drained closed channel did not report it" << std::endl;
+    }
+
+    // closing wakes a task blocked in recv
+    auto blocked = std::make_shared<IntChannel>(0);
+    auto done = std::make_shared<IntChannel>(1);
+    scheduler::Spawn([=]() {
+        int value = 0;
+        done->send(blocked->recv(value) == IntChannel::Status::Closed ? 1 : 0);
+    });
+    blocked->close();
+    int woken = 0;
+    done->recv(woken);
+    if (woken != 1) {
+        std::cerr << "close did not wake a blocked receiver" << std::endl;
+    }
+}
+
+void TestRecvStall() {
+    // parked forever on a channel nothing else holds
+    auto orphan = std::make_shared<IntChannel>(0);
+    scheduler::Spawn([=]() {
+        int value = 0;
+        orphan->recv(value);
+    });
+
+    IntChannel ch(0);
+    int value = 0;
+    if (ch.recv(value) != IntChannel::Status::Stalled) {
+        std::cerr << "recv with every task parked did not report a stall" << std::endl;
+    }
+}
+
+void TestTickYields() {
+    // the spinning task queues the one that stops it on its own worker, so
+    // on a single core that one only runs once the spinner is preempted
+    scheduler::SetSlice(100);
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    auto done = std::make_shared<IntChannel>(1);
+
+    scheduler::Spawn([=]() {
+        scheduler::Spawn([=]() { stop->store(true); });
+        int ticks = 0;
+        while (!stop->load()) {
+            scheduler::Tick();
+            ticks++;
+        }
+        done->send(ticks);
+    });
+
+    int ticks = 0;
+    if (done->recv(ticks) != IntChannel::Status::Ok) {
+        std::cerr << "spinning task never finished" << std::endl;
+    }
+    scheduler::SetSlice(scheduler::DEFAULT_SLICE);
+}
@@ -0,0 +1,271 @@
+#include "../../include/simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+namespace simd {
+    namespace scalar {
+        // unsigned arithmetic so overflow wraps instead of being undefined
+        int64_t Sum(const int64_t* a, std::size_t n) {
+            uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) sum += uint64_t(a[i]);
+            return int64_t(sum);
+        }
+
+        int64_t Min(const int64_t* a, std::size_t n) {
+            int64_t min = a[0];
+            for (std::size_t i = 1; i < n; ++i) if (a[i] < min) min = a[i];
+            return min;
+        }
+
+        int64_t Max(const int64_t* a, std::size_t n) {
+            int64_t max = a[0];
+            for (std::size_t i = 1; i < n; ++i) if (a[i] > max) max = a[i];
+            return max;
+        }
+
+        int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n) {
+            uint64_t dot = 0;
+            for (std::size_t i = 0; i < n; ++i) dot += uint64_t(a[i]) * uint64_t(b[i]);
+            return int64_t(dot);
+        }
+
+        void Add(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) out[i] = int64_t(uint64_t(a[i]) + uint64_t(b[i]));
+        }
+
+        void Sub(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) out[i] = int64_t(uint64_t(a[i]) - uint64_t(b[i]));
+        }
+
+        void Mul(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) out[i] = int64_t(uint64_t(a[i]) * uint64_t(b[i]));
+        }
+    }
+
+#ifdef SIMD_X86
+    // Neither instruction set has a 64-bit multiply or 64-bit min/max, so
+    // products are put together from 32-bit halves and min/max compare then
+    // blend. Loads are unaligned, the tail past the last full vector is
+    // left to the scalar loops.
+    namespace avx2 {
+        __attribute__((target("avx2")))
+        static inline __m256i mul64(__m256i a, __m256i b) {
+            __m256i lo    = _mm256_mul_epu32(a, b);
+            __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                              _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+            return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+        }
+
+        __attribute__((target("avx2")))
+        static inline int64_t horizontalSum(__m256i v) {
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            return int64_t(uint64_t(_mm_cvtsi128_si64(half)) + uint64_t(_mm_extract_epi64(half, 1)));
+        }
+
+        __attribute__((target("avx2")))
+        static int64_t Sum(const int64_t* a, std::size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i*)(a + i)));
+            }
+            return int64_t(uint64_t(horizontalSum(acc)) + uint64_t(scalar::Sum(a + i, n - i)));
+        }
+
+        template <bool IsMin>
+        __attribute__((target("avx2")))
+        static int64_t Extreme(const int64_t* a, std::size_t n) {
+            if (n < 4) return IsMin ? scalar::Min(a, n) : scalar::Max(a, n);
+
+            __m256i best = _mm256_loadu_si256((const __m256i*)a);
+            std::size_t i = 4;
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+                __m256i replace = IsMin ? _mm256_cmpgt_epi64(best, v) : _mm256_cmpgt_epi64(v, best);
+                best = _mm256_blendv_epi8(best, v, replace);
+            }
+
+            int64_t lanes[4];
+            _mm256_storeu_si256((__m256i*)lanes, best);
+            int64_t result = IsMin ? scalar::Min(lanes, 4) : scalar::Max(lanes, 4);
+            for (; i < n; ++i) {
+                if (IsMin ? a[i] < result : a[i] > result) result = a[i];
+            }
+            return result;
+        }
+
+        __attribute__((target("avx2")))
+        static int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc = _mm256_add_epi64(acc, mul64(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                                  _mm256_loadu_si256((const __m256i*)(b + i))));
+            }
+            return int64_t(uint64_t(horizontalSum(acc)) + uint64_t(scalar::Dot(a + i, b + i, n - i)));
+        }
+
+        enum class Op { Add, Sub, Mul };
+
+        template <Op O>
+        __attribute__((target("avx2")))
+        static void Map(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+                __m256i r = O == Op::Add ? _mm256_add_epi64(x, y)
+                          : O == Op::Sub ? _mm256_sub_epi64(x, y)
+                          : mul64(x, y);
+                _mm256_storeu_si256((__m256i*)(out + i), r);
+            }
+            if (O == Op::Add) scalar::Add(a + i, b + i, out + i, n - i);
+            if (O == Op::Sub) scalar::Sub(a + i, b + i, out + i, n - i);
+            if (O == Op::Mul) scalar::Mul(a + i, b + i, out + i, n - i);
+        }
+    }
+
+    namespace sse42 {
+        __attribute__((target("sse4.2")))
+        static inline __m128i mul64(__m128i a, __m128i b) {
+            __m128i lo    = _mm_mul_epu32(a, b);
+            __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                                          _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+            return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+        }
+
+        __attribute__((target("sse4.2")))
+        static inline int64_t horizontalSum(__m128i v) {
+            return int64_t(uint64_t(_mm_cvtsi128_si64(v)) + uint64_t(_mm_extract_epi64(v, 1)));
+        }
+
+        __attribute__((target("sse4.2")))
+        static int64_t Sum(const int64_t* a, std::size_t n) {
+            __m128i acc = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i*)(a + i)));
+            }
+            return int64_t(uint64_t(horizontalSum(acc)) + uint64_t(scalar::Sum(a + i, n - i)));
+        }
+
+        template <bool IsMin>
+        __attribute__((target("sse4.2")))
+        static int64_t Extreme(const int64_t* a, std::size_t n) {
+            if (n < 2) return a[0];
+
+            __m128i best = _mm_loadu_si128((const __m128i*)a);
+            std::size_t i = 2;
+            for (; i + 2 <= n; i += 2) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(a + i));
+                __m128i replace = IsMin ? _mm_cmpgt_epi64(best, v) : _mm_cmpgt_epi64(v, best);
+                best = _mm_blendv_epi8(best, v, replace);
+            }
+
+            int64_t lanes[2];
+            _mm_storeu_si128((__m128i*)lanes, best);
+            int64_t result = IsMin ? scalar::Min(lanes, 2) : scalar::Max(lanes, 2);
+            for (; i < n; ++i) {
+                if (IsMin ? a[i] < result : a[i] > result) result = a[i];
+            }
+            return result;
+        }
+
+        __attribute__((target("sse4.2")))
+        static int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n) {
+            __m128i acc = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                acc = _mm_add_epi64(acc, mul64(_mm_loadu_si128((const __m128i*)(a + i)),
+                                               _mm_loadu_si128((const __m128i*)(b + i))));
+            }
+            return int64_t(uint64_t(horizontalSum(acc)) + uint64_t(scalar::Dot(a + i, b + i, n - i)));
+        }
+
+        using avx2::Op;
+
+        template <Op O>
+        __attribute__((target("sse4.2")))
+        static void Map(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+                __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+                __m128i r = O == Op::Add ? _mm_add_epi64(x, y)
+                          : O == Op::Sub ? _mm_sub_epi64(x, y)
+                          : mul64(x, y);
+                _mm_storeu_si128((__m128i*)(out + i), r);
+            }
+            if (O == Op::Add) scalar::Add(a + i, b + i, out + i, n - i);
+            if (O == Op::Sub) scalar::Sub(a + i, b + i, out + i, n - i);
+            if (O == Op::Mul) scalar::Mul(a + i, b + i, out + i, n - i);
+        }
+    }
+#endif // SIMD_X86
+
+    Level Detected() {
+#ifdef SIMD_X86
+        static const Level level = __builtin_cpu_supports("avx2")   ? Level::AVX2
+                                 : __builtin_cpu_supports("sse4.2") ? Level::SSE42
+                                 : Level::Scalar;
+        return level;
+#else
+        return Level::Scalar;
+#endif
+    }
+
+    const char* LevelName(Level level) {
+        switch (level) {
+            case Level::AVX2:  return "avx2";
+            case Level::SSE42: return "sse4.2";
+            default:           return "scalar";
+        }
+    }
+
+#ifdef SIMD_X86
+#define DISPATCH(avx2Call, sse42Call, scalarCall)            \
+    switch (Detected()) {                                    \
+        case Level::AVX2:  return avx2Call;                  \
+        case Level::SSE42: return sse42Call;                 \
+        default:           return scalarCall;                \
+    }
+#else
+#define DISPATCH(avx2Call, sse42Call, scalarCall) return scalarCall;
+#endif
+
+    int64_t Sum(const int64_t* a, std::size_t n) {
+        DISPATCH(avx2::Sum(a, n), sse42::Sum(a, n), scalar::Sum(a, n))
+    }
+
+    int64_t Min(const int64_t* a, std::size_t n) {
+        DISPATCH(avx2::Extreme<true>(a, n), sse42::Extreme<true>(a, n), scalar::Min(a, n))
+    }
+
+    int64_t Max(const int64_t* a, std::size_t n) {
+        DISPATCH(avx2::Extreme<false>(a, n), sse42::Extreme<false>(a, n), scalar::Max(a, n))
+    }
+
+    int64_t Dot(const int64_t* a, const int64_t* b, std::size_t n) {
+        DISPATCH(avx2::Dot(a, b, n), sse42::Dot(a, b, n), scalar::Dot(a, b, n))
+    }
+
+    void Add(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+        DISPATCH(avx2::Map<avx2::Op::Add>(a, b, out, n), sse42::Map<avx2::Op::Add>(a, b, out, n),
+                 scalar::Add(a, b, out, n))
+    }
+
+    void Sub(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+        DISPATCH(avx2::Map<avx2::Op::Sub>(a, b, out, n), sse42::Map<avx2::Op::Sub>(a, b, out, n),
+                 scalar::Sub(a, b, out, n))
+    }
+
+    void Mul(const int64_t* a, const int64_t* b, int64_t* out, std::size_t n) {
+        DISPATCH(avx2::Map<avx2::Op::Mul>(a, b, out, n), sse42::Map<avx2::Op::Mul>(a, b, out, n),
+                 scalar::Mul(a, b, out, n))
+    }
+
+#undef DISPATCH
+}
@@ -0,0 +1,50 @@
+#include "../../include/simd.h"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void TestKernelsMatchScalar();
+
+/*
+int main() {
+    TestKernelsMatchScalar();
+}
+*/
+
+void TestKernelsMatchScalar() {
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> extremes = {INT64_MIN, INT64_MAX, -1, 0, 1, int64_t(1) << 32, -(int64_t(1) << 32)};
+
+    // lengths around the vector widths exercise the tails
+    for (std::size_t n = 1; n < 40; ++n) {
+        std::vector<int64_t> a(n), b(n), got(n), want(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = rng() % 3 == 0 ? extremes[rng() % extremes.size()] : int64_t(rng());
+            b[i] = int64_t(rng()) >> (rng() % 64);
+        }
+
+        if (simd::Sum(a.data(), n) != simd::scalar::Sum(a.data(), n) ||
+            simd::Min(a.data(), n) != simd::scalar::Min(a.data(), n) ||
+            simd::Max(a.data(), n) != simd::scalar::Max(a.data(), n) ||
+            simd::Dot(a.data(), b.data(), n) != simd::scalar::Dot(a.data(), b.data(), n)) {
+            std::cerr << simd::LevelName(simd::Detected()) << " reduction differs from scalar at n=" << n << std::endl;
+            return;
+        }
+
+        void (*kernels[][2])(const int64_t*, const int64_t*, int64_t*, std::size_t) = {
+            {simd::Add, simd::scalar::Add},
+            {simd::Sub, simd::scalar::Sub},
+            {simd::Mul, simd::scalar::Mul},
+        };
+        for (auto& kernel : kernels) {
+            kernel[0](a.data(), b.data(), got.data(), n);
+            kernel[1](a.data(), b.data(), want.data(), n);
+            if (got != want) {
+                std::cerr << simd::LevelName(simd::Detected()) << " element-wise kernel differs from scalar at n=" << n << std::endl;
+                return;
+            }
+        }
+    }
+}
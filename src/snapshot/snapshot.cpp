@@ -0,0 +1,164 @@
+#include "../../include/snapshot.h"
+
+#include <unordered_map>
+
+namespace snapshot {
+    // a node is either an Object or an enclosed Environment kept alive by a closure
+    struct Node {
+        object::Object*      obj;
+        object::Environment* env;
+        std::vector<std::uint64_t> edges;
+        std::vector<std::uint64_t> reach;
+    };
+
+    struct Root {
+        std::string   name;
+        std::uint64_t id;
+    };
+
+    class Walker {
+    public:
+        Walker(object::Environment* root) : session(root) {}
+
+        std::vector<Node> nodes;
+        std::vector<Root> roots;
+
+        void collectRoots() {
+            for (const auto& binding : session->store) {
+                roots.push_back({symbol::Name(binding.first), idOf(binding.second)});
+            }
+            for (object::Object* obj : session->heap) {
+                roots.push_back({"<heap>", idOf(obj)});
+            }
+        }
+
+        // ids are handed out breadth first, edges are filled in as nodes are visited
+        void collectEdges() {
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                std::vector<std::uint64_t> edges;
+                if (nodes[i].obj != nullptr) {
+                    object::Object* obj = nodes[i].obj;
+                    obj->forEachReference([this, &edges](object::Object* ref) {
+                        if (ref != nullptr) edges.push_back(idOf(ref));
+                    });
+                    object::Function* fn = dynamic_cast<object::Function*>(obj);
+                    // closures over the session's own scope are not edges, the
+                    // root Environment is what the roots themselves describe
+                    if (fn && fn->Env != nullptr && fn->Env != session) {
+                        edges.push_back(idOf(fn->Env));
+                    }
+                } else {
+                    object::Environment* env = nodes[i].env;
+                    for (const auto& binding : env->store) {
+                        edges.push_back(idOf(binding.second));
+                    }
+                    for (object::Object* obj : env->heap) {
+                        edges.push_back(idOf(obj));
+                    }
+                    if (env->outer != nullptr && env->outer != session) {
+                        edges.push_back(idOf(env->outer));
+                    }
+                }
+                nodes[i].edges = std::move(edges);
+            }
+        }
+
+        void collectReach() {
+            std::vector<std::uint64_t> stack;
+            for (std::uint64_t r = 0; r < roots.size(); ++r) {
+                stack.push_back(roots[r].id);
+                while (!stack.empty()) {
+                    std::uint64_t id = stack.back();
+                    stack.pop_back();
+
+                    std::vector<std::uint64_t>& reach = nodes[id].reach;
+                    if (!reach.empty() && reach.back() == r) continue;
+                    reach.push_back(r);
+
+                    for (std::uint64_t edge : nodes[id].edges) {
+                        stack.push_back(edge);
+                    }
+                }
+            }
+        }
+
+    private:
+        object::Environment* session;
+        std::unordered_map<const void*, std::uint64_t> ids;
+
+        std::uint64_t idOf(object::Object* obj) {
+            auto it = ids.find(obj);
+            if (it != ids.end()) return it->second;
+            ids[obj] = nodes.size();
+            nodes.push_back({obj, nullptr, {}, {}});
+            return nodes.size() - 1;
+        }
+
+        std::uint64_t idOf(object::Environment* env) {
+            auto it = ids.find(env);
+            if (it != ids.end()) return it->second;
+            ids[env] = nodes.size();
+            nodes.push_back({nullptr, env, {}, {}});
+            return nodes.size() - 1;
+        }
+    };
+
+    static allocator::Kind kindOf(const Node& node) {
+        if (node.env != nullptr) {
+            return allocator::Kind::Environment;
+        }
+
+        // allocator kinds are named after the object types they count
+        for (std::size_t i = 0; i < allocator::KIND_COUNT; ++i) {
+            allocator::Kind kind = static_cast<allocator::Kind>(i);
+            if (node.obj->Type() == allocator::KindName(kind)) {
+                return kind;
+            }
+        }
+        return allocator::Kind::Other;
+    }
+
+    static std::size_t sizeOf(const Node& node) {
+        if (node.obj != nullptr) {
+            return node.obj->Footprint();
+        }
+        // a std::map node carries roughly four words of tree bookkeeping
+        return sizeof(object::Environment) +
+            node.env->store.size() * (sizeof(symbol::Id) + sizeof(void*) + 4 * sizeof(void*)) +
+            node.env->heap.capacity() * sizeof(void*);
+    }
+
+    std::size_t Write(object::Environment* root, std::ostream& out) {
+        Walker walker(root->root());
+        walker.collectRoots();
+        walker.collectEdges();
+        walker.collectReach();
+
+        out.write(MAGIC, MAGIC_LENGTH);
+        writeVarint(out, VERSION);
+
+        writeVarint(out, walker.roots.size());
+        for (const Root& r : walker.roots) {
+            writeVarint(out, r.name.size());
+            out.write(r.name.data(), r.name.size());
+            writeVarint(out, r.id);
+        }
+
+        writeVarint(out, walker.nodes.size());
+        for (const Node& node : walker.nodes) {
+            writeVarint(out, static_cast<std::uint64_t>(kindOf(node)));
+            writeVarint(out, sizeOf(node));
+            writeVarint(out, node.obj != nullptr ? std::max<int>(node.obj->refCount, 0) : 0);
+            writeVarint(out, node.edges.size());
+            for (std::uint64_t edge : node.edges) {
+                writeVarint(out, edge);
+            }
+            writeVarint(out, node.reach.size());
+            for (std::uint64_t r : node.reach) {
+                writeVarint(out, r);
+            }
+        }
+
+        return walker.nodes.size();
+    }
+}
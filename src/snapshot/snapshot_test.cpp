@@ -0,0 +1,64 @@
+#include "../../include/snapshot.h"
+#include "../../include/parser.h"
+#include "../../include/eval.h"
+
+#include <cstring>
+#include <sstream>
+
+void TestSnapshotWrite();
+
+/*
+int main() {
+    TestSnapshotWrite();
+}
+*/
+
+void TestSnapshotWrite() {
+    std::string input = "let a = [1, 2]; let h = {\"a\": a};";
+
+    object::Environment* env = new object::Environment();
+    Lexer l(input);
+    Parser p(l);
+    ast::Program program = p.ParseProgram();
+    Eval(&program, env);
+
+    std::stringstream out;
+    std::size_t written = snapshot::Write(env, out);
+
+    // a, the two integers it was packed from, which are still on the heap,
+    // h and its string key
+    if (written != 5) {
+        std::cerr << "snapshot::Write() node count not 5, got=" << written << std::endl;
+        return;
+    }
+
+    std::string data = out.str();
+    if (data.compare(0, snapshot::MAGIC_LENGTH, snapshot::MAGIC) != 0) {
+        std::cerr << "snapshot does not start with " << snapshot::MAGIC << std::endl;
+        return;
+    }
+
+    std::stringstream in(data.substr(snapshot::MAGIC_LENGTH));
+    std::uint64_t version, roots;
+    snapshot::readVarint(in, version);
+    snapshot::readVarint(in, roots);
+    if (version != snapshot::VERSION || roots < 2) {
+        std::cerr << "snapshot header wrong, version=" << version << " roots=" << roots << std::endl;
+        return;
+    }
+
+    // bindings come first, in store order
+    std::string expected[] {"a", "h"};
+    for (std::string name : expected) {
+        std::uint64_t length, id;
+        snapshot::readVarint(in, length);
+        std::string got(length, '\0');
+        in.read(got.data(), length);
+        snapshot::readVarint(in, id);
+        if (got != name) {
+            std::cerr << "snapshot root not " << name << ", got=" << got << std::endl;
+        }
+    }
+
+    delete env;
+}
@@ -0,0 +1,110 @@
+#include "../../include/sort.h"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+void TestPdqsortPatterns();
+void TestParallelSort();
+void TestStableSortBadComparator();
+
+/*
+int main() {
+    TestPdqsortPatterns();
+    TestParallelSort();
+    TestStableSortBadComparator();
+}
+*/
+
+// inputs that trip up naive quicksorts: sorted, reversed, all equal,
+// organ pipe, sawtooth and few distinct keys, at sizes around the thresholds
+static std::vector<std::vector<int64_t>> patterns(std::size_t n, std::mt19937_64& rng) {
+    std::vector<std::vector<int64_t>> inputs(7, std::vector<int64_t>(n));
+    for (std::size_t i = 0; i < n; ++i) {
+        inputs[0][i] = int64_t(rng());
+        inputs[1][i] = int64_t(i);
+        inputs[2][i] = int64_t(n - i);
+        inputs[3][i] = 7;
+        inputs[4][i] = int64_t(i < n / 2 ? i : n - i);
+        inputs[5][i] = int64_t(i % 32);
+        inputs[6][i] = int64_t(rng() % 4) - 2;
+    }
+    return inputs;
+}
+
+void TestPdqsortPatterns() {
+    std::mt19937_64 rng(7);
+    for (std::size_t n : {0, 1, 2, 23, 24, 25, 128, 129, 1000, 100000}) {
+        for (std::vector<int64_t>& input : patterns(n, rng)) {
+            std::vector<int64_t> want = input;
+            std::sort(want.begin(), want.end());
+
+            std::vector<int64_t> branchy = input;
+            sort::pdqsort(branchy.begin(), branchy.end(), std::less<int64_t>());
+            std::vector<int64_t> branchless = input;
+            sort::pdqsort<true>(branchless.begin(), branchless.end(), std::less<int64_t>());
+
+            if (branchy != want || branchless != want) {
+                std::cerr << "pdqsort of " << n << " elements is not sorted" << std::endl;
+                return;
+            }
+        }
+    }
+
+    std::vector<std::string> words = {"pear", "apple", "fig", "", "apple", "banana"};
+    sort::pdqsort(words.begin(), words.end(), std::less<std::string>());
+    if (!std::is_sorted(words.begin(), words.end())) {
+        std::cerr << "pdqsort of strings is not sorted" << std::endl;
+    }
+}
+
+void TestParallelSort() {
+    std::mt19937_64 rng(11);
+    // worker counts that leave an odd run out in some merge rounds
+    for (unsigned int workers : {1u, 2u, 3u, 4u, 7u}) {
+        for (std::vector<int64_t>& input : patterns(50000, rng)) {
+            std::vector<int64_t> want = input;
+            std::sort(want.begin(), want.end());
+
+            sort::parallelSort<true>(input.data(), input.size(), std::less<int64_t>(), workers);
+            if (input != want) {
+                std::cerr << "parallelSort on " << workers << " workers is not sorted" << std::endl;
+                return;
+            }
+        }
+    }
+}
+
+void TestStableSortBadComparator() {
+    // pairs sorted by their first element keep the order of the second
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 200; ++i) {
+        items.push_back({(i * 37) % 5, i});
+    }
+    sort::stableSort(items, [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+    for (std::size_t i = 1; i < items.size(); ++i) {
+        if (items[i - 1].first > items[i].first ||
+            (items[i - 1].first == items[i].first && items[i - 1].second > items[i].second)) {
+            std::cerr << "stableSort is not stable at " << i << std::endl;
+            return;
+        }
+    }
+
+    // a comparator that answers at random must not take the sort out of bounds
+    std::mt19937_64 rng(3);
+    std::vector<int64_t> values(1000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = int64_t(i);
+    }
+    sort::stableSort(values, [&](int64_t, int64_t) { return rng() % 2 == 0; });
+    std::sort(values.begin(), values.end());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        if (values[i] != int64_t(i)) {
+            std::cerr << "stableSort with a random comparator lost elements" << std::endl;
+            return;
+        }
+    }
+}
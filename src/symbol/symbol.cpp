@@ -0,0 +1,63 @@
+#include "../../include/symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace symbol {
+    namespace {
+        struct Table {
+            std::shared_mutex lock;
+            // a deque never moves its elements, so the views in ids and the
+            // references handed out by Name stay valid as it grows
+            std::deque<std::string> names{""};
+            std::unordered_map<std::string_view, Id> ids;
+        };
+
+        // built on first use so other globals can intern during their own setup
+        Table& table() {
+            static Table instance;
+            return instance;
+        }
+    }
+
+    Id Find(std::string_view name) {
+        Table& t = table();
+        std::shared_lock<std::shared_mutex> guard(t.lock);
+        auto it = t.ids.find(name);
+        return it != t.ids.end() ? it->second : NONE;
+    }
+
+    Id Intern(std::string_view name) {
+        Id id = Find(name);
+        if (id != NONE) {
+            return id;
+        }
+
+        Table& t = table();
+        std::unique_lock<std::shared_mutex> guard(t.lock);
+        // another thread may have interned it between the two locks
+        auto it = t.ids.find(name);
+        if (it != t.ids.end()) {
+            return it->second;
+        }
+
+        id = Id(t.names.size());
+        const std::string& stored = t.names.emplace_back(name);
+        t.ids.emplace(std::string_view(stored), id);
+        return id;
+    }
+
+    const std::string& Name(Id id) {
+        Table& t = table();
+        std::shared_lock<std::shared_mutex> guard(t.lock);
+        return id < t.names.size() ? t.names[id] : t.names[NONE];
+    }
+
+    std::size_t Count() {
+        Table& t = table();
+        std::shared_lock<std::shared_mutex> guard(t.lock);
+        return t.names.size() - 1;
+    }
+}
@@ -1,16 +1,34 @@
 #include "../../include/token.h"
-#include <map>
+#include "../../include/symbol.h"
 
-std::map<std::string, token::TokenType> keywords = {
-    {"fn",     token::FUNCTION},
-    {"let",    token::LET},
-    {"true",   token::TRUE},
-    {"false",  token::FALSE},
-    {"if",     token::IF},
-    {"else",   token::ELSE},
-    {"return", token::RETURN}};
+#include <utility>
+#include <vector>
 
-token::TokenType LookupIdent(std::string ident) {
-    auto it = keywords.find(ident);
-    return it != keywords.end() ? it->second : token::IDENT;
+// keyword token types indexed by the symbol id of their spelling
+static std::vector<token::TokenType> keywordTable() {
+    const std::pair<const char*, token::TokenType> keywords[] = {
+        {"fn",     token::FUNCTION},
+        {"let",    token::LET},
+        {"true",   token::TRUE},
+        {"false",  token::FALSE},
+        {"if",     token::IF},
+        {"else",   token::ELSE},
+        {"return", token::RETURN}};
+
+    std::vector<token::TokenType> table;
+    for (const auto& keyword : keywords) {
+        symbol::Id id = symbol::Intern(keyword.first);
+        if (id >= table.size()) {
+            table.resize(id + 1, token::IDENT);
+        }
+        table[id] = keyword.second;
+    }
+    return table;
+}
+
+token::TokenType LookupIdent(const std::string& ident) {
+    static const std::vector<token::TokenType> keywords = keywordTable();
+
+    symbol::Id id = symbol::Find(ident);
+    return id < keywords.size() ? keywords[id] : token::IDENT;
 }
@@ -0,0 +1,291 @@
+// Offline reader for heap snapshots written by heap_snapshot().
+//
+//   heap_analyzer <snapshot> [--top N]
+//
+// Reports, for every root binding, the bytes reachable from it and the bytes
+// retained by it alone, followed by the N objects that retain the most memory
+// according to the dominator tree of the heap graph.
+
+#include "../include/snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Node {
+    allocator::Kind kind;
+    std::uint64_t size;
+    std::uint64_t refCount;
+    std::vector<std::uint64_t> edges;
+    std::vector<std::uint64_t> reach;
+};
+
+struct Root {
+    std::string name;
+    std::uint64_t id;
+};
+
+struct Snapshot {
+    std::vector<Root> roots;
+    std::vector<Node> nodes;
+};
+
+bool readSnapshot(std::istream& in, Snapshot& snap) {
+    char magic[snapshot::MAGIC_LENGTH];
+    in.read(magic, snapshot::MAGIC_LENGTH);
+    if (!in || std::memcmp(magic, snapshot::MAGIC, snapshot::MAGIC_LENGTH) != 0) {
+        std::cerr << "not a heap snapshot" << std::endl;
+        return false;
+    }
+
+    std::uint64_t version, count;
+    if (!snapshot::readVarint(in, version) || version != snapshot::VERSION) {
+        std::cerr << "unsupported snapshot version" << std::endl;
+        return false;
+    }
+
+    if (!snapshot::readVarint(in, count)) return false;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::uint64_t length, id;
+        if (!snapshot::readVarint(in, length)) return false;
+        std::string name(length, '\0');
+        in.read(name.data(), length);
+        if (!in || !snapshot::readVarint(in, id)) return false;
+        snap.roots.push_back({name, id});
+    }
+
+    if (!snapshot::readVarint(in, count)) return false;
+    snap.nodes.resize(count);
+    for (Node& node : snap.nodes) {
+        std::uint64_t kind, edges, reach;
+        if (!snapshot::readVarint(in, kind) ||
+            !snapshot::readVarint(in, node.size) ||
+            !snapshot::readVarint(in, node.refCount) ||
+            !snapshot::readVarint(in, edges)) {
+            return false;
+        }
+        node.kind = static_cast<allocator::Kind>(std::min<std::uint64_t>(kind, allocator::KIND_COUNT - 1));
+        node.edges.resize(edges);
+        for (std::uint64_t& edge : node.edges) {
+            if (!snapshot::readVarint(in, edge) || edge >= count) return false;
+        }
+        if (!snapshot::readVarint(in, reach)) return false;
+        node.reach.resize(reach);
+        for (std::uint64_t& r : node.reach) {
+            if (!snapshot::readVarint(in, r) || r >= snap.roots.size()) return false;
+        }
+    }
+
+    for (const Root& r : snap.roots) {
+        if (r.id >= count) return false;
+    }
+
+    return true;
+}
+
+// Immediate dominators (Cooper, Harvey & Kennedy) over the heap graph with a
+// synthetic entry node, numbered nodes.size(), pointing at every root.
+std::vector<std::uint64_t> dominators(const Snapshot& snap, std::vector<std::uint64_t>& order) {
+    const std::uint64_t entry = snap.nodes.size();
+    const std::uint64_t none  = entry + 1;
+
+    auto successors = [&snap, entry](std::uint64_t id) -> std::vector<std::uint64_t> {
+        if (id != entry) return snap.nodes[id].edges;
+        std::vector<std::uint64_t> succ;
+        for (const Root& r : snap.roots) succ.push_back(r.id);
+        return succ;
+    };
+
+    // reverse postorder from the entry
+    std::vector<std::uint64_t> postIndex(entry + 1, none);
+    std::vector<bool> visited(entry + 1, false);
+    std::vector<std::pair<std::uint64_t, std::size_t>> stack{{entry, 0}};
+    std::vector<std::vector<std::uint64_t>> succs(entry + 1);
+    succs[entry] = successors(entry);
+    visited[entry] = true;
+    while (!stack.empty()) {
+        auto& [id, next] = stack.back();
+        if (next < succs[id].size()) {
+            std::uint64_t succ = succs[id][next++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                succs[succ] = successors(succ);
+                stack.push_back({succ, 0});
+            }
+        } else {
+            postIndex[id] = order.size();
+            order.push_back(id);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    std::vector<std::vector<std::uint64_t>> preds(entry + 1);
+    for (std::uint64_t id : order) {
+        for (std::uint64_t succ : succs[id]) preds[succ].push_back(id);
+    }
+
+    std::vector<std::uint64_t> idom(entry + 1, none);
+    idom[entry] = entry;
+
+    auto intersect = [&idom, &postIndex](std::uint64_t a, std::uint64_t b) {
+        while (a != b) {
+            while (postIndex[a] < postIndex[b]) a = idom[a];
+            while (postIndex[b] < postIndex[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (std::uint64_t id : order) {
+            if (id == entry) continue;
+            std::uint64_t newIdom = none;
+            for (std::uint64_t pred : preds[id]) {
+                if (idom[pred] == none) continue;
+                newIdom = newIdom == none ? pred : intersect(pred, newIdom);
+            }
+            if (newIdom != idom[id]) {
+                idom[id] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    return idom;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t top = 10;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = std::stoul(argv[++i]);
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+
+    if (path == nullptr) {
+        std::cerr << "usage: " << argv[0] << " <snapshot> [--top N]" << std::endl;
+        return 2;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "could not open " << path << std::endl;
+        return 1;
+    }
+
+    Snapshot snap;
+    if (!readSnapshot(file, snap)) {
+        std::cerr << "malformed snapshot " << path << std::endl;
+        return 1;
+    }
+
+    std::uint64_t totalBytes = 0;
+    std::map<allocator::Kind, std::pair<std::uint64_t, std::uint64_t>> byKind;
+    for (const Node& node : snap.nodes) {
+        totalBytes += node.size;
+        byKind[node.kind].first++;
+        byKind[node.kind].second += node.size;
+    }
+
+    std::cout << snap.nodes.size() << " objects, " << totalBytes << " bytes, " <<
+        snap.roots.size() << " roots" << std::endl << std::endl;
+
+    std::cout << std::left << std::setw(16) << "type" << std::right <<
+        std::setw(10) << "count" << std::setw(14) << "bytes" << std::endl;
+    for (const auto& [kind, stats] : byKind) {
+        std::cout << std::left << std::setw(16) << allocator::KindName(kind) << std::right <<
+            std::setw(10) << stats.first << std::setw(14) << stats.second << std::endl;
+    }
+    std::cout << std::endl;
+
+    // a node is retained by a binding when no other binding can reach it,
+    // bindings sharing a name (the anonymous <heap> entries) are reported together
+    std::map<std::string, std::pair<std::uint64_t, std::uint64_t>> byRoot;
+    for (const Root& r : snap.roots) {
+        byRoot[r.name];
+    }
+    for (const Node& node : snap.nodes) {
+        std::map<std::string, bool> names;
+        for (std::uint64_t r : node.reach) {
+            names[snap.roots[r].name] = true;
+        }
+        for (const auto& name : names) {
+            byRoot[name.first].first += node.size;
+        }
+        if (names.size() == 1) {
+            byRoot[names.begin()->first].second += node.size;
+        }
+    }
+
+    std::vector<std::pair<std::string, std::pair<std::uint64_t, std::uint64_t>>> rootRows(byRoot.begin(), byRoot.end());
+    std::sort(rootRows.begin(), rootRows.end(), [](const auto& a, const auto& b) {
+        return a.second.second > b.second.second;
+    });
+
+    std::cout << std::left << std::setw(24) << "root" << std::right <<
+        std::setw(14) << "reachable" << std::setw(14) << "retained" << std::endl;
+    for (const auto& row : rootRows) {
+        std::cout << std::left << std::setw(24) << row.first << std::right <<
+            std::setw(14) << row.second.first << std::setw(14) << row.second.second << std::endl;
+    }
+    std::cout << std::endl;
+
+    std::vector<std::uint64_t> order;
+    std::vector<std::uint64_t> idom = dominators(snap, order);
+    const std::uint64_t entry = snap.nodes.size();
+
+    // dominator subtree sizes, children always come after their dominator in order
+    std::vector<std::uint64_t> retained(entry + 1, 0);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        std::uint64_t id = *it;
+        if (id == entry) continue;
+        retained[id] += snap.nodes[id].size;
+        retained[idom[id]] += retained[id];
+    }
+
+    std::vector<std::uint64_t> ranked;
+    for (std::uint64_t id = 0; id < entry; ++id) {
+        if (idom[id] <= entry) ranked.push_back(id);
+    }
+    std::sort(ranked.begin(), ranked.end(), [&retained](std::uint64_t a, std::uint64_t b) {
+        return retained[a] > retained[b];
+    });
+    if (ranked.size() > top) ranked.resize(top);
+
+    std::cout << "largest retainers" << std::endl;
+    std::cout << std::left << std::setw(10) << "id" << std::setw(16) << "type" << std::right <<
+        std::setw(14) << "retained" << std::setw(10) << "self" << std::setw(8) << "refs" <<
+        "  reached from" << std::endl;
+    for (std::uint64_t id : ranked) {
+        const Node& node = snap.nodes[id];
+        std::cout << std::left << std::setw(10) << ("#" + std::to_string(id)) <<
+            std::setw(16) << allocator::KindName(node.kind) << std::right <<
+            std::setw(14) << retained[id] << std::setw(10) << node.size <<
+            std::setw(8) << node.refCount << "  ";
+
+        std::map<std::string, bool> names;
+        for (std::uint64_t r : node.reach) names[snap.roots[r].name] = true;
+        bool first = true;
+        for (const auto& name : names) {
+            std::cout << (first ? "" : ", ") << name.first;
+            first = false;
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}